@@ -243,62 +243,10 @@ int main(void)
         path.c_str()
     );
 
-    /*
-  7--------6
- /|       /|
-4--------5 |
-| |      | |
-| 3------|-2
-|/       |/
-0--------1
-*/
-//Vertices for the cube
-    float skyboxVertices[]{
-        -1.f, -1.f, 1.f, //0
-        1.f, -1.f, 1.f,  //1
-        1.f, -1.f, -1.f, //2
-        -1.f, -1.f, -1.f,//3
-        -1.f, 1.f, 1.f,  //4
-        1.f, 1.f, 1.f,   //5
-        1.f, 1.f, -1.f,  //6
-        -1.f, 1.f, -1.f  //7
-    };
-
-    //Skybox Indices
-    unsigned int skyboxIndices[]{
-        1,2,6,
-        6,5,1,
-
-        0,4,7,
-        7,3,0,
-
-        4,5,6,
-        6,7,4,
-
-        0,3,2,
-        2,1,0,
-
-        0,1,5,
-        5,4,0,
-
-        3,7,6,
-        6,2,3
-    };
-
-    unsigned int skyboxVAO, skyboxVBO, skyboxEBO;
+    // The sky is one fullscreen triangle made from gl_VertexID in
+    // skybox.vert, drawn after the mesh; its VAO has no buffers.
+    unsigned int skyboxVAO;
     glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glGenBuffers(1, &skyboxEBO);
-
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void*)0);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skyboxEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(skyboxIndices), &skyboxIndices, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
 
     std::string facesSkybox[]{
         "Skybox/rainbow_rt.png",
@@ -510,29 +458,6 @@ int main(void)
         //glm::mat4 viewMatrix = cameraOrientation * cameraPosMatrix;
         glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraCenter, worldUp);
 
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
-
-        glUseProgram(skyboxProgram);
-
-        glm::mat4 skyView = glm::mat4(1.f);
-        skyView = glm::mat4(glm::mat3(viewMatrix));
-
-        unsigned int sky_ProjectionLoc = glGetUniformLocation(skyboxProgram, "projection");
-        glUniformMatrix4fv(sky_ProjectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-        
-        unsigned int sky_ViewLoc = glGetUniformLocation(skyboxProgram, "view");
-        glUniformMatrix4fv(sky_ViewLoc, 1, GL_FALSE, glm::value_ptr(skyView));
-
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTex);
-
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
-
         glUseProgram(shaderProgram);
         //x_mod += 0.001f;
 
@@ -577,6 +502,15 @@ int main(void)
                            glm::value_ptr(transformation_matrix)
                            );
 
+        // Computed once per draw instead of inverting per vertex
+        glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(transformation_matrix)));
+        unsigned int normalMatrixLoc = glGetUniformLocation(shaderProgram, "normalMatrix");
+        glUniformMatrix3fv(normalMatrixLoc,
+                           1,
+                           GL_FALSE,
+                           glm::value_ptr(normal_matrix)
+                           );
+
         GLuint tex0Address = glGetUniformLocation(shaderProgram, "tex0");
         glBindTexture(GL_TEXTURE_2D, texture);
         glUniform1i(tex0Address, 0);
@@ -613,6 +547,26 @@ int main(void)
         //    0
         //);
 
+        // Sky last: the triangle sits at the far plane, so with GL_LEQUAL
+        // only pixels nothing else covered (depth still 1.0) are shaded.
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+
+        glUseProgram(skyboxProgram);
+
+        glm::mat4 skyViewProjection = projection * glm::mat4(glm::mat3(viewMatrix));
+        unsigned int sky_InverseLoc = glGetUniformLocation(skyboxProgram, "inverseViewProjection");
+        glUniformMatrix4fv(sky_InverseLoc, 1, GL_FALSE, glm::value_ptr(glm::inverse(skyViewProjection)));
+
+        glBindVertexArray(skyboxVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTex);
+
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+
         /* Swap front and back buffers */
         glfwSwapBuffers(window);
 
@@ -623,6 +577,7 @@ int main(void)
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &skyboxVAO);
 
     glfwTerminate();
     return 0;
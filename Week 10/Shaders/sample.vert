@@ -9,11 +9,12 @@ out vec3 normCoord;
 out vec3 fragPos;
 
 uniform mat4 transform, projection, view;
+uniform mat3 normalMatrix;
 
 void main() {
 	//vec3 newPos = vec3(aPos.x + x, aPos.y + y, aPos.z);
 	gl_Position = projection * view * transform * vec4(aPos, 1.0);
 	texCoord = aTex;
-	normCoord = mat3(transpose(inverse(transform))) * vertexNormal;
+	normCoord = normalMatrix * vertexNormal;
 	fragPos = vec3(transform * vec4(aPos, 1.0));
 }
\ No newline at end of file
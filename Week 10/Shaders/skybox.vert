@@ -1,19 +1,23 @@
 #version 330 core
 
-layout(location = 0) in vec3 aPos;
+// No vertex buffer: gl_VertexID 0, 1, 2 give one triangle that covers the
+// whole screen, at the far plane.
 
 //vec2 is for 2D
 //vec3 is for cubemaps
 
 out vec3 texCoord;
 
-uniform mat4 projection;
-uniform mat4 view;
+// inverse(projection * rotation-only view), so the sky stays centred on the camera
+uniform mat4 inverseViewProjection;
 
 void main() {
-	vec4 pos = projection * view * vec4(aPos, 1.0);
+	vec2 ndc = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
 
-	gl_Position = vec4(pos.x, pos.y, pos.w, pos.w);
+	gl_Position = vec4(ndc, 1.0, 1.0);
 
-	texCoord = aPos;
+	// The point on the far plane under this vertex, back in world space.
+	// w is the same positive value everywhere on the far plane, so xyz is
+	// already the view direction and interpolates linearly.
+	texCoord = (inverseViewProjection * vec4(ndc, 1.0, 1.0)).xyz;
 }
\ No newline at end of file
@@ -0,0 +1,1250 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bvh.h"
+#include "Culling.h"
+#include "Instancing.h"
+#include "MeshArena.h"
+#include "MeshOptimizer.h"
+#include "MipGenerator.h"
+#include "NormalMatrix.h"
+#include "ObjLoader.h"
+#include "Picking.h"
+#include "RenderState.h"
+#include "SceneTextures.h"
+#include "ShaderPermutations.h"
+#include "ShaderProgram.h"
+#include "SoftwareRenderer.h"
+#include "SoftwareTexture.h"
+#include "TextureLoader.h"
+#include "UniformBlocks.h"
+#include "UniformRing.h"
+#include "VertexPacking.h"
+#include "stb_image.h"
+#include "tiny_obj_loader.h"
+
+namespace {
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<size_t> SizesFromArgs(int argc, char** argv, std::vector<size_t> defaults)
+{
+    std::vector<size_t> sizes;
+    for (int i = 0; i < argc; i++)
+        sizes.push_back((size_t)std::strtoull(argv[i], nullptr, 10));
+    return sizes.empty() ? defaults : sizes;
+}
+
+// Writes a square grid of at least `triangles` triangles with positions,
+// UVs and a shared normal, using v/vt/vn faces. With `quads` each cell is
+// one quad; the bumpy heights make either diagonal the shorter one.
+bool WriteGridObj(const std::string& path, size_t triangles, bool quads)
+{
+    size_t side = (size_t)std::ceil(std::sqrt(triangles / 2.0));
+    if (side < 1)
+        side = 1;
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    std::vector<char> buffer(1 << 20);
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    std::fprintf(file, "# %zu x %zu grid\no grid\n", side, side);
+    for (size_t y = 0; y <= side; y++) {
+        for (size_t x = 0; x <= side; x++) {
+            float u = (float)x / side;
+            float v = (float)y / side;
+            std::fprintf(file, "v %f %f %f\n", u * 2.f - 1.f, std::sin(u * 6.f) * std::cos(v * 6.f) * 0.1f, v * 2.f - 1.f);
+            std::fprintf(file, "vt %f %f\n", u, v);
+        }
+    }
+    std::fprintf(file, "vn 0 1 0\n");
+
+    size_t row = side + 1;
+    for (size_t y = 0; y < side; y++) {
+        for (size_t x = 0; x < side; x++) {
+            size_t i0 = y * row + x + 1;
+            size_t i1 = i0 + 1;
+            size_t i2 = i0 + row;
+            size_t i3 = i2 + 1;
+            if (quads) {
+                std::fprintf(file, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", i0, i0, i2, i2, i3, i3, i1, i1);
+                continue;
+            }
+            std::fprintf(file, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", i0, i0, i2, i2, i1, i1);
+            std::fprintf(file, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", i1, i1, i2, i2, i3, i3);
+        }
+    }
+    return std::fclose(file) == 0;
+}
+
+bool SameFloats(const std::vector<tinyobj::real_t>& a, const std::vector<tinyobj::real_t>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::fabs(a[i] - b[i]) > 1e-6f)
+            return false;
+    }
+    return true;
+}
+
+bool SameIndices(const std::vector<tinyobj::index_t>& a, const std::vector<tinyobj::index_t>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].vertex_index != b[i].vertex_index ||
+            a[i].normal_index != b[i].normal_index ||
+            a[i].texcoord_index != b[i].texcoord_index)
+            return false;
+    }
+    return true;
+}
+
+// Builds an OBJ-style shape in memory. Vertices come from `position`
+// evaluated on a (side + 1)^2 parameter grid; triangle order is shuffled
+// so the mesh starts out with poor cache locality, like a raw scan.
+template <typename Fn>
+void MakeParametricShape(size_t side, Fn position, tinyobj::attrib_t& attrib, tinyobj::shape_t& shape)
+{
+    attrib = tinyobj::attrib_t();
+    shape = tinyobj::shape_t();
+    for (size_t y = 0; y <= side; y++) {
+        for (size_t x = 0; x <= side; x++) {
+            float u = (float)x / side;
+            float v = (float)y / side;
+            glm::vec3 p = position(u, v);
+            attrib.vertices.insert(attrib.vertices.end(), { p.x, p.y, p.z });
+            attrib.normals.insert(attrib.normals.end(), { 0.f, 1.f, 0.f });
+            attrib.texcoords.insert(attrib.texcoords.end(), { u, v });
+        }
+    }
+
+    std::vector<int> quads;
+    size_t row = side + 1;
+    for (size_t y = 0; y < side; y++) {
+        for (size_t x = 0; x < side; x++) {
+            int i0 = (int)(y * row + x);
+            int i1 = i0 + 1, i2 = i0 + (int)row, i3 = i2 + 1;
+            quads.insert(quads.end(), { i0, i2, i1, i1, i2, i3 });
+        }
+    }
+
+    std::vector<size_t> order(quads.size() / 3);
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+    for (size_t t : order) {
+        for (int k = 0; k < 3; k++) {
+            int i = quads[t * 3 + k];
+            shape.mesh.indices.push_back({ i, i, i });
+        }
+    }
+}
+
+void ReportMeshOpt(const std::string& name, const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape)
+{
+    MeshData mesh;
+    BuildMesh(attrib, shape, mesh);
+
+    VertexCacheStats before, after;
+    auto start = std::chrono::steady_clock::now();
+    OptimizeMesh(mesh, &before, &after);
+    double time = Seconds(start);
+
+    PrintVertexCacheStats(name, before, after);
+    std::printf("    optimized in %.1f ms\n", time * 1000.0);
+}
+
+void ReportQuantization(const std::string& name, const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape)
+{
+    MeshData mesh;
+    BuildMesh(attrib, shape, mesh);
+    for (VertexFormat format : { VertexFormat::PackedHalf, VertexFormat::PackedSnorm16 }) {
+        PackVertices(mesh, format);
+        PrintQuantizationError(name, MeasureQuantizationError(mesh), ViewOf(mesh));
+    }
+}
+
+// Vertex stage of sample.vert, cut down to what the normal matrix touches.
+// PER_VERTEX_INVERSE selects the old per-vertex inverse.
+const char* NORMAL_BENCH_VERT = R"(
+layout(location = 0) in vec4 aPos;
+layout(location = 1) in vec2 vertexNormal;
+layout(location = 3) in vec2 m_tan;
+
+out vec3 normCoord;
+out vec3 tangent;
+
+uniform mat4 transform, viewProjection;
+uniform mat3 normalMatrix;
+uniform vec3 posScale, posOffset;
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() {
+	vec3 pos = aPos.xyz * posScale + posOffset;
+	gl_Position = viewProjection * transform * vec4(pos, 1.0);
+#ifdef PER_VERTEX_INVERSE
+	mat3 normalMat = mat3(transpose(inverse(transform)));
+#else
+	mat3 normalMat = normalMatrix;
+#endif
+	normCoord = normalMat * octDecode(vertexNormal);
+	tangent = normalMat * octDecode(m_tan);
+}
+)";
+
+const char* NORMAL_BENCH_FRAG = R"(
+in vec3 normCoord;
+in vec3 tangent;
+out vec4 FragColor;
+
+void main() {
+	FragColor = vec4(normalize(normCoord) * 0.5 + 0.5 + tangent * 0.001, 1.0);
+}
+)";
+
+void BenchNormalMatrixCpu()
+{
+    // Small enough to stay in cache, repeated to get measurable times.
+    const size_t COUNT = 4096;
+    const int REPEAT = 256;
+    std::vector<glm::mat4> models(COUNT);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> angle(0.f, 6.2831853f), scale(0.5f, 2.f);
+    for (glm::mat4& m : models) {
+        m = glm::rotate(glm::mat4(1.f), angle(rng), glm::normalize(glm::vec3(scale(rng), scale(rng), scale(rng))));
+        m = glm::scale(m, glm::vec3(scale(rng), scale(rng), scale(rng)));
+    }
+
+    // The old shader expression, transpose(inverse(transform)) on the 4x4.
+    std::vector<glm::mat3> reference(COUNT), single(COUNT), batched(COUNT);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++) {
+        for (size_t i = 0; i < COUNT; i++)
+            reference[i] = glm::mat3(glm::transpose(glm::inverse(models[i])));
+    }
+    double inverseTime = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++) {
+        for (size_t i = 0; i < COUNT; i++)
+            single[i] = NormalMatrix(models[i]);
+    }
+    double singleTime = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < REPEAT; r++)
+        NormalMatrices(models.data(), batched.data(), COUNT);
+    double batchedTime = Seconds(start);
+
+    float maxError = 0.f;
+    for (size_t i = 0; i < COUNT; i++) {
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++) {
+                float scaleRef = std::max(1.f, std::fabs(reference[i][c][r]));
+                maxError = std::max(maxError, std::fabs(single[i][c][r] - reference[i][c][r]) / scaleRef);
+                maxError = std::max(maxError, std::fabs(batched[i][c][r] - reference[i][c][r]) / scaleRef);
+            }
+        }
+    }
+
+    double calls = (double)COUNT * REPEAT;
+    std::printf("normal matrix: 4x4 inverse %.1f ns, NormalMatrix %.1f ns, NormalMatrices %.1f ns each, "
+                "max relative error %g\n",
+                inverseTime * 1e9 / calls, singleTime * 1e9 / calls, batchedTime * 1e9 / calls, maxError);
+}
+
+// A unit sphere of at least `triangles` triangles, welded, optimized and
+// packed the way the render loop packs its mesh.
+void BuildBenchSphere(size_t triangles, MeshData& meshData)
+{
+    tinyobj::attrib_t attrib;
+    tinyobj::shape_t shape;
+    size_t side = std::max<size_t>(1, (size_t)std::ceil(std::sqrt(triangles / 2.0)));
+    MakeParametricShape(side, [](float u, float v) {
+        float theta = u * 6.2831853f, phi = v * 3.1415927f;
+        return glm::vec3(std::cos(theta) * std::sin(phi), std::cos(phi), std::sin(theta) * std::sin(phi));
+    }, attrib, shape);
+    attrib.normals = attrib.vertices;
+
+    BuildMesh(attrib, shape, meshData);
+    OptimizeMesh(meshData);
+    PackVertices(meshData, VertexFormat::PackedSnorm16);
+}
+
+// The GL setup the GPU benches share: a hidden window for the context and
+// a framebuffer object of the bench's size to draw into, so results do not
+// depend on the window (or lack of one). open() leaves the framebuffer
+// bound and the viewport set; close() after releasing everything else.
+class BenchContext {
+public:
+    ~BenchContext() { close(); }
+
+    bool open(int width, int height, bool depth)
+    {
+        if (!glfwInit())
+            return false;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        m_window = glfwCreateWindow(64, 64, "bench", NULL, NULL);
+        if (!m_window) {
+            glfwTerminate();
+            return false;
+        }
+        glfwMakeContextCurrent(m_window);
+        gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+        std::printf("GL %s / %s\n", (const char*)glGetString(GL_VERSION), (const char*)glGetString(GL_RENDERER));
+
+        glGenFramebuffers(1, &m_fbo);
+        glGenRenderbuffers(1, &m_colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+        if (depth) {
+            glGenRenderbuffers(1, &m_depthBuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    void close()
+    {
+        if (!m_window)
+            return;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &m_fbo);
+        glDeleteRenderbuffers(1, &m_colorBuffer);
+        if (m_depthBuffer)
+            glDeleteRenderbuffers(1, &m_depthBuffer);
+        m_fbo = m_colorBuffer = m_depthBuffer = 0;
+        glfwDestroyWindow(m_window);
+        m_window = nullptr;
+        glfwTerminate();
+    }
+
+private:
+    GLFWwindow* m_window = nullptr;
+    GLuint m_fbo = 0;
+    GLuint m_colorBuffer = 0;
+    GLuint m_depthBuffer = 0;
+};
+
+// A sphere at the origin filling most of the view, lit as the render loop
+// lights its mesh.
+void BenchSceneBlocks(float aspect, CameraBlock& camera, LightingBlock& lighting)
+{
+    camera = {};
+    camera.cameraPos = glm::vec3(0.f, 0.f, 3.f);
+    camera.view = glm::lookAt(camera.cameraPos, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    camera.projection = glm::perspective(glm::radians(60.f), aspect, 0.1f, 1000.0f);
+    lighting = {};
+    lighting.lightPos = glm::vec3(0.f, 0.f, 8.f);
+    lighting.lightColor = glm::vec3(1.f);
+    lighting.ambientStr = 0.1f;
+    lighting.ambientColor = lighting.lightColor;
+    lighting.specStr = 0.5f;
+    lighting.specPhong = 16.f;
+}
+
+// Draws the mesh `draws` times and returns the triangles per second.
+double MeasureDrawRate(ShaderProgram& program, const MeshView& mesh, int draws)
+{
+    program.use();
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < draws; i++)
+        glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indexCount, mesh.indexType, 0);
+    glFinish();
+    return mesh.indexCount / 3.0 * draws / Seconds(start);
+}
+
+// Needs an open BenchContext.
+int BenchNormalMatrixGpu(size_t triangles)
+{
+    MeshData meshData;
+    BuildBenchSphere(triangles, meshData);
+    MeshView mesh = ViewOf(meshData);
+
+    GLuint vao, vbo, ebo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    GetRenderState().bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertexBytes(), mesh.vertices, GL_STATIC_DRAW);
+    BindPackedVertexLayout(mesh);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBytes(), mesh.indices, GL_STATIC_DRAW);
+
+    std::string header = "#version 330 core\n";
+    ShaderProgram perVertex, uniform;
+    bool ok =
+        perVertex.build((header + "#define PER_VERTEX_INVERSE\n" + NORMAL_BENCH_VERT).c_str(),
+                        (header + NORMAL_BENCH_FRAG).c_str(), "per-vertex inverse") &&
+        uniform.build((header + NORMAL_BENCH_VERT).c_str(), (header + NORMAL_BENCH_FRAG).c_str(), "normalMatrix uniform");
+
+    double perVertexRate = 0.0, uniformRate = 0.0;
+    if (ok) {
+        glm::mat4 transform = glm::rotate(glm::scale(glm::mat4(1.f), glm::vec3(1.f, 2.f, 0.5f)), 0.7f, glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 viewProjection = glm::perspective(glm::radians(60.f), 1.f, 0.1f, 100.f) *
+                                   glm::lookAt(glm::vec3(0.f, 0.f, 5.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+        for (ShaderProgram* program : { &perVertex, &uniform }) {
+            program->set("transform", transform);
+            program->set("viewProjection", viewProjection);
+            program->set("normalMatrix", NormalMatrix(transform));
+            program->set("posScale", mesh.positionScale());
+            program->set("posOffset", mesh.positionOffset());
+        }
+
+        // Only the vertex stage runs; nothing is rasterized.
+        glEnable(GL_RASTERIZER_DISCARD);
+        // Alternate the two and keep the best of each, to ride out noise
+        // from other work on the machine.
+        const int DRAWS = 10;
+        for (int run = 0; run < 5; run++) {
+            perVertexRate = std::max(perVertexRate, MeasureDrawRate(perVertex, mesh, DRAWS));
+            uniformRate = std::max(uniformRate, MeasureDrawRate(uniform, mesh, DRAWS));
+        }
+        glDisable(GL_RASTERIZER_DISCARD);
+        std::printf("%zu triangles: per-vertex inverse %.1f Mtri/s, normalMatrix uniform %.1f Mtri/s (%.2fx)\n",
+                    mesh.indexCount / 3, perVertexRate / 1e6, uniformRate / 1e6, uniformRate / perVertexRate);
+    }
+
+    perVertex.release();
+    uniform.release();
+    GetRenderState().bindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &ebo);
+    return ok ? 0 : 1;
+}
+
+const char* BENCH_TEXTURES[] = {
+    "3D/brickwall.jpg", "3D/brickwall_normal.jpg", "3D/partenza.jpg", "3D/grass.png",
+    "3D/gradient.png", "3D/yae.png", "3D/venlumi.png", "3D/ayaya.png",
+    "Skybox/rainbow_rt.png", "Skybox/rainbow_lf.png", "Skybox/rainbow_up.png",
+    "Skybox/rainbow_dn.png", "Skybox/rainbow_ft.png", "Skybox/rainbow_bk.png",
+};
+
+// The render loop's camera, looking into a cube of objects around it.
+glm::mat4 BenchViewProjection()
+{
+    glm::mat4 projection = glm::perspective(glm::radians(60.f), 1.f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 10.f), glm::vec3(0.f, 3.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    return projection * view;
+}
+
+// Bounds of the stand-in object the culling benchmarks scatter.
+MeshView BenchObjectMesh()
+{
+    MeshView mesh;
+    mesh.aabbMin = glm::vec3(-1.f, -0.5f, -0.25f);
+    mesh.aabbMax = glm::vec3(1.f, 0.5f, 0.25f);
+    mesh.boundingRadius = glm::length(mesh.aabbMax) * 0.9f;
+    return mesh;
+}
+
+// count objects placed, turned and scaled at random in a 2000 unit cube.
+std::vector<glm::mat4> ScatterObjects(size_t count, unsigned seed = 1234)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-1000.f, 1000.f), angle(0.f, 6.2831853f), scale(0.5f, 20.f);
+    std::vector<glm::mat4> transforms(count);
+    for (glm::mat4& transform : transforms) {
+        transform = glm::translate(glm::mat4(1.f), glm::vec3(position(rng), position(rng), position(rng)));
+        transform = glm::rotate(transform, angle(rng), glm::normalize(glm::vec3(position(rng), position(rng), 1.f)));
+        transform = glm::scale(transform, glm::vec3(scale(rng)));
+    }
+    return transforms;
+}
+
+// Root mean square difference of the colour channels of two RGBA8 images,
+// in 8-bit steps.
+double ImageRmse(const unsigned char* a, const unsigned char* b, size_t pixels)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < pixels * 4; i++) {
+        if (i % 4 == 3)
+            continue;
+        double d = (double)a[i] - b[i];
+        sum += d * d;
+    }
+    return pixels ? std::sqrt(sum / (pixels * 3)) : 0.0;
+}
+
+} // namespace
+
+int RunObjLoadBench(int argc, char** argv)
+{
+    std::vector<size_t> sizes = SizesFromArgs(argc, argv, { 10000, 100000, 1000000, 10000000 });
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+
+    std::printf("%12s %6s %10s %12s %12s %8s  %s\n", "triangles", "faces", "MB", "tinyobj ms", "parallel ms", "speedup", "match");
+    bool allMatch = true;
+    for (size_t triangles : sizes) {
+        for (bool quads : { false, true }) {
+            std::string path = (dir / ("bench_grid_" + std::to_string(triangles) + (quads ? "_quads" : "") + ".obj")).string();
+            if (!std::filesystem::exists(path) && !WriteGridObj(path, triangles, quads)) {
+                std::cerr << "Could not write " << path << std::endl;
+                return 1;
+            }
+            double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+
+            tinyobj::attrib_t refAttrib, attrib;
+            std::vector<tinyobj::shape_t> refShapes, shapes;
+            std::vector<tinyobj::material_t> refMaterials, materials;
+            std::string warning, error;
+
+            auto start = std::chrono::steady_clock::now();
+            bool refOk = tinyobj::LoadObj(&refAttrib, &refShapes, &refMaterials, &warning, &error, path.c_str());
+            double refTime = Seconds(start);
+
+            start = std::chrono::steady_clock::now();
+            bool ok = LoadObjParallel(&attrib, &shapes, &materials, &warning, &error, path.c_str());
+            double time = Seconds(start);
+
+            bool match = refOk && ok &&
+                SameFloats(refAttrib.vertices, attrib.vertices) &&
+                SameFloats(refAttrib.normals, attrib.normals) &&
+                SameFloats(refAttrib.texcoords, attrib.texcoords) &&
+                SameFloats(refAttrib.colors, attrib.colors) &&
+                refShapes.size() == shapes.size() && !shapes.empty() &&
+                SameIndices(refShapes[0].mesh.indices, shapes[0].mesh.indices);
+
+            std::printf("%12zu %6s %10.1f %12.1f %12.1f %7.2fx  %s\n",
+                        triangles, quads ? "quad" : "tri", megabytes, refTime * 1000.0, time * 1000.0, refTime / time, match ? "yes" : "NO");
+            allMatch = allMatch && match;
+        }
+    }
+    // A mismatch is the regression this bench is here to catch.
+    return allMatch ? 0 : 1;
+}
+
+int RunMeshOptBench(int argc, char** argv)
+{
+    tinyobj::attrib_t attrib;
+    tinyobj::shape_t shape;
+
+    for (size_t side : { 64, 256, 1024 }) {
+        MakeParametricShape(side, [](float u, float v) {
+            return glm::vec3(u * 2.f - 1.f, 0.f, v * 2.f - 1.f);
+        }, attrib, shape);
+        ReportMeshOpt("grid " + std::to_string(side) + "x" + std::to_string(side), attrib, shape);
+
+        MakeParametricShape(side, [](float u, float v) {
+            float theta = u * 6.2831853f, phi = v * 3.1415927f;
+            return glm::vec3(std::cos(theta) * std::sin(phi), std::cos(phi), std::sin(theta) * std::sin(phi));
+        }, attrib, shape);
+        ReportMeshOpt("sphere " + std::to_string(side) + "x" + std::to_string(side), attrib, shape);
+    }
+
+    for (int i = 0; i < argc; i++) {
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warning, error;
+        if (!LoadObjParallel(&attrib, &shapes, &materials, &warning, &error, argv[i]) || shapes.empty()) {
+            std::cerr << error;
+            return 1;
+        }
+        ReportMeshOpt(argv[i], attrib, shapes[0]);
+    }
+    return 0;
+}
+
+int RunQuantizationBench(int argc, char** argv)
+{
+    tinyobj::attrib_t attrib;
+    tinyobj::shape_t shape;
+
+    for (size_t side : { 64, 1024 }) {
+        // A sphere away from the origin, with its real normals, so both the
+        // AABB mapping and the octahedral encoding see every direction.
+        MakeParametricShape(side, [](float u, float v) {
+            float theta = u * 6.2831853f, phi = v * 3.1415927f;
+            return glm::vec3(std::cos(theta) * std::sin(phi), std::cos(phi), std::sin(theta) * std::sin(phi));
+        }, attrib, shape);
+        attrib.normals = attrib.vertices;
+        for (tinyobj::real_t& p : attrib.vertices)
+            p = p * 50.f + 100.f;
+        ReportQuantization("sphere " + std::to_string(side) + "x" + std::to_string(side), attrib, shape);
+    }
+
+    for (int i = 0; i < argc; i++) {
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warning, error;
+        if (!LoadObjParallel(&attrib, &shapes, &materials, &warning, &error, argv[i]) || shapes.empty()) {
+            std::cerr << error;
+            return 1;
+        }
+        ReportQuantization(argv[i], attrib, shapes[0]);
+    }
+    return 0;
+}
+
+int RunNormalMatrixBench(int argc, char** argv)
+{
+    std::vector<size_t> sizes = SizesFromArgs(argc, argv, { 1000000 });
+
+    BenchNormalMatrixCpu();
+
+    // Nothing is rasterized, so a tiny framebuffer will do.
+    BenchContext context;
+    if (!context.open(8, 8, false))
+        return 1;
+
+    int result = 0;
+    for (size_t triangles : sizes)
+        result |= BenchNormalMatrixGpu(triangles);
+
+    context.close();
+    return result;
+}
+
+int RunTextureLoadBench(int argc, char** argv)
+{
+    std::vector<std::string> paths(argv, argv + argc);
+    if (paths.empty())
+        paths.assign(std::begin(BENCH_TEXTURES), std::end(BENCH_TEXTURES));
+
+    // Reference: the old startup path, one stbi_load after another.
+    std::vector<std::vector<unsigned char>> reference;
+    stbi_set_flip_vertically_on_load(true);
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& path : paths) {
+        int w, h, channels;
+        unsigned char* pixels = stbi_load(path.c_str(), &w, &h, &channels, 0);
+        if (!pixels) {
+            std::cerr << "Could not load " << path << std::endl;
+            return 1;
+        }
+        reference.emplace_back(pixels, pixels + (size_t)w * h * channels);
+        stbi_image_free(pixels);
+    }
+    double serialTime = Seconds(start);
+    stbi_set_flip_vertically_on_load(false);
+
+    std::printf("%zu images\n%8s %12s %8s  %s\n", paths.size(), "threads", "ms", "speedup", "match");
+    std::printf("%8s %12.1f %7.2fx  %s\n", "serial", serialTime * 1000.0, 1.0, "yes");
+
+    unsigned cores = WorkerCount();
+    for (unsigned threads = 1; ; threads = std::min(threads * 2, cores)) {
+        start = std::chrono::steady_clock::now();
+        TextureLoader loader(threads);
+        std::vector<std::future<DecodedImage>> pending;
+        for (const std::string& path : paths)
+            pending.push_back(loader.decode(path, true));
+
+        bool match = true;
+        UploadAsReady(pending, [&](size_t i, const DecodedImage& image) {
+            size_t bytes = (size_t)image.width * image.height * image.channels;
+            match = match && image && bytes == reference[i].size() &&
+                std::equal(reference[i].begin(), reference[i].end(), image.pixels.get());
+        });
+        double time = Seconds(start);
+
+        std::printf("%8u %12.1f %7.2fx  %s\n", threads, time * 1000.0, serialTime / time, match ? "yes" : "NO");
+        if (threads == cores)
+            break;
+    }
+    return 0;
+}
+
+int RunTextureCookBench(int argc, char** argv)
+{
+    std::vector<SceneTexture> textures;
+    for (int i = 0; i < argc; i++)
+        textures.push_back({ CookedPathFor(argv[i]), { argv[i] }, {} });
+    if (textures.empty())
+        textures.assign(std::begin(SCENE_TEXTURES), std::end(SCENE_TEXTURES));
+
+    std::printf("%-28s %6s %13s %10s %9s %10s %9s %7s %8s\n",
+                "texture", "format", "size", "decode ms", "cook ms", "RGBA8 KB", "cooked KB", "RMSE", "load ms");
+    for (const SceneTexture& texture : textures) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<DecodedImage> images;
+        std::vector<const unsigned char*> faces;
+        for (const std::string& source : texture.sources) {
+            images.push_back(DecodeImage(source, texture.settings.flipY, 4));
+            if (!images.back())
+                return 1;
+            faces.push_back(images.back().pixels.get());
+        }
+        double decodeTime = Seconds(start);
+        int width = images[0].width, height = images[0].height;
+
+        start = std::chrono::steady_clock::now();
+        CompressedTexture cooked = CookTexture(faces.data(), (int)faces.size(), width, height, texture.settings);
+        double cookTime = Seconds(start);
+        if (!cooked || !cooked.save(texture.cookedPath, CookTag(texture.settings))) {
+            std::cerr << "Could not cook " << texture.cookedPath << std::endl;
+            return 1;
+        }
+
+        // Error of the top level, over the channels the format keeps.
+        std::vector<unsigned char> decoded((size_t)width * height * 4);
+        int channels = cooked.format() == BlockFormat::BC5 ? 2 : cooked.format() == BlockFormat::BC1 ? 3 : 4;
+        double squaredError = 0.0;
+        for (int face = 0; face < cooked.faces(); face++) {
+            DecompressImage(cooked.levelData(face, 0), width, height, cooked.format(), decoded.data());
+            for (size_t p = 0; p < decoded.size() / 4; p++) {
+                for (int c = 0; c < channels; c++) {
+                    double d = (double)decoded[p * 4 + c] - faces[face][p * 4 + c];
+                    squaredError += d * d;
+                }
+            }
+        }
+        double rmse = std::sqrt(squaredError / (decoded.size() / 4 * channels * cooked.faces()));
+
+        // What glTexImage2D + glGenerateMipmap kept resident before.
+        size_t uncompressed = 0;
+        for (int l = 0; l < cooked.levels(); l++)
+            uncompressed += (size_t)cooked.levelWidth(l) * cooked.levelHeight(l) * 4 * cooked.faces();
+
+        start = std::chrono::steady_clock::now();
+        CompressedTexture loaded;
+        bool ok = loaded.load(texture.cookedPath) && loaded.size() == cooked.size();
+        double loadTime = Seconds(start);
+
+        char size[32];
+        std::snprintf(size, sizeof(size), "%dx%dx%d", width, height, cooked.faces());
+        std::printf("%-28s %6s %13s %10.1f %9.1f %10zu %9zu %7.2f %8.3f%s\n",
+                    texture.cookedPath.c_str(), BlockFormatName(cooked.format()), size, decodeTime * 1000.0,
+                    cookTime * 1000.0, uncompressed / 1024, cooked.size() / 1024, rmse, loadTime * 1000.0,
+                    ok ? "" : "  (reload failed)");
+    }
+    return 0;
+}
+
+int RunMipBench(int argc, char** argv)
+{
+    std::vector<std::string> paths(argv, argv + argc);
+    if (paths.empty())
+        paths = { "3D/brickwall.jpg", "3D/brickwall_normal.jpg" };
+
+    unsigned cores = WorkerCount();
+    std::printf("%-26s %8s %7s %8s %10s %10s %12s\n", "image", "filter", "mode", "threads", "ms", "speedup", "1x1 drift");
+    for (const std::string& path : paths) {
+        DecodedImage image = DecodeImage(path, false, 4);
+        if (!image)
+            return 1;
+        const unsigned char* face = image.pixels.get();
+        bool normalMap = path.find("normal") != std::string::npos;
+
+        // Mean of level 0 in linear light, which the 1x1 level should match
+        // when filtering is gamma correct.
+        double mean = 0.0;
+        for (size_t p = 0; p < (size_t)image.width * image.height; p++)
+            mean += std::pow(face[p * 4 + 1] / 255.0, 2.2);
+        mean /= (size_t)image.width * image.height;
+
+        for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos }) {
+            for (bool srgb : { false, true }) {
+                if (normalMap && srgb)
+                    continue;
+                // Cube faces are clamped; the other images tile.
+                MipWrap wrap = path.rfind("Skybox/", 0) == 0 ? MipWrap::Clamp : MipWrap::Repeat;
+                MipSettings settings = { filter, srgb, normalMap, wrap, wrap };
+                double serialTime = 0.0;
+                for (unsigned threads = 1; ; threads = std::min(threads * 2, cores)) {
+                    auto start = std::chrono::steady_clock::now();
+                    auto chains = GenerateMipChains(&face, 1, image.width, image.height, settings, threads);
+                    double time = Seconds(start);
+                    if (threads == 1)
+                        serialTime = time;
+
+                    double last = std::pow(chains[0].back()[1] / 255.0, 2.2);
+                    std::printf("%-26s %8s %7s %8u %10.1f %9.2fx %11.1f%%\n", path.c_str(), MipFilterName(filter),
+                                normalMap ? "normal" : srgb ? "srgb" : "linear", threads, time * 1000.0,
+                                serialTime / time, normalMap ? 0.0 : (last - mean) / mean * 100.0);
+                    if (threads == cores)
+                        break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int RunCullBench(int argc, char** argv)
+{
+    std::vector<size_t> sizes = SizesFromArgs(argc, argv, { 1000000 });
+    const int REPEAT = 20;
+
+    Frustum frustum = ExtractFrustum(BenchViewProjection());
+    MeshView mesh = BenchObjectMesh();
+
+    std::printf("culling with %s, %zu objects per iteration\n", CullingInstructionSet(), CULL_BATCH);
+    std::printf("%10s %10s %12s %12s %12s %9s  %s\n", "objects", "visible", "bounds ms", "scalar ms", "simd ms",
+                "speedup", "match");
+    for (size_t count : sizes) {
+        std::vector<glm::mat4> transforms = ScatterObjects(count);
+        CullBounds bounds;
+        bounds.resize(count);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
+            bounds.set(i, transforms[i], mesh);
+        double boundsTime = Seconds(start);
+
+        std::vector<uint32_t> scalarVisible(count), simdVisible(count);
+        size_t scalarCount = 0, simdCount = 0;
+        double scalarTime = 1e30, simdTime = 1e30;
+        for (int r = 0; r < REPEAT; r++) {
+            start = std::chrono::steady_clock::now();
+            scalarCount = CullObjectsScalar(frustum, bounds, scalarVisible.data());
+            scalarTime = std::min(scalarTime, Seconds(start));
+
+            start = std::chrono::steady_clock::now();
+            simdCount = CullObjects(frustum, bounds, simdVisible.data());
+            simdTime = std::min(simdTime, Seconds(start));
+        }
+        bool match = scalarCount == simdCount &&
+                     std::equal(scalarVisible.begin(), scalarVisible.begin() + scalarCount, simdVisible.begin());
+
+        std::printf("%10zu %10zu %12.2f %12.3f %12.3f %8.2fx  %s\n", count, simdCount, boundsTime * 1000.0,
+                    scalarTime * 1000.0, simdTime * 1000.0, scalarTime / simdTime, match ? "yes" : "NO");
+    }
+    return 0;
+}
+
+int RunBvhBench(int argc, char** argv)
+{
+    std::vector<size_t> sizes = SizesFromArgs(argc, argv, { 100000, 1000000 });
+    const int REPEAT = 10;
+    const size_t RAYS = 100000;
+    const size_t CHECKED_RAYS = 100;
+
+    glm::mat4 viewProjection = BenchViewProjection();
+    Frustum frustum = ExtractFrustum(viewProjection);
+    MeshView mesh = BenchObjectMesh();
+
+    std::printf("%10s %8s %10s %10s %10s %12s %12s %10s %8s\n", "objects", "build ms", "refit ms", "move 1% ms",
+                "flat ms", "bvh cull ms", "rays/s", "brute r/s", "match");
+    for (size_t count : sizes) {
+        std::vector<glm::mat4> transforms = ScatterObjects(count);
+        CullBounds bounds;
+        bounds.resize(count);
+        std::vector<Aabb> boxes(count);
+        for (size_t i = 0; i < count; i++) {
+            bounds.set(i, transforms[i], mesh);
+            boxes[i] = BoxOf(bounds, i);
+        }
+
+        Bvh bvh;
+        auto start = std::chrono::steady_clock::now();
+        bvh.build(boxes);
+        double buildTime = Seconds(start);
+
+        // Every object nudged, then the whole tree refitted.
+        std::mt19937 rng(99);
+        std::uniform_real_distribution<float> nudge(-2.f, 2.f);
+        for (Aabb& box : boxes) {
+            glm::vec3 offset(nudge(rng), nudge(rng), nudge(rng));
+            box.min += offset;
+            box.max += offset;
+        }
+        start = std::chrono::steady_clock::now();
+        bvh.refit(boxes);
+        double refitTime = Seconds(start);
+
+        // A few objects moved, each refitted on its own.
+        size_t moved = std::max<size_t>(1, count / 100);
+        std::uniform_int_distribution<uint32_t> pick(0, (uint32_t)count - 1);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < moved; i++)
+            bvh.refit(boxes, pick(rng));
+        double moveTime = Seconds(start);
+
+        // Same boxes for both culls, so rebuild the flat bounds from them.
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 center = boxes[i].center();
+            bounds.centerX[i] = center.x;
+            bounds.centerY[i] = center.y;
+            bounds.centerZ[i] = center.z;
+        }
+        std::vector<uint32_t> flatVisible(count), bvhVisible;
+        bvhVisible.reserve(count);
+        size_t flatCount = 0;
+        double flatTime = 1e30, bvhTime = 1e30;
+        for (int r = 0; r < REPEAT; r++) {
+            start = std::chrono::steady_clock::now();
+            flatCount = CullObjects(frustum, bounds, flatVisible.data());
+            flatTime = std::min(flatTime, Seconds(start));
+
+            bvhVisible.clear();
+            start = std::chrono::steady_clock::now();
+            bvh.cull(boxes, frustum, bvhVisible);
+            bvhTime = std::min(bvhTime, Seconds(start));
+        }
+
+        // Rays through random pixels, nearest box hit.
+        std::uniform_real_distribution<double> pixel(0.0, 600.0);
+        std::vector<Ray> rays(RAYS);
+        for (Ray& ray : rays)
+            ray = ScreenRay(pixel(rng), pixel(rng), 600.f, 600.f, viewProjection);
+        auto boxHit = [&](const Ray& ray, const glm::vec3& invDirection, uint32_t object, float& nearest) {
+            float entry;
+            if (!IntersectRayAabb(ray, invDirection, boxes[object], nearest, entry) || entry >= nearest)
+                return false;
+            nearest = entry;
+            return true;
+        };
+
+        std::vector<float> hits(RAYS);
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < RAYS; r++) {
+            glm::vec3 invDirection = 1.f / rays[r].direction;
+            uint32_t object;
+            float distance;
+            bool hit = bvh.raycast(rays[r], 1.f, [&](uint32_t candidate, float& nearest) {
+                return boxHit(rays[r], invDirection, candidate, nearest);
+            }, object, distance);
+            hits[r] = hit ? distance : -1.f;
+        }
+        double rayTime = Seconds(start);
+
+        bool match = true;
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < CHECKED_RAYS; r++) {
+            glm::vec3 invDirection = 1.f / rays[r].direction;
+            float nearest = 1.f;
+            bool hit = false;
+            for (uint32_t object = 0; object < count; object++)
+                hit |= boxHit(rays[r], invDirection, object, nearest);
+            match = match && (hit ? nearest : -1.f) == hits[r];
+        }
+        double bruteTime = Seconds(start);
+
+        std::printf("%10zu %8.1f %10.2f %10.2f %10.3f %12.3f %12.0f %10.0f %8s\n", count, buildTime * 1000.0,
+                    refitTime * 1000.0, moveTime * 1000.0, flatTime * 1000.0, bvhTime * 1000.0, RAYS / rayTime,
+                    CHECKED_RAYS / bruteTime, match ? "yes" : "NO");
+        std::printf("%10s visible: flat %zu, bvh %zu (boxes only); %zu nodes\n", "", flatCount, bvhVisible.size(),
+                    bvh.nodeCount());
+    }
+    return 0;
+}
+
+int RunRasterBench(int argc, char** argv)
+{
+    std::vector<size_t> sizes = SizesFromArgs(argc, argv, { 10000, 100000, 1000000 });
+    const int WIDTH = 600, HEIGHT = 600;
+    const int FRAMES = 5;
+
+    BenchContext context;
+    if (!context.open(WIDTH, HEIGHT, true))
+        return 1;
+
+    // The scene textures, decoded for the software renderer and uploaded
+    // for GL from the same .dds.
+    const size_t TEXTURES = std::size(SCENE_TEXTURES);
+    SoftwareTexture softwareTextures[TEXTURES];
+    GLuint glTextures[TEXTURES];
+    glGenTextures((GLsizei)TEXTURES, glTextures);
+    for (size_t i = 0; i < TEXTURES; i++) {
+        const SceneTexture& sceneTexture = SCENE_TEXTURES[i];
+        GLenum target = sceneTexture.sources.size() == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+        CompressedTexture cooked;
+        if (!LoadOrCookTexture(sceneTexture.sources, sceneTexture.cookedPath, sceneTexture.settings, cooked)) {
+            std::printf("Could not load %s\n", sceneTexture.cookedPath.c_str());
+            continue;
+        }
+        softwareTextures[i].decode(cooked);
+        softwareTextures[i].setWrap(sceneTexture.settings.mips.wrapS, sceneTexture.settings.mips.wrapT);
+        GetRenderState().bindTexture(target, glTextures[i]);
+        cooked.upload(target);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GlWrap(sceneTexture.settings.mips.wrapS));
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GlWrap(sceneTexture.settings.mips.wrapT));
+        if (target == GL_TEXTURE_CUBE_MAP) {
+            glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        }
+    }
+
+    // The permutation the render loop draws the scene's material with.
+    ShaderProgram sampleProgram, skyboxProgram;
+    sampleProgram.startBuild(ShaderSource::FromFiles("Shaders/sample.vert", "Shaders/sample.frag",
+                                                     ShaderDefines(ShaderFeaturesFor(SCENE_MATERIALS[0]))));
+    bool ok = sampleProgram.finishBuild() && skyboxProgram.load("Shaders/skybox.vert", "Shaders/skybox.frag");
+    for (ShaderProgram* program : { &sampleProgram, &skyboxProgram }) {
+        program->bindUniformBlock("Camera", CAMERA_BINDING);
+        program->bindUniformBlock("Lighting", LIGHTING_BINDING);
+    }
+    UniformRing uniformRing;
+    uniformRing.create(4096);
+
+    GLuint skyboxVao, instanceBuffer;
+    glGenVertexArrays(1, &skyboxVao);
+    glGenBuffers(1, &instanceBuffer);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // The sphere with the sky around it.
+    CameraBlock camera;
+    LightingBlock lighting;
+    BenchSceneBlocks((float)WIDTH / HEIGHT, camera, lighting);
+    glm::mat4 skyInverse = glm::inverse(camera.projection * glm::mat4(glm::mat3(camera.view)));
+
+    glm::mat4 transform = glm::rotate(glm::mat4(1.f), 0.5f, glm::vec3(0.f, 1.f, 0.f));
+    InstanceData instance;
+    BuildInstanceData(&transform, 1, &instance);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(instance), &instance, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Mpix/s counts the sphere's pixels (each shaded once by both), not
+    // the sky's. Times are the best of FRAMES frames.
+    std::printf("%10s %-12s %10s %10s %10s %8s\n", "triangles", "renderer", "frame ms", "Mtri/s", "Mpix/s", "rmse");
+    for (size_t triangles : sizes) {
+        if (!ok)
+            break;
+        MeshData meshData;
+        BuildBenchSphere(triangles, meshData);
+        MeshView mesh = ViewOf(meshData);
+        size_t meshTriangles = mesh.indexCount / 3;
+
+        MeshArena meshArena;
+        meshArena.create(16 * 1024 * 1024, 8 * 1024 * 1024);
+        meshArena.setInstanceBuffer(instanceBuffer);
+        std::vector<MeshDraw> draws = { { meshArena.add(mesh), 0, 1 } };
+
+        auto drawGl = [&] {
+            uniformRing.beginFrame();
+            uniformRing.bind(CAMERA_BINDING, camera);
+            uniformRing.bind(LIGHTING_BINDING, lighting);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            sampleProgram.use();
+            sampleProgram.set("tex0", 0);
+            sampleProgram.set("norm_tex", 1);
+            GetRenderState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, glTextures[0]);
+            GetRenderState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, glTextures[1]);
+            meshArena.draw(draws);
+
+            GetRenderState().depthMask(GL_FALSE);
+            GetRenderState().depthFunc(GL_LEQUAL);
+            skyboxProgram.use();
+            skyboxProgram.set("inverseViewProjection", skyInverse);
+            GetRenderState().bindVertexArray(skyboxVao);
+            GetRenderState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, glTextures[2]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            GetRenderState().depthMask(GL_TRUE);
+            GetRenderState().depthFunc(GL_LESS);
+            uniformRing.endFrame();
+        };
+        double glTime = 1e30;
+        for (int frame = 0; frame < FRAMES; frame++) {
+            glFinish();
+            auto start = std::chrono::steady_clock::now();
+            drawGl();
+            glFinish();
+            glTime = std::min(glTime, Seconds(start));
+        }
+
+        // Read back top row first, like SoftwareRenderer::pixels.
+        std::vector<unsigned char> glPixels((size_t)WIDTH * HEIGHT * 4), row((size_t)WIDTH * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, glPixels.data());
+        for (int y = 0; y < HEIGHT / 2; y++)
+            std::swap_ranges(glPixels.begin() + (size_t)y * WIDTH * 4, glPixels.begin() + (size_t)(y + 1) * WIDTH * 4,
+                             glPixels.begin() + (size_t)(HEIGHT - 1 - y) * WIDTH * 4);
+        meshArena.release();
+
+        // 1, 2, 4... threads up to the core count.
+        size_t coveredPixels = 0;
+        for (unsigned threads = 1;; threads = std::min(threads * 2, WorkerCount())) {
+            SoftwareRenderer renderer(threads);
+            renderer.resize(WIDTH, HEIGHT);
+            std::vector<MeshDraw> softwareDraws = { { renderer.add(mesh), 0, 1 } };
+            renderer.setInstances(&instance, 1);
+            renderer.setCamera(camera);
+            renderer.setLighting(lighting);
+            renderer.setTextures(&softwareTextures[0], &softwareTextures[1], &softwareTextures[2]);
+            renderer.setFeatures(ShaderFeaturesFor(SCENE_MATERIALS[0]));
+
+            double time = 1e30;
+            for (int frame = 0; frame < FRAMES; frame++) {
+                auto start = std::chrono::steady_clock::now();
+                renderer.draw(softwareDraws);
+                time = std::min(time, Seconds(start));
+            }
+            coveredPixels = renderer.stats().pixelsShaded;
+            std::string name = "software x" + std::to_string(threads);
+            std::printf("%10zu %-12s %10.2f %10.2f %10.2f %8.2f\n", meshTriangles, name.c_str(), time * 1000.0,
+                        meshTriangles / time / 1e6, coveredPixels / time / 1e6,
+                        ImageRmse(renderer.pixels(), glPixels.data(), (size_t)WIDTH * HEIGHT));
+            if (threads >= WorkerCount())
+                break;
+        }
+        std::printf("%10zu %-12s %10.2f %10.2f %10.2f %8s\n", meshTriangles, "GL", glTime * 1000.0,
+                    meshTriangles / glTime / 1e6, coveredPixels / glTime / 1e6, "-");
+    }
+
+    sampleProgram.release();
+    skyboxProgram.release();
+    uniformRing.release();
+    glDeleteVertexArrays(1, &skyboxVao);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteTextures((GLsizei)TEXTURES, glTextures);
+    context.close();
+    return ok ? 0 : 1;
+}
+
+int RunPermutationBench(int argc, char** argv)
+{
+    std::vector<size_t> layerCounts = SizesFromArgs(argc, argv, { 1, 8 });
+    const int WIDTH = 600, HEIGHT = 600;
+    const int FRAMES = 5;
+    const size_t TRIANGLES = 2000;
+
+    BenchContext context;
+    if (!context.open(WIDTH, HEIGHT, true))
+        return 1;
+
+    // The scene material's albedo and normal map.
+    const SceneMaterial& material = SCENE_MATERIALS[0];
+    GLuint textures[2];
+    glGenTextures(2, textures);
+    for (int i = 0; i < 2; i++) {
+        int index = i == 0 ? material.albedo : material.normalMap;
+        if (index < 0)
+            continue;
+        const SceneTexture& sceneTexture = SCENE_TEXTURES[index];
+        CompressedTexture cooked;
+        if (!LoadOrCookTexture(sceneTexture.sources, sceneTexture.cookedPath, sceneTexture.settings, cooked)) {
+            std::printf("Could not load %s\n", sceneTexture.cookedPath.c_str());
+            continue;
+        }
+        GetRenderState().bindTexture(GL_TEXTURE0 + i, GL_TEXTURE_2D, textures[i]);
+        cooked.upload(GL_TEXTURE_2D);
+    }
+
+    GLuint instanceBuffer;
+    glEnable(GL_DEPTH_TEST);
+
+    // Spheres stacked behind one another and drawn front to back, so every
+    // layer after the first is hidden: with early-Z its pixels are never
+    // shaded, and a permutation that can discard shades them all.
+    size_t maxLayers = *std::max_element(layerCounts.begin(), layerCounts.end());
+    std::vector<glm::mat4> transforms;
+    for (size_t i = 0; i < maxLayers; i++)
+        transforms.push_back(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -0.25f * i)));
+    std::vector<InstanceData> instances(maxLayers);
+    BuildInstanceData(transforms.data(), maxLayers, instances.data());
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    MeshData meshData;
+    BuildBenchSphere(TRIANGLES, meshData);
+    MeshArena meshArena;
+    meshArena.create(16 * 1024 * 1024, 8 * 1024 * 1024);
+    meshArena.setInstanceBuffer(instanceBuffer);
+    uint32_t meshId = meshArena.add(ViewOf(meshData));
+
+    CameraBlock camera;
+    LightingBlock lighting;
+    BenchSceneBlocks((float)WIDTH / HEIGHT, camera, lighting);
+    UniformRing uniformRing;
+    uniformRing.create(4096);
+
+    // Every permutation, built cold (no program cache). "build ms" is the
+    // compile and link, "first ms" the first frame, which includes any
+    // compiling the driver put off until the program is drawn with. Frame
+    // times are the best of FRAMES. * marks the scene's permutations.
+    std::vector<uint32_t> sceneFeatures;
+    for (const SceneMaterial& sceneMaterial : SCENE_MATERIALS)
+        sceneFeatures.push_back(ShaderFeaturesFor(sceneMaterial));
+    std::printf("  %-36s %9s %9s", "permutation", "build ms", "first ms");
+    for (size_t layers : layerCounts)
+        std::printf(" %12s", (std::to_string(layers) + " layers ms").c_str());
+    std::printf("\n");
+
+    bool ok = true;
+    for (uint32_t features = 0; features < (1u << SHADER_FEATURE_COUNT); features++) {
+        ShaderProgram program;
+        auto start = std::chrono::steady_clock::now();
+        program.startBuild(ShaderSource::FromFiles("Shaders/sample.vert", "Shaders/sample.frag",
+                                                   ShaderDefines(features)));
+        if (!program.finishBuild()) {
+            ok = false;
+            continue;
+        }
+        double buildTime = Seconds(start);
+        program.bindUniformBlock("Camera", CAMERA_BINDING);
+        program.bindUniformBlock("Lighting", LIGHTING_BINDING);
+
+        auto drawLayers = [&](size_t layers) {
+            uniformRing.beginFrame();
+            uniformRing.bind(CAMERA_BINDING, camera);
+            uniformRing.bind(LIGHTING_BINDING, lighting);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            program.use();
+            program.set("tex0", 0);
+            program.set("norm_tex", 1);
+            meshArena.draw({ { meshId, 0, (uint32_t)layers } });
+            uniformRing.endFrame();
+        };
+        glFinish();
+        start = std::chrono::steady_clock::now();
+        drawLayers(layerCounts[0]);
+        glFinish();
+        double firstTime = Seconds(start);
+
+        bool scene = std::find(sceneFeatures.begin(), sceneFeatures.end(), features) != sceneFeatures.end();
+        std::printf("%c %-36s %9.2f %9.2f", scene ? '*' : ' ', ShaderFeatureNames(features).c_str(),
+                    buildTime * 1000.0, firstTime * 1000.0);
+        for (size_t layers : layerCounts) {
+            double time = 1e30;
+            for (int frame = 0; frame < FRAMES; frame++) {
+                glFinish();
+                start = std::chrono::steady_clock::now();
+                drawLayers(layers);
+                glFinish();
+                time = std::min(time, Seconds(start));
+            }
+            std::printf(" %12.2f", time * 1000.0);
+        }
+        std::printf("\n");
+        program.release();
+    }
+
+    meshArena.release();
+    uniformRing.release();
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteTextures(2, textures);
+    context.close();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// Command line benchmarks. Each takes the arguments that follow its flag and
+// returns the process exit code; none of them show a window.
+
+// --bench-obj [triangles...]
+// Times tinyobj::LoadObj against LoadObjParallel on generated grid OBJs,
+// one made of triangles and one of quads per size, and checks they match.
+// Defaults to 10k, 100k, 1M and 10M triangles.
+int RunObjLoadBench(int argc, char** argv);
+
+// --bench-meshopt [obj paths...]
+// Reports ACMR/ATVR before and after OptimizeMesh on generated meshes with
+// shuffled triangles, plus any OBJ files given (e.g. public-domain scans).
+int RunMeshOptBench(int argc, char** argv);
+
+// --bench-quant [obj paths...]
+// Packs generated meshes and any OBJ files given in every packed vertex
+// format and reports the quantization error of each.
+int RunQuantizationBench(int argc, char** argv);
+
+// --bench-normals [triangles]
+// Compares building normal matrices on the CPU (scalar and batched) with
+// glm::inverse, then draws a generated mesh (default 1M triangles) with
+// transpose(inverse(transform)) per vertex and with a normalMatrix uniform.
+// The draw part needs a GL context; run with LIBGL_ALWAYS_SOFTWARE=1 to
+// measure Mesa llvmpipe.
+int RunNormalMatrixBench(int argc, char** argv);
+
+// --bench-textures [image paths...]
+// Decodes the Week 11 textures (or the images given) one after another with
+// stbi_load, then with TextureLoader on 1, 2, 4... threads up to the core
+// count, and checks the pixels match.
+int RunTextureLoadBench(int argc, char** argv);
+
+// --cook-textures [image paths...]
+// Cooks the scene textures (or the images given, as BC1) to their .dds and
+// reports decode and cook time, size against RGBA8 with mips, the RMSE of
+// the top level and how long the .dds takes to load.
+int RunTextureCookBench(int argc, char** argv);
+
+// --bench-mips [image paths...]
+// Times GenerateMipChains with each filter, in linear and sRGB mode, on 1,
+// 2, 4... threads up to the core count. "1x1 drift" is how far the last
+// level's green channel is from the image's mean in linear light, which
+// gamma-correct filtering keeps near zero. Paths containing "normal" are
+// filtered as normal maps, and paths under Skybox/ with clamped edges
+// (the rest wrap, as tiling textures).
+int RunMipBench(int argc, char** argv);
+
+// --bench-cull [objects...]
+// Frustum culls randomly placed objects (default 1M) against the render
+// loop's camera, one object at a time and with CullObjects, and checks both
+// keep the same objects. "bounds ms" is the time to fill the CullBounds.
+int RunCullBench(int argc, char** argv);
+
+// --bench-bvh [objects...]
+// Builds a Bvh over randomly placed objects (default 100k and 1M) and times
+// a full refit after every object moves, refitting 1% of the objects one
+// at a time, frustum culling against CullObjects, and nearest-box ray
+// queries through random pixels, checked against a brute force scan.
+int RunBvhBench(int argc, char** argv);
+
+// --bench-raster [triangles...]
+// Draws a textured, normal-mapped sphere (default 10k, 100k and 1M
+// triangles) and the sky with SoftwareRenderer on 1, 2, 4... threads up to
+// the core count and with the GL context's renderer through sample.vert
+// and sample.frag, and reports Mtri/s, Mpix/s and the RMSE between the
+// two images. Run with LIBGL_ALWAYS_SOFTWARE=1 to compare with Mesa
+// llvmpipe.
+int RunRasterBench(int argc, char** argv);
+
+// --bench-permutations [layers...]
+// Builds every permutation of sample.frag's feature flags without the
+// program cache and reports its build time, its first frame and its frame
+// time drawing 1 and 8 (or the given counts of) spheres stacked front to
+// back, where a permutation with the alpha test loses early-Z on the
+// hidden layers. The scene's permutations are marked with *.
+int RunPermutationBench(int argc, char** argv);
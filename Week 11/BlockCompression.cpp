@@ -0,0 +1,389 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Parallel.h"
+
+namespace {
+
+struct Color {
+    float r, g, b;
+};
+
+uint16_t To565(const Color& c)
+{
+    int r = std::clamp((int)std::lround(c.r * 31.f / 255.f), 0, 31);
+    int g = std::clamp((int)std::lround(c.g * 63.f / 255.f), 0, 63);
+    int b = std::clamp((int)std::lround(c.b * 31.f / 255.f), 0, 31);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+void From565(uint16_t c, int out[3])
+{
+    int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+    out[0] = r << 3 | r >> 2;
+    out[1] = g << 2 | g >> 4;
+    out[2] = b << 3 | b >> 2;
+}
+
+void Put16(unsigned char* out, uint16_t v)
+{
+    out[0] = (unsigned char)v;
+    out[1] = (unsigned char)(v >> 8);
+}
+
+// The four 4-colour-mode palette entries for endpoints c0, c1.
+void Bc1Palette(uint16_t c0, uint16_t c1, int palette[4][3])
+{
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    for (int k = 0; k < 3; k++) {
+        palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+        palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+    }
+}
+
+// Picks the nearest palette entry for each pixel. Returns the packed
+// indices and sets `error` to the block's squared error.
+uint32_t Bc1Indices(const unsigned char rgba[64], const int palette[4][3], int& error)
+{
+    uint32_t indices = 0;
+    error = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestError = INT32_MAX;
+        for (int p = 0; p < 4; p++) {
+            int dr = rgba[i * 4 + 0] - palette[p][0];
+            int dg = rgba[i * 4 + 1] - palette[p][1];
+            int db = rgba[i * 4 + 2] - palette[p][2];
+            int e = dr * dr + dg * dg + db * db;
+            if (e < bestError) {
+                bestError = e;
+                best = p;
+            }
+        }
+        indices |= (uint32_t)best << (i * 2);
+        error += bestError;
+    }
+    return indices;
+}
+
+// Orders the endpoints for 4-colour mode (c0 > c1) and writes the block.
+// Returns the block's squared error.
+int WriteBc1(const unsigned char rgba[64], uint16_t c0, uint16_t c1, unsigned char out[8])
+{
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    int palette[4][3];
+    Bc1Palette(c0, c1, palette);
+    // With c0 == c1 every entry is the same colour, so all indices come
+    // out 0, which also decodes correctly in 3-colour mode.
+    int error;
+    uint32_t indices = Bc1Indices(rgba, palette, error);
+
+    Put16(out, c0);
+    Put16(out + 2, c1);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (i * 8));
+    return error;
+}
+
+// Least-squares endpoints for the indices already chosen in `block`.
+bool RefineBc1(const unsigned char rgba[64], const unsigned char block[8], Color& e0, Color& e1)
+{
+    static const float WEIGHT0[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+    uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+
+    float aa = 0.f, bb = 0.f, ab = 0.f;
+    Color ax = {}, bx = {};
+    for (int i = 0; i < 16; i++) {
+        float a = WEIGHT0[(indices >> (i * 2)) & 3];
+        float b = 1.f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        ax.r += a * rgba[i * 4 + 0];
+        ax.g += a * rgba[i * 4 + 1];
+        ax.b += a * rgba[i * 4 + 2];
+        bx.r += b * rgba[i * 4 + 0];
+        bx.g += b * rgba[i * 4 + 1];
+        bx.b += b * rgba[i * 4 + 2];
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return false;
+    float inv = 1.f / det;
+    e0 = { (ax.r * bb - bx.r * ab) * inv, (ax.g * bb - bx.g * ab) * inv, (ax.b * bb - bx.b * ab) * inv };
+    e1 = { (bx.r * aa - ax.r * ab) * inv, (bx.g * aa - ax.g * ab) * inv, (bx.b * aa - ax.b * ab) * inv };
+    return true;
+}
+
+void EncodeBc1Color(const unsigned char rgba[64], unsigned char out[8])
+{
+    // Principal axis of the block's colours by power iteration on the
+    // covariance matrix.
+    Color mean = {};
+    for (int i = 0; i < 16; i++) {
+        mean.r += rgba[i * 4 + 0];
+        mean.g += rgba[i * 4 + 1];
+        mean.b += rgba[i * 4 + 2];
+    }
+    mean = { mean.r / 16.f, mean.g / 16.f, mean.b / 16.f };
+
+    float cov[6] = {};
+    for (int i = 0; i < 16; i++) {
+        float r = rgba[i * 4 + 0] - mean.r;
+        float g = rgba[i * 4 + 1] - mean.g;
+        float b = rgba[i * 4 + 2] - mean.b;
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+    Color axis = { 1.f, 1.f, 1.f };
+    for (int iteration = 0; iteration < 4; iteration++) {
+        Color next = {
+            cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+            cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+            cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b,
+        };
+        float length = std::max({ std::fabs(next.r), std::fabs(next.g), std::fabs(next.b) });
+        if (length < 1e-6f)
+            break;
+        axis = { next.r / length, next.g / length, next.b / length };
+    }
+
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = (rgba[i * 4 + 0] - mean.r) * axis.r + (rgba[i * 4 + 1] - mean.g) * axis.g + (rgba[i * 4 + 2] - mean.b) * axis.b;
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    // Pull the endpoints in slightly; the extremes are rarely the best fit
+    // once the interpolated entries are counted.
+    float axisLength2 = axis.r * axis.r + axis.g * axis.g + axis.b * axis.b;
+    float inset = (maxT - minT) / 16.f;
+    float t0 = axisLength2 > 0.f ? (maxT - inset) / axisLength2 : 0.f;
+    float t1 = axisLength2 > 0.f ? (minT + inset) / axisLength2 : 0.f;
+    Color e0 = { mean.r + axis.r * t0, mean.g + axis.g * t0, mean.b + axis.b * t0 };
+    Color e1 = { mean.r + axis.r * t1, mean.g + axis.g * t1, mean.b + axis.b * t1 };
+
+    int error = WriteBc1(rgba, To565(e0), To565(e1), out);
+
+    unsigned char refined[8];
+    if (error > 0 && RefineBc1(rgba, out, e0, e1) && WriteBc1(rgba, To565(e0), To565(e1), refined) < error)
+        std::memcpy(out, refined, 8);
+}
+
+// One channel (every 4th byte of `pixels`) into an 8-byte BC4 block,
+// always in 8-value mode.
+void EncodeBc4(const unsigned char* pixels, unsigned char out[8])
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++) {
+        lo = std::min<int>(lo, pixels[i * 4]);
+        hi = std::max<int>(hi, pixels[i * 4]);
+    }
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+
+    uint64_t indices = 0;
+    if (hi > lo) {
+        int values[8] = { hi, lo };
+        for (int k = 2; k < 8; k++)
+            values[k] = ((8 - k) * hi + (k - 1) * lo) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = 256;
+            for (int k = 0; k < 8; k++) {
+                int e = std::abs(pixels[i * 4] - values[k]);
+                if (e < bestError) {
+                    bestError = e;
+                    best = k;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+void DecodeBc4(const unsigned char* block, unsigned char* pixels)
+{
+    int a0 = block[0], a1 = block[1];
+    int values[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (int k = 2; k < 8; k++)
+            values[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+    }
+    else {
+        for (int k = 2; k < 6; k++)
+            values[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+        values[6] = 0;
+        values[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t)block[2 + i] << (i * 8);
+    for (int i = 0; i < 16; i++)
+        pixels[i * 4] = (unsigned char)values[(indices >> (i * 3)) & 7];
+}
+
+// The 8-byte colour block of BC1 and BC3. BC1 switches to three
+// colours and transparent black when c0 <= c1; the colour block of BC3
+// always interpolates four colours (fourColorOnly).
+void DecodeBc1Color(const unsigned char* block, bool fourColorOnly, unsigned char rgba[64])
+{
+    uint16_t c0 = (uint16_t)(block[0] | block[1] << 8);
+    uint16_t c1 = (uint16_t)(block[2] | block[3] << 8);
+    int palette[4][3];
+    Bc1Palette(c0, c1, palette);
+    int alpha[4] = { 255, 255, 255, 255 };
+    if (!fourColorOnly && c0 <= c1) {
+        for (int k = 0; k < 3; k++) {
+            palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+        alpha[3] = 0;
+    }
+
+    uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+    for (int i = 0; i < 16; i++) {
+        int p = (indices >> (i * 2)) & 3;
+        rgba[i * 4 + 0] = (unsigned char)palette[p][0];
+        rgba[i * 4 + 1] = (unsigned char)palette[p][1];
+        rgba[i * 4 + 2] = (unsigned char)palette[p][2];
+        rgba[i * 4 + 3] = (unsigned char)alpha[p];
+    }
+}
+
+// Copies the 4x4 block at (bx, by), clamping at the image edges.
+void GatherBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char block[64])
+{
+    for (int y = 0; y < 4; y++) {
+        int sy = std::min(by * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int sx = std::min(bx * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+} // namespace
+
+size_t BlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t CompressedSize(BlockFormat format, int width, int height)
+{
+    size_t blocksX = (size_t)std::max(1, (width + 3) / 4);
+    size_t blocksY = (size_t)std::max(1, (height + 3) / 4);
+    return blocksX * blocksY * BlockBytes(format);
+}
+
+const char* BlockFormatName(BlockFormat format)
+{
+    switch (format) {
+    case BlockFormat::BC1: return "BC1";
+    case BlockFormat::BC3: return "BC3";
+    case BlockFormat::BC5: return "BC5";
+    case BlockFormat::BC7: return "BC7";
+    }
+    return "?";
+}
+
+void EncodeBC1Block(const unsigned char rgba[64], unsigned char out[8])
+{
+    EncodeBc1Color(rgba, out);
+}
+
+void EncodeBC3Block(const unsigned char rgba[64], unsigned char out[16])
+{
+    EncodeBc4(rgba + 3, out);
+    EncodeBc1Color(rgba, out + 8);
+}
+
+void EncodeBC5Block(const unsigned char rgba[64], unsigned char out[16])
+{
+    EncodeBc4(rgba + 0, out);
+    EncodeBc4(rgba + 1, out + 8);
+}
+
+void DecodeBC1Block(const unsigned char* block, unsigned char rgba[64])
+{
+    DecodeBc1Color(block, false, rgba);
+}
+
+void DecodeBC3Block(const unsigned char* block, unsigned char rgba[64])
+{
+    DecodeBc1Color(block + 8, true, rgba);
+    DecodeBc4(block, rgba + 3);
+}
+
+void DecodeBC5Block(const unsigned char* block, unsigned char rgba[64])
+{
+    DecodeBc4(block, rgba + 0);
+    DecodeBc4(block + 8, rgba + 1);
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 2] = 0;
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+bool CompressImage(const unsigned char* rgba, int width, int height, BlockFormat format,
+                   unsigned char* out, unsigned threads)
+{
+    void (*encode)(const unsigned char*, unsigned char*) = nullptr;
+    switch (format) {
+    case BlockFormat::BC1: encode = EncodeBC1Block; break;
+    case BlockFormat::BC3: encode = EncodeBC3Block; break;
+    case BlockFormat::BC5: encode = EncodeBC5Block; break;
+    case BlockFormat::BC7: return false;
+    }
+
+    int blocksX = std::max(1, (width + 3) / 4);
+    int blocksY = std::max(1, (height + 3) / 4);
+    size_t blockBytes = BlockBytes(format);
+    ParallelFor((size_t)blocksY, [&](size_t begin, size_t end, unsigned) {
+        unsigned char block[64];
+        for (size_t by = begin; by < end; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                GatherBlock(rgba, width, height, bx, (int)by, block);
+                encode(block, out + (by * blocksX + bx) * blockBytes);
+            }
+        }
+    }, threads);
+    return true;
+}
+
+bool DecompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba)
+{
+    void (*decode)(const unsigned char*, unsigned char*) = nullptr;
+    switch (format) {
+    case BlockFormat::BC1: decode = DecodeBC1Block; break;
+    case BlockFormat::BC3: decode = DecodeBC3Block; break;
+    case BlockFormat::BC5: decode = DecodeBC5Block; break;
+    case BlockFormat::BC7: return false;
+    }
+
+    int blocksX = std::max(1, (width + 3) / 4);
+    int blocksY = std::max(1, (height + 3) / 4);
+    size_t blockBytes = BlockBytes(format);
+    unsigned char block[64];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            decode(blocks + ((size_t)by * blocksX + bx) * blockBytes, block);
+            for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+                    std::memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+            }
+        }
+    }
+    return true;
+}
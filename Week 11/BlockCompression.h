@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Block-compressed texture formats, stored in 4x4 pixel blocks.
+//   BC1  RGB, 8 bytes per block (4 bpp)
+//   BC3  RGBA, BC1 colour plus a BC4 alpha block, 16 bytes per block
+//   BC5  two BC4 channels (RG), 16 bytes per block; for tangent-space
+//        normal maps, with z rebuilt in the shader
+//   BC7  RGBA, 16 bytes per block; loaded and uploaded but not encoded here
+enum class BlockFormat : uint32_t {
+    BC1,
+    BC3,
+    BC5,
+    BC7,
+};
+
+size_t BlockBytes(BlockFormat format);
+
+// Bytes needed for a width x height image (partial blocks are padded).
+size_t CompressedSize(BlockFormat format, int width, int height);
+
+const char* BlockFormatName(BlockFormat format);
+
+// Encodes 16 RGBA pixels (row-major 4x4) into one block.
+void EncodeBC1Block(const unsigned char rgba[64], unsigned char out[8]);
+void EncodeBC3Block(const unsigned char rgba[64], unsigned char out[16]);
+void EncodeBC5Block(const unsigned char rgba[64], unsigned char out[16]);
+
+// Decodes one block back to 16 RGBA pixels. BC5 writes R and G and sets
+// B to 0 and A to 255.
+void DecodeBC1Block(const unsigned char* block, unsigned char rgba[64]);
+void DecodeBC3Block(const unsigned char* block, unsigned char rgba[64]);
+void DecodeBC5Block(const unsigned char* block, unsigned char rgba[64]);
+
+// Compresses a whole RGBA8 image, splitting block rows across threads.
+// Edge blocks repeat the last row/column. Returns false for BC7.
+bool CompressImage(const unsigned char* rgba, int width, int height, BlockFormat format,
+                   unsigned char* out, unsigned threads = 0);
+
+// Decompresses to RGBA8, for checking encoder error. Returns false for BC7.
+bool DecompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba);
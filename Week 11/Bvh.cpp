@@ -0,0 +1,230 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+Aabb BoxOf(const CullBounds& bounds, size_t object)
+{
+    glm::vec3 center(bounds.centerX[object], bounds.centerY[object], bounds.centerZ[object]);
+    glm::vec3 extent(bounds.extentX[object], bounds.extentY[object], bounds.extentZ[object]);
+    Aabb box;
+    box.min = center - extent;
+    box.max = center + extent;
+    return box;
+}
+
+void Bvh::build(const std::vector<Aabb>& boxes)
+{
+    uint32_t count = (uint32_t)boxes.size();
+    m_nodes.clear();
+    m_parents.clear();
+    m_primitives.resize(count);
+    std::iota(m_primitives.begin(), m_primitives.end(), 0u);
+    m_leafOf.assign(count, 0);
+    if (count == 0)
+        return;
+
+    std::vector<glm::vec3> centers(count);
+    for (uint32_t i = 0; i < count; i++)
+        centers[i] = boxes[i].center();
+
+    // A binary tree with count leaves has at most 2 * count - 1 nodes, so
+    // references into m_nodes stay valid while children are added.
+    m_nodes.reserve(2 * (size_t)count);
+    m_parents.reserve(2 * (size_t)count);
+    Node root;
+    root.count = count;
+    m_nodes.push_back(root);
+    m_parents.push_back(0);
+
+    std::vector<std::pair<uint32_t, int>> pending = { { 0u, 0 } };
+    while (!pending.empty()) {
+        uint32_t index = pending.back().first;
+        int depth = pending.back().second;
+        pending.pop_back();
+
+        refitNode(m_nodes[index], boxes);
+        if (depth < MAX_DEPTH && split(index, centers, boxes)) {
+            pending.push_back({ m_nodes[index].left, depth + 1 });
+            pending.push_back({ m_nodes[index].left + 1, depth + 1 });
+        }
+        else {
+            const Node& leaf = m_nodes[index];
+            for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++)
+                m_leafOf[m_primitives[i]] = index;
+        }
+    }
+}
+
+bool Bvh::split(uint32_t index, const std::vector<glm::vec3>& centers, const std::vector<Aabb>& boxes)
+{
+    Node& node = m_nodes[index];
+    if (node.count <= MAX_LEAF_SIZE)
+        return false;
+    uint32_t* first = &m_primitives[node.first];
+    uint32_t* last = first + node.count;
+
+    // Binned on the centres, which spread out even where the boxes overlap.
+    Aabb centerBox;
+    for (uint32_t* p = first; p != last; p++)
+        centerBox.grow(centers[*p]);
+
+    // Cost of a split relative to leaving the node as a leaf: the chance of
+    // visiting each child (its area) times the primitives it holds.
+    float bestCost = node.count * node.box.area();
+    int bestAxis = -1, bestBin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = centerBox.min[axis];
+        float extent = centerBox.max[axis] - lo;
+        if (extent <= 0.f)
+            continue;
+
+        Aabb binBoxes[SAH_BINS];
+        uint32_t binCounts[SAH_BINS] = {};
+        float scale = SAH_BINS / extent;
+        for (uint32_t* p = first; p != last; p++) {
+            int bin = std::min(SAH_BINS - 1, (int)((centers[*p][axis] - lo) * scale));
+            binCounts[bin]++;
+            binBoxes[bin].grow(boxes[*p]);
+        }
+
+        // Sweep from the left, then from the right to price every plane
+        // between two bins.
+        float leftArea[SAH_BINS - 1];
+        uint32_t leftCount[SAH_BINS - 1];
+        Aabb left;
+        uint32_t n = 0;
+        for (int i = 0; i < SAH_BINS - 1; i++) {
+            left.grow(binBoxes[i]);
+            n += binCounts[i];
+            leftArea[i] = left.area();
+            leftCount[i] = n;
+        }
+        Aabb right;
+        n = 0;
+        for (int i = SAH_BINS - 1; i > 0; i--) {
+            right.grow(binBoxes[i]);
+            n += binCounts[i];
+            if (leftCount[i - 1] == 0 || n == 0)
+                continue;
+            float cost = leftCount[i - 1] * leftArea[i - 1] + n * right.area();
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = i;
+            }
+        }
+    }
+    if (bestAxis < 0)
+        return false;
+
+    float lo = centerBox.min[bestAxis];
+    float scale = SAH_BINS / (centerBox.max[bestAxis] - lo);
+    uint32_t* middle = std::partition(first, last, [&](uint32_t p) {
+        return std::min(SAH_BINS - 1, (int)((centers[p][bestAxis] - lo) * scale)) < bestBin;
+    });
+    uint32_t leftCount = (uint32_t)(middle - first);
+    if (leftCount == 0 || leftCount == node.count)
+        return false;
+
+    Node leftChild, rightChild;
+    leftChild.first = node.first;
+    leftChild.count = leftCount;
+    rightChild.first = node.first + leftCount;
+    rightChild.count = node.count - leftCount;
+    node.left = (uint32_t)m_nodes.size();
+    m_nodes.push_back(leftChild);
+    m_nodes.push_back(rightChild);
+    m_parents.push_back(index);
+    m_parents.push_back(index);
+    return true;
+}
+
+void Bvh::refitNode(Node& node, const std::vector<Aabb>& boxes)
+{
+    node.box = Aabb();
+    if (node.left) {
+        node.box.grow(m_nodes[node.left].box);
+        node.box.grow(m_nodes[node.left + 1].box);
+        return;
+    }
+    for (uint32_t i = node.first; i < node.first + node.count; i++)
+        node.box.grow(boxes[m_primitives[i]]);
+}
+
+void Bvh::refit(const std::vector<Aabb>& boxes)
+{
+    // Children are always stored after their parent.
+    for (size_t i = m_nodes.size(); i-- > 0;)
+        refitNode(m_nodes[i], boxes);
+}
+
+void Bvh::refit(const std::vector<Aabb>& boxes, uint32_t primitive)
+{
+    if (primitive >= m_leafOf.size())
+        return;
+    for (uint32_t index = m_leafOf[primitive]; ; index = m_parents[index]) {
+        refitNode(m_nodes[index], boxes);
+        if (index == 0)
+            break;
+    }
+}
+
+void Bvh::cull(const std::vector<Aabb>& boxes, const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (m_nodes.empty())
+        return;
+
+    glm::vec3 absNormals[6];
+    for (int p = 0; p < 6; p++)
+        absNormals[p] = glm::abs(glm::vec3(frustum.planes[p]));
+
+    // Which planes a box is outside of, or crossing; planes a node is fully
+    // inside of are dropped for its whole subtree.
+    const uint32_t ALL_PLANES = 0x3F;
+    auto classify = [&](const Aabb& box, uint32_t& planes) {
+        glm::vec3 center = box.center();
+        glm::vec3 extent = (box.max - box.min) * 0.5f;
+        for (int p = 0; p < 6; p++) {
+            if (!(planes & (1u << p)))
+                continue;
+            float distance = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w;
+            float reach = glm::dot(absNormals[p], extent);
+            if (distance + reach < 0.f)
+                return false;
+            if (distance - reach >= 0.f)
+                planes &= ~(1u << p);
+        }
+        return true;
+    };
+
+    struct Entry {
+        uint32_t node;
+        uint32_t planes;
+    };
+    Entry stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = { 0, ALL_PLANES };
+    while (top > 0) {
+        Entry entry = stack[--top];
+        const Node& node = m_nodes[entry.node];
+        if (!classify(node.box, entry.planes))
+            continue;
+
+        if (entry.planes == 0) {
+            visible.insert(visible.end(), m_primitives.begin() + node.first,
+                           m_primitives.begin() + node.first + node.count);
+        }
+        else if (!node.left) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t planes = entry.planes;
+                if (classify(boxes[m_primitives[i]], planes))
+                    visible.push_back(m_primitives[i]);
+            }
+        }
+        else {
+            stack[top++] = { node.left, entry.planes };
+            stack[top++] = { node.left + 1, entry.planes };
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Culling.h"
+
+struct Aabb {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void grow(const Aabb& box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    // Half the surface area, which is all the SAH needs.
+    float area() const
+    {
+        glm::vec3 d = glm::max(max - min, glm::vec3(0.f));
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+// The box of one object in a CullBounds.
+Aabb BoxOf(const CullBounds& bounds, size_t object);
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// Distance along the ray to where it enters the box, if it does before
+// maxDistance. invDirection is 1 / ray.direction.
+inline bool IntersectRayAabb(const Ray& ray, const glm::vec3& invDirection, const Aabb& box, float maxDistance,
+                             float& entry)
+{
+    glm::vec3 t0 = (box.min - ray.origin) * invDirection;
+    glm::vec3 t1 = (box.max - ray.origin) * invDirection;
+    glm::vec3 enter = glm::min(t0, t1), leave = glm::max(t0, t1);
+    entry = std::fmax(std::fmax(enter.x, enter.y), std::fmax(enter.z, 0.f));
+    float exit = std::fmin(std::fmin(leave.x, leave.y), std::fmin(leave.z, maxDistance));
+    return entry <= exit;
+}
+
+// Bounding volume hierarchy over a list of boxes ("primitives": scene
+// objects, or the triangles of a mesh). Built top down, splitting each node
+// where the surface area heuristic is lowest among SAH_BINS candidate
+// planes per axis.
+//
+// When primitives move, refit() grows and shrinks the node boxes without
+// changing the tree; refit(boxes, primitive) does it for the one leaf and
+// its ancestors. The tree gets looser as objects move far from where it was
+// built, so rebuild after large changes.
+class Bvh {
+public:
+    static const int SAH_BINS = 16;
+    static const uint32_t MAX_LEAF_SIZE = 4;
+    // Nodes this deep become leaves whatever their size, which bounds the
+    // traversal stacks.
+    static const int MAX_DEPTH = 48;
+
+    void build(const std::vector<Aabb>& boxes);
+    void refit(const std::vector<Aabb>& boxes);
+    void refit(const std::vector<Aabb>& boxes, uint32_t primitive);
+
+    // Appends the primitives whose boxes are not fully outside a frustum
+    // plane, in no particular order. Subtrees entirely inside the frustum
+    // are appended without testing their primitives.
+    void cull(const std::vector<Aabb>& boxes, const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // Nearest hit along the ray. intersect(primitive, distance) is called
+    // for every primitive whose box the ray enters closer than the nearest
+    // hit so far; it returns true and lowers distance when the primitive
+    // itself is hit closer. Returns the hit primitive, or false when there
+    // is none before maxDistance.
+    template <typename Intersect>
+    bool raycast(const Ray& ray, float maxDistance, Intersect&& intersect, uint32_t& primitive, float& distance) const;
+
+    size_t nodeCount() const { return m_nodes.size(); }
+    size_t primitiveCount() const { return m_primitives.size(); }
+
+private:
+    struct Node {
+        Aabb box;
+        uint32_t first = 0; // into m_primitives; the subtree's primitives are contiguous
+        uint32_t count = 0;
+        uint32_t left = 0;  // children are left and left + 1; 0 for a leaf
+    };
+
+    bool split(uint32_t index, const std::vector<glm::vec3>& centers, const std::vector<Aabb>& boxes);
+    void refitNode(Node& node, const std::vector<Aabb>& boxes);
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_primitives;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_leafOf; // leaf node of each primitive
+};
+
+template <typename Intersect>
+bool Bvh::raycast(const Ray& ray, float maxDistance, Intersect&& intersect, uint32_t& primitive, float& distance) const
+{
+    if (m_nodes.empty())
+        return false;
+
+    glm::vec3 invDirection = 1.f / ray.direction;
+    distance = maxDistance;
+    bool hit = false;
+
+    uint32_t stack[MAX_DEPTH + 2];
+    int top = 0;
+    float entry;
+    if (IntersectRayAabb(ray, invDirection, m_nodes[0].box, distance, entry))
+        stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        if (!node.left) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (intersect(m_primitives[i], distance)) {
+                    primitive = m_primitives[i];
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        // Nearer child on top of the stack, so its hits prune the other.
+        float entryA, entryB;
+        bool a = IntersectRayAabb(ray, invDirection, m_nodes[node.left].box, distance, entryA);
+        bool b = IntersectRayAabb(ray, invDirection, m_nodes[node.left + 1].box, distance, entryB);
+        if (a && b) {
+            stack[top++] = entryA < entryB ? node.left + 1 : node.left;
+            stack[top++] = entryA < entryB ? node.left : node.left + 1;
+        }
+        else if (a)
+            stack[top++] = node.left;
+        else if (b)
+            stack[top++] = node.left + 1;
+    }
+    return hit;
+}
@@ -0,0 +1,305 @@
+#include "CompressedTexture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+const uint32_t DDSD_CAPS = 0x1;
+const uint32_t DDSD_HEIGHT = 0x2;
+const uint32_t DDSD_WIDTH = 0x4;
+const uint32_t DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8;
+const uint32_t DDSCAPS_TEXTURE = 0x1000;
+const uint32_t DDSCAPS_MIPMAP = 0x400000;
+const uint32_t DDSCAPS2_CUBEMAP_ALL_FACES = 0xFE00;
+const uint32_t DDS_RESOURCE_DIMENSION_TEXTURE2D = 3;
+const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+// Marks files written by save(); the cook tag follows it.
+const uint32_t COOK_MARKER = 0x4B4F4F43; // "COOK"
+
+constexpr uint32_t FourCC(const char (&code)[5])
+{
+    return (uint32_t)code[0] | (uint32_t)code[1] << 8 | (uint32_t)code[2] << 16 | (uint32_t)code[3] << 24;
+}
+
+struct DdsPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t masks[4];
+};
+
+struct DdsHeader {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DdsPixelFormat pixelFormat;
+    uint32_t caps[4];
+    uint32_t reserved2;
+};
+
+struct DdsHeaderDx10 {
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DdsHeader) == 124, "DDS header is 124 bytes");
+static_assert(sizeof(DdsHeaderDx10) == 20, "DX10 header is 20 bytes");
+
+struct DxgiMapping {
+    uint32_t dxgi;
+    BlockFormat format;
+};
+
+// UNORM DXGI formats. The sRGB variants are not accepted: the shaders do
+// their lighting on the raw texel values, as they did with GL_RGB.
+const DxgiMapping DXGI_FORMATS[] = {
+    { 71, BlockFormat::BC1 },
+    { 77, BlockFormat::BC3 },
+    { 83, BlockFormat::BC5 },
+    { 98, BlockFormat::BC7 },
+};
+
+const DxgiMapping LEGACY_FOURCC[] = {
+    { FourCC("DXT1"), BlockFormat::BC1 },
+    { FourCC("DXT5"), BlockFormat::BC3 },
+    { FourCC("ATI2"), BlockFormat::BC5 },
+    { FourCC("BC5U"), BlockFormat::BC5 },
+};
+
+} // namespace
+
+GLenum GlCompressedFormat(BlockFormat format)
+{
+    switch (format) {
+    case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+int MipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+CompressedTexture::CompressedTexture(BlockFormat format, int width, int height, int levels, int faces)
+    : m_format(format), m_width(width), m_height(height), m_levels(levels), m_faces(faces)
+{
+    m_size = offsetOf(faces, 0);
+    m_owned.resize(m_size);
+    m_data = m_owned.data();
+}
+
+CompressedTexture::CompressedTexture(CompressedTexture&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+CompressedTexture& CompressedTexture::operator=(CompressedTexture&& other) noexcept
+{
+    if (this != &other) {
+        std::swap(m_format, other.m_format);
+        std::swap(m_width, other.m_width);
+        std::swap(m_height, other.m_height);
+        std::swap(m_levels, other.m_levels);
+        std::swap(m_faces, other.m_faces);
+        std::swap(m_owned, other.m_owned);
+        std::swap(m_file, other.m_file);
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+    }
+    return *this;
+}
+
+int CompressedTexture::levelWidth(int level) const
+{
+    return std::max(1, m_width >> level);
+}
+
+int CompressedTexture::levelHeight(int level) const
+{
+    return std::max(1, m_height >> level);
+}
+
+size_t CompressedTexture::levelSize(int level) const
+{
+    return CompressedSize(m_format, levelWidth(level), levelHeight(level));
+}
+
+size_t CompressedTexture::offsetOf(int face, int level) const
+{
+    size_t faceSize = 0;
+    for (int l = 0; l < m_levels; l++)
+        faceSize += levelSize(l);
+    size_t offset = faceSize * face;
+    for (int l = 0; l < level; l++)
+        offset += levelSize(l);
+    return offset;
+}
+
+const unsigned char* CompressedTexture::levelData(int face, int level) const
+{
+    return m_data + offsetOf(face, level);
+}
+
+unsigned char* CompressedTexture::writableLevelData(int face, int level)
+{
+    return m_owned.empty() ? nullptr : m_owned.data() + offsetOf(face, level);
+}
+
+bool CompressedTexture::save(const std::string& path, uint32_t cookTag) const
+{
+    if (!m_data)
+        return false;
+
+    DdsHeader header = {};
+    header.size = sizeof(DdsHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = (uint32_t)m_height;
+    header.width = (uint32_t)m_width;
+    header.pitchOrLinearSize = (uint32_t)levelSize(0);
+    header.mipMapCount = (uint32_t)m_levels;
+    header.reserved1[0] = COOK_MARKER;
+    header.reserved1[1] = cookTag;
+    header.pixelFormat.size = sizeof(DdsPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = FourCC("DX10");
+    header.caps[0] = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    header.caps[1] = m_faces == 6 ? DDSCAPS2_CUBEMAP_ALL_FACES : 0;
+
+    DdsHeaderDx10 dx10 = {};
+    for (const DxgiMapping& mapping : DXGI_FORMATS) {
+        if (mapping.format == m_format)
+            dx10.dxgiFormat = mapping.dxgi;
+    }
+    dx10.resourceDimension = DDS_RESOURCE_DIMENSION_TEXTURE2D;
+    dx10.miscFlag = m_faces == 6 ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+    dx10.arraySize = 1;
+
+    // Write to a temporary name first so a half-written file is never
+    // picked up by a later load.
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(&DDS_MAGIC, sizeof(DDS_MAGIC), 1, file) == 1 &&
+              std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(&dx10, sizeof(dx10), 1, file) == 1 &&
+              std::fwrite(m_data, 1, m_size, file) == m_size;
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) {
+        std::remove(path.c_str());
+        ok = std::rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+        std::remove(tempPath.c_str());
+    return ok;
+}
+
+bool CompressedTexture::load(const std::string& path, uint32_t* cookTag)
+{
+    *this = CompressedTexture();
+
+    MappedFile file;
+    if (!file.open(path.c_str()) || file.size() < sizeof(DDS_MAGIC) + sizeof(DdsHeader))
+        return false;
+
+    uint32_t magic;
+    DdsHeader header;
+    std::memcpy(&magic, file.data(), sizeof(magic));
+    std::memcpy(&header, file.data() + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || !(header.pixelFormat.flags & DDPF_FOURCC))
+        return false;
+
+    size_t dataOffset = sizeof(magic) + sizeof(header);
+    bool found = false;
+    int faces = (header.caps[1] & DDSCAPS2_CUBEMAP_ALL_FACES) == DDSCAPS2_CUBEMAP_ALL_FACES ? 6 : 1;
+    if (header.pixelFormat.fourCC == FourCC("DX10")) {
+        DdsHeaderDx10 dx10;
+        if (file.size() < dataOffset + sizeof(dx10))
+            return false;
+        std::memcpy(&dx10, file.data() + dataOffset, sizeof(dx10));
+        dataOffset += sizeof(dx10);
+        if (dx10.resourceDimension != DDS_RESOURCE_DIMENSION_TEXTURE2D || dx10.arraySize != 1)
+            return false;
+        faces = dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE ? 6 : 1;
+        for (const DxgiMapping& mapping : DXGI_FORMATS) {
+            if (mapping.dxgi == dx10.dxgiFormat) {
+                m_format = mapping.format;
+                found = true;
+            }
+        }
+    }
+    else {
+        for (const DxgiMapping& mapping : LEGACY_FOURCC) {
+            if (mapping.dxgi == header.pixelFormat.fourCC) {
+                m_format = mapping.format;
+                found = true;
+            }
+        }
+    }
+    if (!found || header.width == 0 || header.height == 0)
+        return false;
+
+    m_width = (int)header.width;
+    m_height = (int)header.height;
+    m_levels = std::clamp((int)header.mipMapCount, 1, MipLevelCount(m_width, m_height));
+    m_faces = faces;
+    m_size = offsetOf(faces, 0);
+    if (file.size() < dataOffset + m_size) {
+        *this = CompressedTexture();
+        return false;
+    }
+
+    if (cookTag)
+        *cookTag = header.reserved1[0] == COOK_MARKER ? header.reserved1[1] : 0;
+    m_data = (const unsigned char*)file.data() + dataOffset;
+    m_file = std::move(file);
+    return true;
+}
+
+bool CompressedTexture::upload(GLenum target) const
+{
+    if (!m_data)
+        return false;
+
+    bool cubeFace = target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+    GLenum boundTarget = m_faces == 6 || cubeFace ? GL_TEXTURE_CUBE_MAP : target;
+    GLenum internalFormat = GlCompressedFormat(m_format);
+    for (int face = 0; face < m_faces; face++) {
+        GLenum faceTarget = m_faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+        for (int level = 0; level < m_levels; level++) {
+            glCompressedTexImage2D(faceTarget, level, internalFormat, levelWidth(level), levelHeight(level), 0,
+                                   (GLsizei)levelSize(level), levelData(face, level));
+        }
+    }
+    glTexParameteri(boundTarget, GL_TEXTURE_MAX_LEVEL, m_levels - 1);
+    return true;
+}
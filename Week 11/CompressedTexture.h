@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "BlockCompression.h"
+#include "MappedFile.h"
+
+// A block-compressed texture with its full mip chain: one or six faces,
+// each holding levels 0..levels-1 back to back, as laid out in a DDS file.
+// The bytes are either owned (just cooked) or point into a mapped .dds.
+class CompressedTexture {
+public:
+    CompressedTexture() = default;
+    CompressedTexture(BlockFormat format, int width, int height, int levels, int faces = 1);
+
+    CompressedTexture(CompressedTexture&& other) noexcept;
+    CompressedTexture& operator=(CompressedTexture&& other) noexcept;
+    CompressedTexture(const CompressedTexture&) = delete;
+    CompressedTexture& operator=(const CompressedTexture&) = delete;
+
+    BlockFormat format() const { return m_format; }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int levels() const { return m_levels; }
+    int faces() const { return m_faces; }
+    size_t size() const { return m_size; }
+
+    int levelWidth(int level) const;
+    int levelHeight(int level) const;
+    size_t levelSize(int level) const;
+    const unsigned char* levelData(int face, int level) const;
+    // Null unless the texture owns its bytes (constructed, not loaded).
+    unsigned char* writableLevelData(int face, int level);
+
+    explicit operator bool() const { return m_data != nullptr; }
+
+    // Standard DDS with a DX10 header, so other tools can open the files.
+    // `cookTag` goes in a reserved header field; load() returns it so the
+    // caller can tell which settings produced the file.
+    bool save(const std::string& path, uint32_t cookTag = 0) const;
+    bool load(const std::string& path, uint32_t* cookTag = nullptr);
+
+    // Uploads every level with glCompressedTexImage2D to the texture bound
+    // to GL_TEXTURE_2D, or GL_TEXTURE_CUBE_MAP for six faces. A single-face
+    // texture can also go to one cube face by passing that face's target.
+    // No glGenerateMipmap is needed afterwards.
+    bool upload(GLenum target = GL_TEXTURE_2D) const;
+
+private:
+    size_t offsetOf(int face, int level) const;
+
+    BlockFormat m_format = BlockFormat::BC1;
+    int m_width = 0;
+    int m_height = 0;
+    int m_levels = 0;
+    int m_faces = 0;
+
+    std::vector<unsigned char> m_owned;
+    MappedFile m_file;
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// The GL internal format for a block format.
+GLenum GlCompressedFormat(BlockFormat format);
+
+// Number of levels in a full mip chain down to 1x1.
+int MipLevelCount(int width, int height);
@@ -0,0 +1,214 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#define CULLING_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// True when the sphere or the AABB lies entirely outside the plane: the
+// centre is further out than the tighter of the two reaches towards it.
+// Summed in the same order as the SIMD versions so the results match.
+inline bool Outside(const glm::vec4& plane, const glm::vec3& absNormal, const CullBounds& bounds, size_t i)
+{
+    float distance = (plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i]) +
+                     (plane.z * bounds.centerZ[i] + plane.w);
+    float boxReach = (absNormal.x * bounds.extentX[i] + absNormal.y * bounds.extentY[i]) +
+                     absNormal.z * bounds.extentZ[i];
+    return !(distance + std::min(bounds.radius[i], boxReach) >= 0.f);
+}
+
+// Appends the objects whose bit is set in mask, lane 0 being object first.
+inline size_t Compact(int mask, size_t first, uint32_t* visible, size_t n)
+{
+    for (uint32_t object = (uint32_t)first; mask; object++, mask >>= 1) {
+        if (mask & 1)
+            visible[n++] = object;
+    }
+    return n;
+}
+
+} // namespace
+
+Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+    // Rows of the matrix; glm indexes [column][row].
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[3] + rows[2]; // near
+    frustum.planes[5] = rows[3] - rows[2]; // far
+    for (glm::vec4& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+void CullBounds::resize(size_t objects)
+{
+    count = objects;
+    size_t padded = (objects + CULL_BATCH - 1) / CULL_BATCH * CULL_BATCH;
+    for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+        component->resize(padded, 0.f);
+}
+
+void CullBounds::set(size_t object, const glm::mat4& transform, const MeshView& mesh)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4((mesh.aabbMin + mesh.aabbMax) * 0.5f, 1.f));
+    glm::vec3 extent = (mesh.aabbMax - mesh.aabbMin) * 0.5f;
+    glm::mat3 linear(transform);
+    glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+    glm::vec3 worldExtent = absLinear * extent;
+    float scale = std::max({ glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]) });
+
+    centerX[object] = center.x;
+    centerY[object] = center.y;
+    centerZ[object] = center.z;
+    extentX[object] = worldExtent.x;
+    extentY[object] = worldExtent.y;
+    extentZ[object] = worldExtent.z;
+    radius[object] = mesh.boundingRadius * scale;
+}
+
+size_t CullObjectsScalar(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible)
+{
+    glm::vec3 absNormals[6];
+    for (int p = 0; p < 6; p++)
+        absNormals[p] = glm::abs(glm::vec3(frustum.planes[p]));
+
+    size_t n = 0;
+    for (size_t i = 0; i < bounds.count; i++) {
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++)
+            outside = Outside(frustum.planes[p], absNormals[p], bounds, i);
+        if (!outside)
+            visible[n++] = (uint32_t)i;
+    }
+    return n;
+}
+
+#if defined(CULLING_AVX)
+
+size_t CullObjects(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible)
+{
+    __m256 normalX[6], normalY[6], normalZ[6], distance[6], absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        normalX[p] = _mm256_set1_ps(plane.x);
+        normalY[p] = _mm256_set1_ps(plane.y);
+        normalZ[p] = _mm256_set1_ps(plane.z);
+        distance[p] = _mm256_set1_ps(plane.w);
+        absX[p] = _mm256_set1_ps(std::fabs(plane.x));
+        absY[p] = _mm256_set1_ps(std::fabs(plane.y));
+        absZ[p] = _mm256_set1_ps(std::fabs(plane.z));
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t n = 0;
+    for (size_t i = 0; i < bounds.count; i += CULL_BATCH) {
+        __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+        __m256 r = _mm256_loadu_ps(&bounds.radius[i]);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX[p], cx), _mm256_mul_ps(normalY[p], cy)),
+                                     _mm256_add_ps(_mm256_mul_ps(normalZ[p], cz), distance[p]));
+            __m256 boxReach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absX[p], ex), _mm256_mul_ps(absY[p], ey)),
+                                            _mm256_mul_ps(absZ[p], ez));
+            __m256 reach = _mm256_min_ps(r, boxReach);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, reach), zero, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        if (bounds.count - i < CULL_BATCH)
+            mask &= (1 << (bounds.count - i)) - 1;
+        n = Compact(mask, i, visible, n);
+    }
+    return n;
+}
+
+const char* CullingInstructionSet()
+{
+    return "avx";
+}
+
+#elif defined(CULLING_SSE)
+
+size_t CullObjects(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible)
+{
+    __m128 normalX[6], normalY[6], normalZ[6], distance[6], absX[6], absY[6], absZ[6];
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        normalX[p] = _mm_set1_ps(plane.x);
+        normalY[p] = _mm_set1_ps(plane.y);
+        normalZ[p] = _mm_set1_ps(plane.z);
+        distance[p] = _mm_set1_ps(plane.w);
+        absX[p] = _mm_set1_ps(std::fabs(plane.x));
+        absY[p] = _mm_set1_ps(std::fabs(plane.y));
+        absZ[p] = _mm_set1_ps(std::fabs(plane.z));
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t n = 0;
+    for (size_t i = 0; i < bounds.count; i += CULL_BATCH) {
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], cx), _mm_mul_ps(normalY[p], cy)),
+                                  _mm_add_ps(_mm_mul_ps(normalZ[p], cz), distance[p]));
+            __m128 boxReach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                                         _mm_mul_ps(absZ[p], ez));
+            __m128 reach = _mm_min_ps(r, boxReach);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, reach), zero));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        if (bounds.count - i < CULL_BATCH)
+            mask &= (1 << (bounds.count - i)) - 1;
+        n = Compact(mask, i, visible, n);
+    }
+    return n;
+}
+
+const char* CullingInstructionSet()
+{
+    return "sse";
+}
+
+#else
+
+size_t CullObjects(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible)
+{
+    return CullObjectsScalar(frustum, bounds, visible);
+}
+
+const char* CullingInstructionSet()
+{
+    return "scalar";
+}
+
+#endif
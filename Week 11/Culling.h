@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+// The six planes of a view frustum as (normal, distance), normals pointing
+// inwards and normalized, so dot(normal, p) + distance is the signed
+// distance of p from the plane.
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Extracts the planes from a projection * view matrix (Gribb/Hartmann,
+// OpenGL clip space). The planes are in world space.
+Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+// Objects tested per iteration of the culling loop: 8 with AVX, otherwise 4.
+#if defined(__AVX__)
+const size_t CULL_BATCH = 8;
+#else
+const size_t CULL_BATCH = 4;
+#endif
+
+// World-space bounds of many objects, one array per component so the
+// culling loop loads CULL_BATCH objects with one instruction per component.
+// Each object has a bounding sphere and an AABB with the same centre; it is
+// culled when either lies entirely outside one of the planes. The arrays
+// are padded to a multiple of CULL_BATCH.
+struct CullBounds {
+    size_t count = 0;
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ; // AABB half size
+    std::vector<float> radius;
+
+    void resize(size_t objects);
+
+    // Bounds of the mesh drawn with the given model matrix: the AABB is the
+    // box around the transformed mesh AABB and the radius is scaled by the
+    // largest axis scale.
+    void set(size_t object, const glm::mat4& transform, const MeshView& mesh);
+};
+
+// Writes the indices of the objects that are not culled to visible, which
+// needs room for bounds.count entries, in ascending order and returns how
+// many there are. Uses AVX or SSE when the build targets them.
+size_t CullObjects(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible);
+
+// The same test one object at a time, as a reference.
+size_t CullObjectsScalar(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible);
+
+// "avx", "sse" or "scalar": what CullObjects was built with.
+const char* CullingInstructionSet();
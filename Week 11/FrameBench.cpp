@@ -0,0 +1,202 @@
+#include "FrameBench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "PngWriter.h"
+#include "Stats.h"
+
+namespace {
+
+struct ScriptedKey {
+    int frame;
+    int key;
+    int action;
+};
+
+// One 240-frame loop: spin, move, scale up and back, then rotate the other
+// way. Every press is released again, so the loop can repeat.
+const int SCRIPT_LENGTH = 240;
+const ScriptedKey INPUT_SCRIPT[] = {
+    { 0, GLFW_KEY_RIGHT, GLFW_PRESS },
+    { 60, GLFW_KEY_RIGHT, GLFW_RELEASE },
+    { 60, GLFW_KEY_D, GLFW_PRESS },
+    { 90, GLFW_KEY_D, GLFW_RELEASE },
+    { 90, GLFW_KEY_UP, GLFW_PRESS },
+    { 120, GLFW_KEY_UP, GLFW_RELEASE },
+    { 120, GLFW_KEY_E, GLFW_PRESS },
+    { 130, GLFW_KEY_E, GLFW_RELEASE },
+    { 130, GLFW_KEY_Q, GLFW_PRESS },
+    { 140, GLFW_KEY_Q, GLFW_RELEASE },
+    { 140, GLFW_KEY_A, GLFW_PRESS },
+    { 170, GLFW_KEY_A, GLFW_RELEASE },
+    { 170, GLFW_KEY_LEFT, GLFW_PRESS },
+    { 230, GLFW_KEY_LEFT, GLFW_RELEASE },
+};
+
+struct Summary {
+    double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+Summary Summarize(std::vector<double> samples)
+{
+    Summary summary;
+    if (samples.empty())
+        return summary;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        size_t rank = (size_t)(p * (samples.size() - 1) + 0.5);
+        return samples[rank];
+    };
+    for (double s : samples)
+        summary.mean += s;
+    summary.mean /= samples.size();
+    summary.p50 = percentile(0.5);
+    summary.p90 = percentile(0.9);
+    summary.p99 = percentile(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+void PrintSummary(const char* name, const Summary& s, bool last = false)
+{
+    std::printf("  \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+                name, s.mean * 1000.0, s.p50 * 1000.0, s.p90 * 1000.0, s.p99 * 1000.0, s.max * 1000.0, last ? "" : ",");
+}
+
+} // namespace
+
+bool ParseFrameBenchOptions(int argc, char** argv, FrameBenchOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+                std::fprintf(stderr, "--bench needs a frame count\n");
+                return false;
+            }
+            options.frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        }
+        else if (strcmp(argv[i], "--dump") == 0) {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "--dump needs a file name\n");
+                return false;
+            }
+            options.dumpPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--instances") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+                std::fprintf(stderr, "--instances needs a count\n");
+                return false;
+            }
+            options.instances = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--draw-per-instance") == 0) {
+            options.drawPerInstance = true;
+        }
+        else if (strcmp(argv[i], "--direct-draws") == 0) {
+            options.directDraws = true;
+        }
+        else if (strcmp(argv[i], "--software") == 0) {
+            options.software = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+                std::fprintf(stderr, "--threads needs a count\n");
+                return false;
+            }
+            options.threads = (unsigned)atoi(argv[++i]);
+        }
+    }
+    if (options.software && !options.enabled()) {
+        std::fprintf(stderr, "--software needs --bench\n");
+        return false;
+    }
+    return true;
+}
+
+void ApplyFrameBenchWindowHints(const FrameBenchOptions& options)
+{
+    if (!options.headless)
+        return;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+}
+
+void ApplyScriptedInput(GLFWwindow* window, int frame, GLFWkeyfun keyCallback)
+{
+    int loopFrame = frame % SCRIPT_LENGTH;
+    for (const ScriptedKey& event : INPUT_SCRIPT) {
+        if (event.frame == loopFrame)
+            keyCallback(window, event.key, 0, event.action, 0);
+    }
+}
+
+bool DumpFrame(const FrameBenchOptions& options, int width, int height)
+{
+    if (options.dumpPath.empty())
+        return true;
+
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    bool ok = WritePng(options.dumpPath.c_str(), width, height, pixels.data(), true);
+    if (!ok)
+        std::fprintf(stderr, "Could not write %s\n", options.dumpPath.c_str());
+    return ok;
+}
+
+bool DumpFrame(const FrameBenchOptions& options, int width, int height, const unsigned char* pixels)
+{
+    if (options.dumpPath.empty())
+        return true;
+
+    bool ok = WritePng(options.dumpPath.c_str(), width, height, pixels, false);
+    if (!ok)
+        std::fprintf(stderr, "Could not write %s\n", options.dumpPath.c_str());
+    return ok;
+}
+
+void PrintFrameBenchReport(const FrameBenchOptions& options, double wallSeconds)
+{
+    const FrameStats& stats = GetFrameStats();
+    const std::vector<double>& frameTimes = stats.recorded(StatTimer::Frame);
+    size_t frames = frameTimes.size();
+
+    // Time spent inside GL calls on the CPU.
+    std::vector<double> driverTimes(frames);
+    for (size_t i = 0; i < frames; i++)
+        driverTimes[i] = stats.recorded(StatTimer::Uniforms)[i] + stats.recorded(StatTimer::Draw)[i] +
+                         stats.recorded(StatTimer::TextureUploads)[i];
+
+    std::printf("{\n");
+    if (options.software)
+        std::printf("  \"renderer\": \"software (%u threads)\",\n", options.threads);
+    else
+        std::printf("  \"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+    std::printf("  \"headless\": %s,\n", options.headless ? "true" : "false");
+    std::printf("  \"frames\": %zu,\n", frames);
+    std::printf("  \"time_step_ms\": %.4f,\n", options.timeStep * 1000.0);
+    std::printf("  \"instances\": %d,\n", options.instances);
+    std::printf("  \"draw_per_instance\": %s,\n", options.drawPerInstance ? "true" : "false");
+    std::printf("  \"direct_draws\": %s,\n", options.directDraws ? "true" : "false");
+    std::printf("  \"wall_seconds\": %.4f,\n", wallSeconds);
+    std::printf("  \"fps\": %.2f,\n", wallSeconds > 0.0 ? frames / wallSeconds : 0.0);
+    PrintSummary("cpu_frame_ms", Summarize(frameTimes));
+    PrintSummary("driver_ms", Summarize(driverTimes));
+    PrintSummary("culling_ms", Summarize(stats.recorded(StatTimer::Culling)));
+    std::printf("  \"counters_per_frame\": {");
+    for (int i = 0; i < (int)StatCounter::Count; i++) {
+        std::string key = StatName((StatCounter)i);
+        std::replace(key.begin(), key.end(), ' ', '_');
+        std::printf("%s \"%s\": %.2f", i ? "," : "", key.c_str(),
+                    frames ? (double)stats.recordedTotal((StatCounter)i) / frames : 0.0);
+    }
+    std::printf(" }\n}\n");
+}
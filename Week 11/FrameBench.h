@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// Options for running the render loop as a benchmark:
+//   --bench N       render N frames with a fixed time step and scripted
+//                   input, then print a JSON report and exit
+//   --headless      no visible window; asks GLFW for an OSMesa context so
+//                   the frames render on Mesa's software GL. Fails if GLFW
+//                   cannot make one (no OSMesa support or library). On
+//                   Linux this still needs a display server: GLFW 3.3's
+//                   glfwInit connects to X11 (or Wayland) before any
+//                   context is made, so on a machine without one, run
+//                   under Xvfb or use --software
+//   --dump out.png  save the last frame
+//   --instances N   draw N copies of the mesh (the first one is the one
+//                   the keys move)
+//   --draw-per-instance
+//                   draw every copy as its own object (its own draw
+//                   command) instead of as instances of one
+//   --direct-draws  one draw call per object instead of one
+//                   glMultiDrawElementsIndirect for all of them
+//   --software      draw with SoftwareRenderer instead of GL; no window
+//                   or context is created
+//   --threads N     software renderer worker threads (default: one per
+//                   core)
+struct FrameBenchOptions {
+    int frames = 0;
+    bool headless = false;
+    std::string dumpPath;
+    int instances = 1;
+    bool drawPerInstance = false;
+    bool directDraws = false;
+    bool software = false;
+    unsigned threads = 0;
+    double timeStep = 1.0 / 60.0;
+
+    bool enabled() const { return frames > 0; }
+};
+
+// Returns false (after printing why) on a malformed option. Unknown
+// arguments are left alone.
+bool ParseFrameBenchOptions(int argc, char** argv, FrameBenchOptions& options);
+
+// Window hints for the requested mode. Call before glfwCreateWindow.
+void ApplyFrameBenchWindowHints(const FrameBenchOptions& options);
+
+// Feeds the key callback the same key presses and releases on the same
+// frames every run, so the scene moves identically.
+void ApplyScriptedInput(GLFWwindow* window, int frame, GLFWkeyfun keyCallback);
+
+// Reads the back buffer and writes it to options.dumpPath.
+bool DumpFrame(const FrameBenchOptions& options, int width, int height);
+
+// Writes an RGBA8 frame, rows top to bottom, to options.dumpPath.
+bool DumpFrame(const FrameBenchOptions& options, int width, int height, const unsigned char* pixels);
+
+// Prints frame time percentiles, driver time, counters and frames per
+// second from the recorded FrameStats as JSON. The renderer is read from
+// the current GL context unless options.software is set.
+void PrintFrameBenchReport(const FrameBenchOptions& options, double wallSeconds);
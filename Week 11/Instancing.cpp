@@ -0,0 +1,56 @@
+#include "Instancing.h"
+
+#include <cmath>
+#include <cstddef>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "NormalMatrix.h"
+
+void BuildInstanceData(const glm::mat4* transforms, size_t count, InstanceData* out)
+{
+    const size_t BATCH = 256;
+    glm::mat3 normalMatrices[BATCH];
+    for (size_t begin = 0; begin < count; begin += BATCH) {
+        size_t n = count - begin < BATCH ? count - begin : BATCH;
+        NormalMatrices(transforms + begin, normalMatrices, n);
+        for (size_t i = 0; i < n; i++) {
+            InstanceData& instance = out[begin + i];
+            instance.transform = transforms[begin + i];
+            for (int c = 0; c < 3; c++)
+                instance.normalMatrix[c] = glm::vec4(normalMatrices[i][c], 0.f);
+        }
+    }
+}
+
+void BindInstanceLayout()
+{
+    for (GLuint c = 0; c < 4; c++) {
+        GLuint location = INSTANCE_TRANSFORM_LOCATION + c;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offsetof(InstanceData, transform) + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    for (GLuint c = 0; c < 3; c++) {
+        GLuint location = INSTANCE_NORMAL_MATRIX_LOCATION + c;
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offsetof(InstanceData, normalMatrix) + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+}
+
+std::vector<glm::mat4> InstanceGrid(size_t count, const glm::vec3& front, float spacing, float scale)
+{
+    std::vector<glm::mat4> transforms;
+    transforms.reserve(count);
+    size_t side = (size_t)std::ceil(std::sqrt((double)count));
+    for (size_t i = 0; i < count; i++) {
+        float x = ((float)(i % side) - (side - 1) * 0.5f) * spacing;
+        float z = -(float)(i / side) * spacing;
+        glm::mat4 transform = glm::translate(glm::mat4(1.f), front + glm::vec3(x, 0.f, z));
+        transforms.push_back(glm::scale(transform, glm::vec3(scale)));
+    }
+    return transforms;
+}
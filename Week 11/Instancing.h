@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per-instance vertex data read by sample.vert: the model matrix at
+// locations 4-7 and its normal matrix at 8-10, one column per location
+// (the mat3 columns are padded to vec4 so every column is 16-byte aligned).
+struct InstanceData {
+    glm::mat4 transform;
+    glm::vec4 normalMatrix[3];
+};
+static_assert(sizeof(InstanceData) == 112, "InstanceData must match the sample.vert instance attributes");
+
+const GLuint INSTANCE_TRANSFORM_LOCATION = 4;
+const GLuint INSTANCE_NORMAL_MATRIX_LOCATION = 8;
+
+// Fills out[i] from transforms[i], with the normal matrices computed in
+// batches by NormalMatrices.
+void BuildInstanceData(const glm::mat4* transforms, size_t count, InstanceData* out);
+
+// Points the per-instance attributes of the bound VAO at the buffer bound
+// to GL_ARRAY_BUFFER, with a divisor of 1.
+void BindInstanceLayout();
+
+// `count` copies on a square grid in the XZ plane, `spacing` apart. The
+// grid is centred on `front` in X and runs away from the camera (towards
+// -Z) from there. Every copy is scaled by `scale`.
+std::vector<glm::mat4> InstanceGrid(size_t count, const glm::vec3& front, float spacing, float scale);
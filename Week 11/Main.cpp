@@ -5,7 +5,6 @@
 #include <GLFW/glfw3.h>
 #include "cmath"
 
-#define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -13,6 +12,33 @@
 
 #include "string"
 #include "iostream"
+#include "chrono"
+
+#include "Bench.h"
+#include "Bvh.h"
+#include "Culling.h"
+#include "FrameBench.h"
+#include "Instancing.h"
+#include "MeshArena.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "Picking.h"
+#include "ProgramCache.h"
+#include "RenderState.h"
+#include "SampleQuery.h"
+#include "SceneTextures.h"
+#include "ShaderPermutations.h"
+#include "ShaderProgram.h"
+#include "ShaderReloader.h"
+#include "SoftwareRenderer.h"
+#include "SoftwareTexture.h"
+#include "Stats.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "UniformBlocks.h"
+#include "UniformRing.h"
+#include "VertexPacking.h"
 
 const float SCREEN_WIDTH = 600;
 const float SCREEN_HEIGHT = 600;
@@ -31,9 +57,29 @@ float ry_mod = 1;
 float theta_x_mod = 0;
 float theta_y_mod = 0;
 
+bool pickRequested = false;
+double pickX = 0;
+double pickY = 0;
+
 const float BASE_SPEED = 10.0f;
 const float ROTATE_SPEED = 100.0f;
 
+// Room for the largest level in flight (the skybox's six top faces) with
+// space to spare, and how much of it one frame may upload.
+const size_t TEXTURE_RING_SIZE = 8 * 1024 * 1024;
+const size_t TEXTURE_UPLOAD_BUDGET = 1024 * 1024;
+// Estimated GPU memory the scene's textures may use before the least
+// recently used ones are evicted or lose their top mips.
+const size_t TEXTURE_CACHE_BUDGET = 64 * 1024 * 1024;
+// Size of the shared vertex and index buffers meshes are packed into.
+const size_t MESH_VERTEX_PAGE_SIZE = 16 * 1024 * 1024;
+const size_t MESH_INDEX_PAGE_SIZE = 8 * 1024 * 1024;
+
+const std::string MESH_PATH = "3D/djSword.obj";
+// PackedSnorm16 spreads its precision evenly across the AABB; PackedHalf
+// is finer near the centre and coarser towards the edges.
+const VertexFormat MESH_FORMAT = VertexFormat::PackedSnorm16;
+
 void Key_Callback(
     GLFWwindow* window,
     int key,
@@ -125,16 +171,307 @@ void Key_Callback(
         }
 }
 
-int main(void)
+void MouseButton_Callback(
+    GLFWwindow* window,
+    int button,
+    int action,
+    int mod
+) {
+    // Picked in the render loop, where the camera matrices are.
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+    {
+        glfwGetCursorPos(window, &pickX, &pickY);
+        pickRequested = true;
+    }
+}
+
+// Loads the mesh from its cache, or builds, optimizes and packs it from the
+// OBJ and caches it for the next launch. The view points into meshCache or
+// meshData. Returns an empty view (no indices) if the OBJ could not be
+// loaded or has no triangles.
+MeshView LoadSceneMesh(const std::string& path, VertexFormat format, MeshCache& meshCache, MeshData& meshData)
+{
+    MeshView mesh;
+    std::chrono::steady_clock::time_point meshLoadStart = std::chrono::steady_clock::now();
+    if (meshCache.load(path, format)) {
+        mesh = meshCache.view();
+        std::cout << "Loaded " << path << " from " << MeshCache::PathFor(path);
+    }
+    else {
+        std::vector<tinyobj::shape_t> shape;
+        std::vector<tinyobj::material_t> material;
+        std::string warning, error;
+
+        tinyobj::attrib_t attributes;
+
+        bool success = LoadObjParallel(
+            &attributes,
+            &shape,
+            &material,
+            &warning,
+            &error,
+            path.c_str(),
+            "3D/"
+        );
+
+        if (!success || shape.empty()) {
+            std::cout << "Could not load " << path << ": " << error << std::endl;
+            return MeshView();
+        }
+        WeldStats weldStats = BuildMesh(attributes, shape[0], meshData);
+        if (weldStats.corners == 0) {
+            std::cout << "Could not load " << path << ": no faces in the first shape" << std::endl;
+            return MeshView();
+        }
+        VertexCacheStats cacheBefore, cacheAfter;
+        OptimizeMesh(meshData, &cacheBefore, &cacheAfter);
+        CompactIndices(meshData);
+        PackVertices(meshData, format);
+        mesh = ViewOf(meshData);
+        PrintWeldStats(path, weldStats, mesh);
+        PrintVertexCacheStats(path, cacheBefore, cacheAfter);
+        PrintQuantizationError(path, MeasureQuantizationError(meshData), mesh);
+
+        MeshCache::save(path, mesh);
+        std::cout << "Loaded " << path;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - meshLoadStart;
+    std::cout << " in " << elapsed.count() << " ms" << std::endl;
+    return mesh;
+}
+
+// The scene main and RunSoftwareFrames draw: instance 0 is the mesh the
+// keys move and any others (--instances) stand on a grid behind it, seen
+// from a fixed camera under one point light.
+struct Scene {
+    MeshView mesh;
+    uint32_t meshId = 0;
+    bool drawPerInstance = false;
+
+    // Instance 0's position, scale and rotation.
+    float fTX = 0.f, fTY = 0.f, fTZ = -10.f;
+    float fSX = 0.3f, fSY = 0.3f, fSZ = 0.3f;
+    float theta_x = 0.f, theta_y = 0.f;
+
+    std::vector<glm::mat4> instanceTransforms;
+    std::vector<InstanceData> instances;
+    CullBounds instanceBounds;
+
+    glm::mat4 projection;
+    glm::mat4 viewMatrix;
+    CameraBlock camera;
+    LightingBlock lighting;
+
+    // Filled by UpdateScene each frame.
+    std::vector<uint32_t> visibleInstances;
+    size_t visibleCount = 0;
+    std::vector<MeshDraw> opaqueDraws;
+};
+
+// Places the copies of mesh (drawn as meshId), the camera and the light.
+void SetUpScene(Scene& scene, const MeshView& mesh, uint32_t meshId, const FrameBenchOptions& bench)
+{
+    scene.mesh = mesh;
+    scene.meshId = meshId;
+    scene.drawPerInstance = bench.drawPerInstance;
+
+    float instanceSpacing = glm::length(mesh.aabbMax - mesh.aabbMin) * scene.fSX * 1.5f;
+    scene.instanceTransforms = InstanceGrid(bench.instances - 1,
+        glm::vec3(scene.fTX, scene.fTY, scene.fTZ - instanceSpacing), instanceSpacing, scene.fSX);
+    scene.instanceTransforms.insert(scene.instanceTransforms.begin(), glm::mat4(1.0f));
+    scene.instances.resize(scene.instanceTransforms.size());
+    BuildInstanceData(scene.instanceTransforms.data(), scene.instanceTransforms.size(), scene.instances.data());
+
+    // Every copy is culled on its own against its world bounds; only
+    // instance 0's move.
+    scene.instanceBounds.resize(scene.instanceTransforms.size());
+    for (size_t i = 0; i < scene.instanceTransforms.size(); i++)
+        scene.instanceBounds.set(i, scene.instanceTransforms[i], mesh);
+    scene.visibleInstances.resize(scene.instanceTransforms.size());
+
+    glm::vec3 cameraPos = glm::vec3(0.f, 0.f, 10.f);
+    scene.projection = glm::perspective(glm::radians(60.f), SCREEN_HEIGHT / SCREEN_WIDTH, 0.1f, 1000.0f);
+    scene.viewMatrix = glm::lookAt(cameraPos, glm::vec3(0.f, 3.0f, 0.f), glm::vec3(0.f, 1.0f, 0.f));
+    scene.camera = {};
+    scene.camera.view = scene.viewMatrix;
+    scene.camera.projection = scene.projection;
+    scene.camera.cameraPos = cameraPos;
+
+    scene.lighting = {};
+    scene.lighting.lightPos = glm::vec3(0, 0, 8);
+    scene.lighting.lightColor = glm::vec3(1, 1, 1);
+    scene.lighting.ambientStr = 0.1f;
+    scene.lighting.ambientColor = scene.lighting.lightColor;
+    scene.lighting.specStr = 0.5f;
+    scene.lighting.specPhong = 16;
+}
+
+// Moves instance 0 by the keys held over deltaTime, culls every copy and
+// turns the visible ones into draws. Runs of consecutive visible copies
+// become one instanced draw each, so nothing moves in the instance buffer;
+// only instances[0] changes. With --draw-per-instance every visible copy
+// is its own draw.
+void UpdateScene(Scene& scene, float deltaTime)
 {
+    scene.fTX += tx_mod * deltaTime;
+    scene.fTY += ty_mod * deltaTime;
+    scene.fTZ += tz_mod * deltaTime;
+    scene.theta_x += theta_x_mod * deltaTime;
+    scene.theta_y += theta_y_mod * deltaTime;
+    scene.fSX += sx_mod * deltaTime;
+    scene.fSY += sy_mod * deltaTime;
+    glm::mat4 transformation_matrix = glm::translate(glm::mat4(1.0f), glm::vec3(scene.fTX, scene.fTY, scene.fTZ));
+    transformation_matrix = glm::scale(transformation_matrix, glm::vec3(scene.fSX, scene.fSY, scene.fSZ));
+    transformation_matrix = glm::rotate(transformation_matrix, glm::radians(scene.theta_x), glm::vec3(1.f, 0, 0));
+    transformation_matrix = glm::rotate(transformation_matrix, glm::radians(scene.theta_y), glm::vec3(0, 1.f, 0));
+    scene.instanceTransforms[0] = transformation_matrix;
+    BuildInstanceData(&transformation_matrix, 1, &scene.instances[0]);
+
+    {
+        ScopedStatTimer cullTimer(StatTimer::Culling);
+        scene.instanceBounds.set(0, transformation_matrix, scene.mesh);
+        scene.visibleCount = CullObjects(ExtractFrustum(scene.projection * scene.viewMatrix),
+                                         scene.instanceBounds, scene.visibleInstances.data());
+    }
+    GetFrameStats().add(StatCounter::ObjectsCulled, scene.instances.size() - scene.visibleCount);
+
+    scene.opaqueDraws.clear();
+    for (size_t i = 0; i < scene.visibleCount; i++)
+    {
+        uint32_t instance = scene.visibleInstances[i];
+        std::vector<MeshDraw>& draws = scene.opaqueDraws;
+        if (!scene.drawPerInstance && !draws.empty() &&
+            draws.back().firstInstance + draws.back().instanceCount == instance)
+            draws.back().instanceCount++;
+        else
+            draws.push_back({ scene.meshId, instance, 1 });
+    }
+}
+
+// --bench with --software: the scene, scripted input and culling of the
+// loop in main, drawn by SoftwareRenderer without a window or GL context.
+// The draw timer holds the whole software frame.
+int RunSoftwareFrames(FrameBenchOptions bench)
+{
+    MeshCache meshCache;
+    MeshData meshData;
+    MeshView mesh = LoadSceneMesh(MESH_PATH, MESH_FORMAT, meshCache, meshData);
+    if (mesh.indexCount == 0)
+        return -1;
+
+    SoftwareRenderer renderer(bench.threads);
+    bench.threads = renderer.threads();
+    renderer.resize((int)SCREEN_WIDTH, (int)SCREEN_HEIGHT);
+    uint32_t meshId = renderer.add(mesh);
+
+    // Nothing to stream: every texture is decoded before the first frame.
+    SoftwareTexture textures[std::size(SCENE_TEXTURES)];
+    for (size_t i = 0; i < std::size(SCENE_TEXTURES); i++)
+    {
+        const SceneTexture& sceneTexture = SCENE_TEXTURES[i];
+        CompressedTexture cooked;
+        if (!LoadOrCookTexture(sceneTexture.sources, sceneTexture.cookedPath, sceneTexture.settings, cooked) ||
+            !textures[i].decode(cooked))
+            std::cout << "Could not load " << sceneTexture.cookedPath << std::endl;
+        textures[i].setWrap(sceneTexture.settings.mips.wrapS, sceneTexture.settings.mips.wrapT);
+    }
+    // Every mesh is drawn with the first material, as in main.
+    const SceneMaterial& material = SCENE_MATERIALS[0];
+    renderer.setTextures(material.albedo >= 0 ? &textures[material.albedo] : nullptr,
+                         material.normalMap >= 0 ? &textures[material.normalMap] : nullptr, &textures[2]);
+    renderer.setFeatures(ShaderFeaturesFor(material));
+
+    Scene scene;
+    SetUpScene(scene, mesh, meshId, bench);
+    renderer.setInstances(scene.instances.data(), scene.instances.size());
+    renderer.setCamera(scene.camera);
+    renderer.setLighting(scene.lighting);
+
+    std::chrono::steady_clock::time_point benchStart = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < bench.frames; frame++)
+    {
+        GetFrameStats().beginFrame();
+        ApplyScriptedInput(nullptr, frame, Key_Callback);
+
+        UpdateScene(scene, (float)bench.timeStep);
+
+        {
+            ScopedStatTimer drawTimer(StatTimer::Draw);
+            renderer.draw(scene.opaqueDraws);
+        }
+        const SoftwareFrameStats& frameStats = renderer.stats();
+        GetFrameStats().add(StatCounter::RasterTriangles, frameStats.trianglesBinned);
+        GetFrameStats().add(StatCounter::RasterBlockSkips, frameStats.blocksSkipped);
+        GetFrameStats().add(StatCounter::RasterPixelsShaded, frameStats.pixelsShaded);
+        GetFrameStats().endFrame();
+    }
+    std::chrono::duration<double> wallSeconds = std::chrono::steady_clock::now() - benchStart;
+
+    DumpFrame(bench, renderer.width(), renderer.height(), renderer.pixels());
+    PrintFrameBenchReport(bench, wallSeconds.count());
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "--bench-obj")
+        return RunObjLoadBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-meshopt")
+        return RunMeshOptBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-quant")
+        return RunQuantizationBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-normals")
+        return RunNormalMatrixBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-textures")
+        return RunTextureLoadBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--cook-textures")
+        return RunTextureCookBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-mips")
+        return RunMipBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-cull")
+        return RunCullBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-bvh")
+        return RunBvhBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-raster")
+        return RunRasterBench(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "--bench-permutations")
+        return RunPermutationBench(argc - 2, argv + 2);
+
+    FrameBenchOptions bench;
+    if (!ParseFrameBenchOptions(argc, argv, bench))
+        return -1;
+    if (bench.enabled())
+    {
+        GetFrameStats().setReportInterval(0);
+        GetFrameStats().setRecording(true);
+    }
+    if (bench.software)
+        return RunSoftwareFrames(bench);
+
     GLFWwindow* window;
     
     /* Initialize the library */
     if (!glfwInit())
+    {
+        if (bench.headless)
+            std::cout << "--headless could not initialize GLFW; on Linux it needs a display server "
+                         "(e.g. Xvfb), or use --software" << std::endl;
         return -1;
+    }
 
     /* Create a windowed mode window and its OpenGL context */
+    ApplyFrameBenchWindowHints(bench);
     window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Shane Cab", NULL, NULL);
+    if (!window && bench.headless)
+    {
+        // Not falling back to a hidden native window: that would draw with
+        // whatever GL the display has, not the Mesa one --headless asks for.
+        std::cout << "--headless needs an OSMesa context (GLFW built with OSMesa support and the OSMesa "
+                     "library installed) and could not create one; run without it on a display, or "
+                     "use --software" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
     if (!window)
     {
         glfwTerminate();
@@ -144,37 +481,27 @@ int main(void)
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
     gladLoadGL();
+    if (bench.enabled())
+        glfwSwapInterval(0);
 
-    int img_width, img_height, colorChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* tex_bytes = stbi_load("3D/brickwall.jpg", &img_width, &img_height, &colorChannels, 0);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // Textures stream in while the first frames render: workers load the
+    // cooked .dds files (block compressed, mips included; cooked from the
+    // source images on the first run) into a mapped upload ring, and each
+    // frame uploads at most TEXTURE_UPLOAD_BUDGET bytes of it. The cache
+    // owns the textures and keeps them within TEXTURE_CACHE_BUDGET.
+    double textureLoadStart = glfwGetTime();
+    TextureStreamer textureStreamer;
+    textureStreamer.create(TEXTURE_RING_SIZE);
+    TextureCache textureCache(textureStreamer, TEXTURE_CACHE_BUDGET);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img_width, img_height, 0, GL_RGB, GL_UNSIGNED_BYTE, tex_bytes);
+    TextureHandle texture = textureCache.acquire(SCENE_TEXTURES[0]);
+    GetRenderState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, textureCache.get(texture));
 
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(tex_bytes);
+    TextureHandle norm_tex = textureCache.acquire(SCENE_TEXTURES[1]);
+    GetRenderState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, textureCache.get(norm_tex));
 
-    int img_width2, img_height2, colorChannels2;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* tex_bytes2 = stbi_load("3D/brickwall_normal.jpg", &img_width2, &img_height2, &colorChannels2, 0);
-
-    GLuint norm_tex;
-    glGenTextures(1, &norm_tex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, norm_tex);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img_width2, img_height2, 0, GL_RGB, GL_UNSIGNED_BYTE, tex_bytes2);
-
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(tex_bytes2);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GlWrap(SCENE_TEXTURES[1].settings.mips.wrapS));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GlWrap(SCENE_TEXTURES[1].settings.mips.wrapT));
 
     glEnable(GL_DEPTH_TEST);
 
@@ -184,58 +511,58 @@ int main(void)
                SCREEN_HEIGHT); // Height
 
     glfwSetKeyCallback(window, Key_Callback);
-
-    std::fstream vertSrc("Shaders/sample.vert");
-    std::stringstream vertBuff;
-    vertBuff << vertSrc.rdbuf();
-    std::string vertS = vertBuff.str();
-    const char* v = vertS.c_str();
-
-    std::fstream fragSrc("Shaders/sample.frag");
-    std::stringstream fragBuff;
-    fragBuff << fragSrc.rdbuf();
-    std::string fragS = fragBuff.str();
-    const char* f = fragS.c_str();
-
-    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertShader, 1, &v, NULL);
-    glCompileShader(vertShader);
-
-    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragShader, 1, &f, NULL);
-    glCompileShader(fragShader);
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertShader);
-    glAttachShader(shaderProgram, fragShader);
-
-    glLinkProgram(shaderProgram);
-
-    std::fstream sky_vertSrc("Shaders/skybox.vert");
-    std::stringstream sky_vertBuff;
-    sky_vertBuff << sky_vertSrc.rdbuf();
-    std::string sky_vertS = sky_vertBuff.str();
-    const char* sky_v = sky_vertS.c_str();
-
-    std::fstream sky_fragSrc("Shaders/skybox.frag");
-    std::stringstream sky_fragBuff;
-    sky_fragBuff << sky_fragSrc.rdbuf();
-    std::string sky_fragS = sky_fragBuff.str();
-    const char* sky_f = sky_fragS.c_str();
-
-    GLuint sky_vertShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(sky_vertShader, 1, &sky_v, NULL);
-    glCompileShader(sky_vertShader);
-
-    GLuint sky_fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(sky_fragShader, 1, &sky_f, NULL);
-    glCompileShader(sky_fragShader);
-
-    GLuint skyboxProgram = glCreateProgram();
-    glAttachShader(skyboxProgram, sky_vertShader);
-    glAttachShader(skyboxProgram, sky_fragShader);
-
-    glLinkProgram(skyboxProgram);
+    glfwSetMouseButtonCallback(window, MouseButton_Callback);
+
+    // Every program compiles at once, or loads from binaries a previous run
+    // saved in ShaderCache/. Of sample.frag, only the permutations the
+    // scene's materials use are built.
+    std::chrono::steady_clock::time_point programStart = std::chrono::steady_clock::now();
+    ProgramCache programCache;
+    ShaderPermutations samplePermutations("Shaders/sample.vert", "Shaders/sample.frag", &programCache);
+    std::vector<uint32_t> sceneFeatures;
+    for (const SceneMaterial& material : SCENE_MATERIALS)
+        sceneFeatures.push_back(ShaderFeaturesFor(material));
+    ShaderProgram skyboxProgram;
+    std::vector<ProgramBuild> programBuilds = {
+        { &skyboxProgram, ShaderSource::FromFiles("Shaders/skybox.vert", "Shaders/skybox.frag") },
+    };
+    samplePermutations.addBuilds(sceneFeatures, programBuilds);
+    if (!BuildPrograms(programBuilds, &programCache)) {
+        glfwTerminate();
+        return -1;
+    }
+    std::chrono::duration<double, std::milli> programElapsed = std::chrono::steady_clock::now() - programStart;
+    std::cout << "Built " << programBuilds.size() << " programs in " << programElapsed.count() << " ms ("
+              << programCache.hits() << " from the program cache)" << std::endl;
+    for (const ShaderPermutations::Permutation& permutation : samplePermutations.permutations())
+        std::cout << "  sample.frag: " << ShaderFeatureNames(permutation.features) << std::endl;
+
+    // Every mesh is drawn with the first material.
+    ShaderProgram& shaderProgram = *samplePermutations.get(sceneFeatures[0]);
+
+    // Camera and lighting live in uniform buffers shared by all programs.
+    auto bindUniformBlocks = [&]() {
+        std::vector<ShaderProgram*> programs = { &skyboxProgram };
+        for (const ShaderPermutations::Permutation& permutation : samplePermutations.permutations())
+            programs.push_back(permutation.program.get());
+        for (ShaderProgram* program : programs) {
+            program->bindUniformBlock("Camera", CAMERA_BINDING);
+            program->bindUniformBlock("Lighting", LIGHTING_BINDING);
+        }
+    };
+    bindUniformBlocks();
+
+    // Saving a shader rebuilds its programs while the scene keeps running.
+    // Not while benchmarking, where frames have to be reproducible.
+    ShaderReloader shaderReloader(&programCache);
+    if (!bench.enabled() && shaderReloader.open("Shaders")) {
+        for (const ShaderPermutations::Permutation& permutation : samplePermutations.permutations())
+            shaderReloader.watch(permutation.program.get(), samplePermutations.vertPath(),
+                                 samplePermutations.fragPath(), ShaderDefines(permutation.features));
+        shaderReloader.watch(&skyboxProgram, "Shaders/skybox.vert", "Shaders/skybox.frag");
+    }
+    UniformRing uniformRing;
+    uniformRing.create(4096);
 
     GLfloat UV[]{
         0.f, 1.f,
@@ -248,91 +575,15 @@ int main(void)
         0.f, 0.f
     };
 
-    std::string path = "3D/djSword.obj";
-    std::vector<tinyobj::shape_t> shape;
-    std::vector<tinyobj::material_t> material;
-    std::string warning, error;
-    
-    tinyobj::attrib_t attributes;
-
-    bool success = tinyobj::LoadObj(
-        &attributes,
-        &shape,
-        &material,
-        &warning,
-        &error,
-        path.c_str()
-    );
-
-    /*
-  7--------6
- /|       /|
-4--------5 |
-| |      | |
-| 3------|-2
-|/       |/
-0--------1
-*/
-//Vertices for the cube
-    float skyboxVertices[]{
-        -1.f, -1.f, 1.f, //0
-        1.f, -1.f, 1.f,  //1
-        1.f, -1.f, -1.f, //2
-        -1.f, -1.f, -1.f,//3
-        -1.f, 1.f, 1.f,  //4
-        1.f, 1.f, 1.f,   //5
-        1.f, 1.f, -1.f,  //6
-        -1.f, 1.f, -1.f  //7
-    };
-
-    //Skybox Indices
-    unsigned int skyboxIndices[]{
-        1,2,6,
-        6,5,1,
-
-        0,4,7,
-        7,3,0,
-
-        4,5,6,
-        6,7,4,
-
-        0,3,2,
-        2,1,0,
-
-        0,1,5,
-        5,4,0,
-
-        3,7,6,
-        6,2,3
-    };
-
-    unsigned int skyboxVAO, skyboxVBO, skyboxEBO;
+    // The skybox is one fullscreen triangle generated from gl_VertexID, so
+    // its VAO has no buffers.
+    unsigned int skyboxVAO;
     glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glGenBuffers(1, &skyboxEBO);
-
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void*)0);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skyboxEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(skyboxIndices), &skyboxIndices, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-
-    std::string facesSkybox[]{
-        "Skybox/rainbow_rt.png",
-        "Skybox/rainbow_lf.png",
-        "Skybox/rainbow_up.png",
-        "Skybox/rainbow_dn.png",
-        "Skybox/rainbow_ft.png",
-        "Skybox/rainbow_bk.png"
-    };
+    SampleQuery skyboxSamples;
+    skyboxSamples.create(StatCounter::SkyboxSamples);
 
-    unsigned int skyboxTex;
-    glGenTextures(1, &skyboxTex);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTex);
+    TextureHandle skyboxTex = textureCache.acquire(SCENE_TEXTURES[2]);
+    GetRenderState().bindTexture(GL_TEXTURE_CUBE_MAP, textureCache.get(skyboxTex));
 
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -341,109 +592,14 @@ int main(void)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    for (unsigned int i = 0; i < 6; i++) {
-        int w, h, skyCChannel;
-        stbi_set_flip_vertically_on_load(false);
-
-        unsigned char* data = stbi_load(facesSkybox[i].c_str(), &w, &h, &skyCChannel, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        }
-        stbi_image_free(data);
-    }
-
-    std::vector<GLuint> mesh_indices;
-    for (int i = 0; i < shape[0].mesh.indices.size(); i++) {
-        mesh_indices.push_back(
-            shape[0].mesh.indices[i].vertex_index
-        );
-    }
-
-    std::vector<glm::vec3> tangents;
-    std::vector<glm::vec3> bitangents;
-
-    for (int i = 0; i < shape[0].mesh.indices.size(); i += 3) {
-        tinyobj::index_t vData1 = shape[0].mesh.indices[i];
-        tinyobj::index_t vData2 = shape[0].mesh.indices[i + 1];
-        tinyobj::index_t vData3 = shape[0].mesh.indices[i + 2];
-        
-        glm::vec3 v1 = glm::vec3(
-            attributes.vertices[vData1.vertex_index * 3],
-            attributes.vertices[(vData1.vertex_index * 3) + 1],
-            attributes.vertices[(vData1.vertex_index * 3) + 2]
-        );
+    bool texturesStreamed = false;
 
-        glm::vec3 v2 = glm::vec3(
-            attributes.vertices[vData2.vertex_index * 3],
-            attributes.vertices[(vData2.vertex_index * 3) + 1],
-            attributes.vertices[(vData2.vertex_index * 3) + 2]
-        );
-
-        glm::vec3 v3 = glm::vec3(
-            attributes.vertices[vData3.vertex_index * 3],
-            attributes.vertices[(vData3.vertex_index * 3) + 1],
-            attributes.vertices[(vData3.vertex_index * 3) + 2]
-        );
-
-        glm::vec2 uv1 = glm::vec2(
-            attributes.texcoords[(vData1.texcoord_index * 2)],
-            attributes.texcoords[(vData1.texcoord_index * 2) + 1]
-        );
-
-        glm::vec2 uv2 = glm::vec2(
-            attributes.texcoords[(vData2.texcoord_index * 2)],
-            attributes.texcoords[(vData2.texcoord_index * 2) + 1]
-        );
-        
-        glm::vec2 uv3 = glm::vec2(
-            attributes.texcoords[(vData3.texcoord_index * 2)],
-            attributes.texcoords[(vData3.texcoord_index * 2) + 1]
-        );
-
-        glm::vec3 deltaPos1 = v2 - v1;
-        glm::vec3 deltaPos2 = v3 - v1;
-
-        glm::vec2 deltaUV1 = uv2 - uv1;
-        glm::vec2 deltaUV2 = uv3 - uv1;
-
-        float r = 1.0f / ((deltaUV1.x * deltaUV2.y) - (deltaUV1.y * deltaUV2.x));
-
-        glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
-        glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
-
-        tangents.push_back(tangent);
-        tangents.push_back(tangent);
-        tangents.push_back(tangent);
-
-        bitangents.push_back(bitangent);
-        bitangents.push_back(bitangent);
-        bitangents.push_back(bitangent);
-    }
-
-    std::vector<GLfloat> fullVertexData;
-    for (int i = 0; i < shape[0].mesh.indices.size(); i++) {
-        tinyobj::index_t vData = shape[0].mesh.indices[i];
-        // X
-        fullVertexData.push_back(attributes.vertices[vData.vertex_index * 3]);
-        // Y
-        fullVertexData.push_back(attributes.vertices[vData.vertex_index * 3 + 1]);
-        // Z
-        fullVertexData.push_back(attributes.vertices[vData.vertex_index * 3 + 2]);
-        fullVertexData.push_back(attributes.normals[vData.normal_index * 3]);
-        fullVertexData.push_back(attributes.normals[vData.normal_index * 3 + 1]);
-        fullVertexData.push_back(attributes.normals[vData.normal_index * 3 + 2]);
-        // U
-        fullVertexData.push_back(attributes.texcoords[vData.texcoord_index * 2]);
-        // V
-        fullVertexData.push_back(attributes.texcoords[vData.texcoord_index * 2 + 1]);
-
-        fullVertexData.push_back(tangents[i].x);
-        fullVertexData.push_back(tangents[i].y);
-        fullVertexData.push_back(tangents[i].z);
-
-        fullVertexData.push_back(bitangents[i].x);
-        fullVertexData.push_back(bitangents[i].y);
-        fullVertexData.push_back(bitangents[i].z);
+    MeshCache meshCache;
+    MeshData meshData;
+    MeshView mesh = LoadSceneMesh(MESH_PATH, MESH_FORMAT, meshCache, meshData);
+    if (mesh.indexCount == 0) {
+        glfwTerminate();
+        return -1;
     }
 
     GLfloat vertices[]{
@@ -456,118 +612,36 @@ int main(void)
         0,1,2
     };
 
-    GLuint VAO, VBO, EBO, VBO_UV;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    //glGenBuffers(1, &VBO_UV);
-    //glGenBuffers(1, &EBO);
-
-    // working with this VAO
-    glBindVertexArray(VAO);
-    // working with this VBO
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        sizeof(GLfloat) * fullVertexData.size(),
-        fullVertexData.data(),
-        GL_STATIC_DRAW
-    );
-
-    glVertexAttribPointer(
-        0,
-        3, //XYZ
-        GL_FLOAT,
-        GL_FALSE,
-        14 * sizeof(GLfloat),
-        (void*)0
-    );
-    
-    GLintptr normPtr = 3 * sizeof(float);
-    glVertexAttribPointer(
-        1,
-        3, //UV
-        GL_FLOAT,
-        GL_FALSE,
-        14 * sizeof(float),
-        (void*)normPtr
-    );
-
-    GLintptr uvPtr = 6 * sizeof(float);
-    glVertexAttribPointer(
-        2,
-        2, //UV
-        GL_FLOAT,
-        GL_FALSE,
-        14 * sizeof(float),
-        (void*)uvPtr
-    );
-    
-    GLintptr tangentPtr = 8 * sizeof(float);
-    glVertexAttribPointer(
-        3,
-        3, 
-        GL_FLOAT,
-        GL_FALSE,
-        14 * sizeof(float),
-        (void*)tangentPtr
-    );
-
-    GLintptr bitangentPtr = 11 * sizeof(float);
-    glVertexAttribPointer(
-        4,
-        3, 
-        GL_FLOAT,
-        GL_FALSE,
-        14 * sizeof(float),
-        (void*)bitangentPtr
-    );
-    glEnableVertexAttribArray(0);
-
-    /*glBindBuffer(GL_ARRAY_BUFFER, VBO_UV);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * (sizeof(UV) / sizeof(UV[0])), &UV[0], GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(
-        2,
-        2, //UV
-        GL_FLOAT,
-        GL_FALSE,
-        2 * sizeof(float),
-        (void*)0
-    );*/
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    glEnableVertexAttribArray(3);
-    glEnableVertexAttribArray(4);
-
-
-    /*glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(
-        GL_ELEMENT_ARRAY_BUFFER,
-        sizeof(GLuint) * mesh_indices.size(),
-        mesh_indices.data(),
-        GL_STATIC_DRAW
-    );*/
-
+    // Meshes live in the arena's shared buffers, and the opaque pass is one
+    // multi-draw per buffer page.
+    MeshArena meshArena;
+    meshArena.create(MESH_VERTEX_PAGE_SIZE, MESH_INDEX_PAGE_SIZE);
+    uint32_t meshId = meshArena.add(mesh);
+    if (bench.directDraws)
+        meshArena.setIndirect(false);
+    else if (!meshArena.indirect())
+        std::cout << "No multi-draw indirect or shader draw parameters; drawing objects one by one" << std::endl;
+
+    Scene scene;
+    SetUpScene(scene, mesh, meshId, bench);
+    GLsizei instanceCount = (GLsizei)scene.instances.size();
+
+    GLuint instanceVBO;
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(InstanceData), scene.instances.data(), GL_DYNAMIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    glm::mat4 identity_matrix = glm::mat4(1.0f);
-    glm::mat4 translation = glm::translate(identity_matrix, glm::vec3(0, 0, 0));
-    glm::mat4 scale = glm::scale(identity_matrix, glm::vec3(0, 0, 0));
-
-    float fTX, fTY, fTZ;
-    fTX = fTY = fTZ = 0.f;
-    fTY = 0.f;
-    fTZ = -10.f;
-
-    float fSX, fSY, fSZ;
-    fSX = fSY = fSZ = 0.3f;
-
-    float fRX = 1.f;
-    float fRY = 1.f;
-    float fRZ = 0.f;
-    float theta_x = 0.f;
-    float theta_y = 0.f;
+    meshArena.setInstanceBuffer(instanceVBO);
+
+    // Clicks are picked against the mesh triangles of the copies whose
+    // boxes the ray enters, found through a BVH over the copies.
+    std::vector<Aabb> instanceBoxes(instanceCount);
+    for (GLsizei i = 0; i < instanceCount; i++)
+        instanceBoxes[i] = BoxOf(scene.instanceBounds, i);
+    Bvh instanceBvh;
+    instanceBvh.build(instanceBoxes);
+    MeshPicker meshPicker;
+    meshPicker.build(mesh);
 
     /*glm::mat4 projection = glm::ortho(-2.0f,    // Left Most Point
                                        2.0f,    // Right Most Point
@@ -576,85 +650,50 @@ int main(void)
                                       -1.0f,    // Z Near
                                        1.0f);   // Z Far*/
 
-    glm::mat4 projection = glm::perspective(glm::radians(60.f), SCREEN_HEIGHT / SCREEN_WIDTH, 0.1f, 1000.0f);
-    glm::vec3 lightPos = glm::vec3(0, 0, 8);
-    glm::vec3 lightColor = glm::vec3(1, 1, 1);
-
-    float ambientStr = 0.1f;
-    glm::vec3 ambientColor = lightColor;
-
-    float specStr = 0.5f;
-    float specPhong = 16;
-
     // Enable Blending
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA,                // Source Factor      - Foreground Layer
                 GL_ONE_MINUS_SRC_ALPHA);     // Destination Factor - Background Layer
 
+    int frame = 0;
+    double benchStart = glfwGetTime();
+
     /* Loop until the user closes the window */
-    while (!glfwWindowShouldClose(window))
+    while (bench.enabled() ? frame < bench.frames : !glfwWindowShouldClose(window))
     {
         //glfwSetKeyCallback(window, Key_Callback);
+        GetFrameStats().beginFrame();
+
+        textureStreamer.update(TEXTURE_UPLOAD_BUDGET);
+        if (shaderReloader.update())
+            bindUniformBlocks();
+        if (!texturesStreamed && textureStreamer.idle())
+        {
+            texturesStreamed = true;
+            std::cout << "Streamed " << std::size(SCENE_TEXTURES) << " textures in "
+                      << (glfwGetTime() - textureLoadStart) * 1000.0 << " ms" << std::endl;
+        }
+
         /* Render here */
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
         currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        if (bench.enabled())
+        {
+            deltaTime = bench.timeStep;
+            ApplyScriptedInput(window, frame, Key_Callback);
+        }
 
-        glm::vec3 cameraPos = glm::vec3(0.f, 0.f, 10.f);
-        glm::mat4 cameraPosMatrix = glm::translate(glm::mat4(1.0f), cameraPos * -1.0f);
-
-        glm::vec3 worldUp = glm::normalize(glm::vec3(0.f, 1.0f, 0.f));
-        glm::vec3 cameraCenter = glm::vec3(0.f, 3.0f, 0.f);
-
-        glm::vec3 F = (cameraCenter - cameraPos);
-        F = glm::normalize(F);
-
-        glm::vec3 R = glm::normalize(glm::cross(F, worldUp));
-        glm::vec3 U = glm::cross(R, F);
-
-        glm::mat4 cameraOrientation = glm::mat4(1.0f);
-
-        cameraOrientation[0][0] = R.x;
-        cameraOrientation[1][0] = R.y;
-        cameraOrientation[2][0] = R.z;
-
-        cameraOrientation[0][1] = U.x;
-        cameraOrientation[1][1] = U.y;
-        cameraOrientation[2][1] = U.z;  
-
-        cameraOrientation[0][2] = -F.x;
-        cameraOrientation[1][2] = -F.y;
-        cameraOrientation[2][2] = -F.z;
-
-        //glm::mat4 viewMatrix = cameraOrientation * cameraPosMatrix;
-        glm::mat4 viewMatrix = glm::lookAt(cameraPos, cameraCenter, worldUp);
-
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
-
-        glUseProgram(skyboxProgram);
-
-        glm::mat4 skyView = glm::mat4(1.f);
-        skyView = glm::mat4(glm::mat3(viewMatrix));
-
-        unsigned int sky_ProjectionLoc = glGetUniformLocation(skyboxProgram, "projection");
-        glUniformMatrix4fv(sky_ProjectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-        
-        unsigned int sky_ViewLoc = glGetUniformLocation(skyboxProgram, "view");
-        glUniformMatrix4fv(sky_ViewLoc, 1, GL_FALSE, glm::value_ptr(skyView));
-
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTex);
-
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
+        uniformRing.beginFrame();
+        {
+            ScopedStatTimer uniformTimer(StatTimer::Uniforms);
+            uniformRing.bind(CAMERA_BINDING, scene.camera);
+            uniformRing.bind(LIGHTING_BINDING, scene.lighting);
+        }
 
-        glUseProgram(shaderProgram);
+        shaderProgram.use();
         //x_mod += 0.001f;
 
         //unsigned int xLoc = glGetUniformLocation(shaderProgram, "x");
@@ -662,83 +701,78 @@ int main(void)
         //unsigned int yLoc = glGetUniformLocation(shaderProgram, "y");
         //glUniform1f(yLoc, y_mod);
         //theta += 0.5f;
-        fTX += tx_mod * deltaTime;
-        fTY += ty_mod * deltaTime;
-        fTZ += tz_mod * deltaTime;
-        fRX = rx_mod;
-        fRY = ry_mod;
-        theta_x += theta_x_mod * deltaTime;
-        theta_y += theta_y_mod * deltaTime;
-        fSX += sx_mod * deltaTime;
-        fSY += sy_mod * deltaTime;
-        glm::mat4 transformation_matrix = glm::translate(identity_matrix, glm::vec3(fTX, fTY, fTZ));
-        transformation_matrix = glm::scale(transformation_matrix, glm::vec3(fSX, fSY, fSZ));
-        transformation_matrix = glm::rotate(transformation_matrix, glm::radians(theta_x), glm::vec3(1.f, 0, 0));
-        transformation_matrix = glm::rotate(transformation_matrix, glm::radians(theta_y), glm::vec3(0, 1.f, 0));
-
-
-        unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-        glUniformMatrix4fv(viewLoc,
-                           1,
-                           GL_FALSE,
-                           glm::value_ptr(viewMatrix)
-                           );
-
-        unsigned int projLoc = glGetUniformLocation(shaderProgram, "projection");
-        glUniformMatrix4fv(projLoc,
-                           1,
-                           GL_FALSE,
-                           glm::value_ptr(projection)
-                           );
-
-        unsigned int transformLoc = glGetUniformLocation(shaderProgram, "transform");
-        glUniformMatrix4fv(transformLoc,
-                           1,
-                           GL_FALSE,
-                           glm::value_ptr(transformation_matrix)
-                           );
-        
-        glActiveTexture(GL_TEXTURE0);
-        GLuint tex0Address = glGetUniformLocation(shaderProgram, "tex0");
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glUniform1i(tex0Address, 0);
-        
-        glActiveTexture(GL_TEXTURE1);
-        GLuint norm_texAddress = glGetUniformLocation(shaderProgram, "norm_tex");
-        glBindTexture(GL_TEXTURE_2D, norm_tex);
-        glUniform1i(norm_texAddress, 0);
+        UpdateScene(scene, (float)deltaTime);
+        {
+            ScopedStatTimer cullTimer(StatTimer::Culling);
+            instanceBoxes[0] = BoxOf(scene.instanceBounds, 0);
+            instanceBvh.refit(instanceBoxes, 0);
+        }
+
+        if (pickRequested)
+        {
+            pickRequested = false;
+            Ray ray = ScreenRay(pickX, pickY, SCREEN_WIDTH, SCREEN_HEIGHT, scene.projection * scene.viewMatrix);
+            uint32_t picked;
+            float distance;
+            if (PickObject(instanceBvh, scene.instanceTransforms, meshPicker, ray, picked, distance))
+                std::cout << "Picked instance " << picked << " at distance "
+                          << distance * glm::length(ray.direction) << std::endl;
+            else
+                std::cout << "Picked nothing" << std::endl;
+        }
 
-        GLuint lightAddress = glGetUniformLocation(shaderProgram, "lightPos");
-        glUniform3fv(lightAddress, 1, glm::value_ptr(lightPos));
+        // Through RenderState, like every bind below: whatever is already
+        // set from the last frame is not sent to the driver again.
+        GetRenderState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, textureCache.get(texture));
+        GetRenderState().bindTexture(GL_TEXTURE1, GL_TEXTURE_2D, textureCache.get(norm_tex));
 
-        GLuint lightColorAddress = glGetUniformLocation(shaderProgram, "lightColor");
-        glUniform3fv(lightColorAddress, 1, glm::value_ptr(lightColor));
+        {
+            ScopedStatTimer uniformTimer(StatTimer::Uniforms);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceData), &scene.instances[0]);
 
-        GLuint ambientStrAddress = glGetUniformLocation(shaderProgram, "ambientStr");
-        glUniform1f(ambientStrAddress, ambientStr);
+            shaderProgram.set("tex0", 0);
+            shaderProgram.set("norm_tex", 1);
+        }
 
-        GLuint ambientColorAddress = glGetUniformLocation(shaderProgram, "ambientColor");
-        glUniform3fv(ambientColorAddress, 1, glm::value_ptr(ambientColor));
+        {
+            ScopedStatTimer drawTimer(StatTimer::Draw);
+            meshArena.draw(scene.opaqueDraws);
+        }
 
-        GLuint cameraPosAddress = glGetUniformLocation(shaderProgram, "cameraPos");
-        glUniform3fv(cameraPosAddress, 1, glm::value_ptr(cameraPos));
+        // Sky last: the triangle sits at the far plane, so with GL_LEQUAL
+        // only pixels nothing else covered (depth still 1.0) are shaded.
+        GetRenderState().depthMask(GL_FALSE);
+        GetRenderState().depthFunc(GL_LEQUAL);
 
-        GLuint specStrAddress = glGetUniformLocation(shaderProgram, "specStr");
-        glUniform1f(specStrAddress, specStr);
+        skyboxProgram.use();
+        {
+            ScopedStatTimer uniformTimer(StatTimer::Uniforms);
+            glm::mat4 skyViewProjection = scene.projection * glm::mat4(glm::mat3(scene.viewMatrix));
+            skyboxProgram.set("inverseViewProjection", glm::inverse(skyViewProjection));
+        }
 
-        GLuint specPhongAddress = glGetUniformLocation(shaderProgram, "specPhong");
-        glUniform1f(specPhongAddress, specPhong);
+        GetRenderState().bindVertexArray(skyboxVAO);
+        GetRenderState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, textureCache.get(skyboxTex));
+
+        skyboxSamples.begin();
+        {
+            ScopedStatTimer drawTimer(StatTimer::Draw);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            GetFrameStats().add(StatCounter::DrawCalls);
+        }
+        skyboxSamples.end();
 
-        glBindVertexArray(VAO);
+        // glClear only clears depth with the mask on.
+        GetRenderState().depthMask(GL_TRUE);
+        GetRenderState().depthFunc(GL_LESS);
 
+        textureCache.update();
+        uniformRing.endFrame();
+        GetFrameStats().endFrame();
 
-        glDrawArrays(GL_TRIANGLES, 0, fullVertexData.size() / 14);
-        //glDrawElements(
-        //    GL_TRIANGLES,
-        //    mesh_indices.size(),
-        //    GL_UNSIGNED_INT,
-        //    0
-        //);
+        if (bench.enabled() && ++frame == bench.frames)
+            DumpFrame(bench, SCREEN_WIDTH, SCREEN_HEIGHT);
 
         /* Swap front and back buffers */
         glfwSwapBuffers(window);
@@ -747,9 +781,19 @@ int main(void)
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    if (bench.enabled())
+        PrintFrameBenchReport(bench, glfwGetTime() - benchStart);
+
+    meshArena.release();
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteVertexArrays(1, &skyboxVAO);
+    GetRenderState().deletedVertexArray(skyboxVAO);
+    skyboxSamples.release();
+    samplePermutations.release();
+    skyboxProgram.release();
+    uniformRing.release();
+    textureCache.clear();
+    textureStreamer.release();
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,206 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+#include "Tangents.h"
+
+namespace {
+
+struct CornerKey {
+    int vertex;
+    int normal;
+    int texcoord;
+
+    bool operator==(const CornerKey& other) const
+    {
+        return vertex == other.vertex && normal == other.normal && texcoord == other.texcoord;
+    }
+};
+
+struct CornerKeyHash {
+    size_t operator()(const CornerKey& key) const
+    {
+        uint64_t h = (uint64_t)(uint32_t)key.vertex * 0x9E3779B97F4A7C15ull;
+        h ^= (uint64_t)(uint32_t)key.normal * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= (uint64_t)(uint32_t)key.texcoord * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return (size_t)h;
+    }
+};
+
+glm::vec3 Fetch3(const std::vector<tinyobj::real_t>& data, int index)
+{
+    if (index < 0)
+        return glm::vec3(0.f);
+    return glm::vec3(data[index * 3], data[index * 3 + 1], data[index * 3 + 2]);
+}
+
+glm::vec2 Fetch2(const std::vector<tinyobj::real_t>& data, int index)
+{
+    if (index < 0)
+        return glm::vec2(0.f);
+    return glm::vec2(data[index * 2], data[index * 2 + 1]);
+}
+
+void Store3(GLfloat* dst, const glm::vec3& v)
+{
+    dst[0] = v.x;
+    dst[1] = v.y;
+    dst[2] = v.z;
+}
+
+} // namespace
+
+WeldStats BuildMesh(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape, MeshData& mesh)
+{
+    const std::vector<tinyobj::index_t>& corners = shape.mesh.indices;
+
+    mesh.vertices.clear();
+    mesh.packedVertices.clear();
+    mesh.packedFormat = VertexFormat::Float32;
+    mesh.indices.clear();
+    mesh.shortIndices.clear();
+    mesh.indices.reserve(corners.size());
+
+    std::unordered_map<CornerKey, GLuint, CornerKeyHash> unique;
+    unique.reserve(corners.size());
+
+    for (const tinyobj::index_t& corner : corners) {
+        CornerKey key = { corner.vertex_index, corner.normal_index, corner.texcoord_index };
+        auto inserted = unique.emplace(key, (GLuint)unique.size());
+        if (inserted.second) {
+            size_t base = mesh.vertices.size();
+            mesh.vertices.resize(base + FLOATS_PER_VERTEX, 0.f);
+            GLfloat* v = &mesh.vertices[base];
+            Store3(v + POSITION_OFFSET, Fetch3(attrib.vertices, corner.vertex_index));
+            Store3(v + NORMAL_OFFSET, Fetch3(attrib.normals, corner.normal_index));
+            glm::vec2 uv = Fetch2(attrib.texcoords, corner.texcoord_index);
+            v[UV_OFFSET] = uv.x;
+            v[UV_OFFSET + 1] = uv.y;
+        }
+        mesh.indices.push_back(inserted.first->second);
+    }
+
+    GenerateTangents(mesh);
+    ComputeBounds(mesh);
+
+    WeldStats stats;
+    stats.corners = corners.size();
+    stats.uniqueVertices = unique.size();
+    stats.vertexShaderRuns = CountCacheMisses(mesh.indices.data(), mesh.indices.size());
+    return stats;
+}
+
+void PrintWeldStats(const std::string& name, const WeldStats& stats, const MeshView& mesh)
+{
+    size_t deindexedBytes = stats.corners * mesh.vertexStride;
+    size_t indexedBytes = mesh.vertexBytes() + mesh.indexBytes();
+    std::cout << name << ": " << stats.corners << " -> " << stats.uniqueVertices << " vertices, "
+              << deindexedBytes / 1024 << " KB -> " << indexedBytes / 1024 << " KB ("
+              << (mesh.indexType == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices), "
+              << "vertex shader runs " << stats.corners << " -> " << stats.vertexShaderRuns
+              << " (FIFO " << VERTEX_CACHE_SIZE << ")" << std::endl;
+}
+
+void CompactIndices(MeshData& mesh)
+{
+    if (mesh.vertices.size() / FLOATS_PER_VERTEX > 0xFFFF)
+        return;
+    mesh.shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+    mesh.indices.clear();
+    mesh.indices.shrink_to_fit();
+}
+
+void ComputeBounds(MeshData& mesh)
+{
+    if (mesh.vertices.empty()) {
+        mesh.aabbMin = mesh.aabbMax = glm::vec3(0.f);
+        mesh.boundingRadius = 0.f;
+        return;
+    }
+
+    glm::vec3 lo(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+    glm::vec3 hi = lo;
+    for (size_t i = 0; i < mesh.vertices.size(); i += FLOATS_PER_VERTEX) {
+        glm::vec3 p(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    mesh.aabbMin = lo;
+    mesh.aabbMax = hi;
+
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius2 = 0.f;
+    for (size_t i = 0; i < mesh.vertices.size(); i += FLOATS_PER_VERTEX) {
+        glm::vec3 d = glm::vec3(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]) - center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    mesh.boundingRadius = std::sqrt(radius2);
+}
+
+glm::vec3 MeshView::positionScale() const
+{
+    if (vertexFormat == VertexFormat::Float32)
+        return glm::vec3(1.f);
+    return (aabbMax - aabbMin) * 0.5f;
+}
+
+glm::vec3 MeshView::positionOffset() const
+{
+    if (vertexFormat == VertexFormat::Float32)
+        return glm::vec3(0.f);
+    return (aabbMin + aabbMax) * 0.5f;
+}
+
+MeshView ViewOf(const MeshData& mesh)
+{
+    MeshView view;
+    if (!mesh.packedVertices.empty()) {
+        view.vertices = mesh.packedVertices.data();
+        view.vertexCount = mesh.packedVertices.size();
+        view.vertexStride = sizeof(PackedVertex);
+        view.vertexFormat = mesh.packedFormat;
+    }
+    else {
+        view.vertices = mesh.vertices.data();
+        view.vertexCount = mesh.vertices.size() / FLOATS_PER_VERTEX;
+        view.vertexStride = FLOATS_PER_VERTEX * sizeof(GLfloat);
+    }
+    if (!mesh.shortIndices.empty()) {
+        view.indices = mesh.shortIndices.data();
+        view.indexCount = mesh.shortIndices.size();
+        view.indexType = GL_UNSIGNED_SHORT;
+    }
+    else {
+        view.indices = mesh.indices.empty() ? nullptr : mesh.indices.data();
+        view.indexCount = mesh.indices.size();
+        view.indexType = GL_UNSIGNED_INT;
+    }
+    view.aabbMin = mesh.aabbMin;
+    view.aabbMax = mesh.aabbMax;
+    view.boundingRadius = mesh.boundingRadius;
+    return view;
+}
+
+size_t CountCacheMisses(const GLuint* indices, size_t indexCount, int cacheSize)
+{
+    // A vertex stays in a FIFO cache until cacheSize further misses have
+    // pushed it out, so remembering when it entered is enough.
+    GLuint maxIndex = 0;
+    for (size_t i = 0; i < indexCount; i++)
+        maxIndex = std::max(maxIndex, indices[i]);
+
+    const size_t NEVER = (size_t)-1;
+    std::vector<size_t> enteredAt(indexCount > 0 ? maxIndex + 1 : 0, NEVER);
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        size_t& entered = enteredAt[indices[i]];
+        if (entered != NEVER && misses - entered < (size_t)cacheSize)
+            continue;
+        entered = misses;
+        misses++;
+    }
+    return misses;
+}
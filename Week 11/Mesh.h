@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "tiny_obj_loader.h"
+
+// Bump whenever the vertex layout or index layout built by BuildMesh
+// changes. Cached meshes written with a different version are rebuilt.
+const uint32_t MESH_LAYOUT_VERSION = 5;
+
+const int FLOATS_PER_VERTEX = 12; // XYZ, normal, UV, tangent + handedness
+
+// Float offsets of each attribute inside a vertex.
+const int POSITION_OFFSET = 0;
+const int NORMAL_OFFSET = 3;
+const int UV_OFFSET = 6;
+const int TANGENT_OFFSET = 8;
+
+// How vertices are stored in the VBO. Float32 is the FLOATS_PER_VERTEX layout
+// BuildMesh produces and the optimizers work on; the packed formats are what
+// gets uploaded (see VertexPacking.h).
+enum class VertexFormat : uint32_t {
+    Float32 = 0,
+    PackedHalf = 1,    // positions as half floats
+    PackedSnorm16 = 2, // positions as normalized 16-bit ints
+};
+
+// 20-byte vertex. Positions are stored relative to the mesh AABB, mapped to
+// [-1, 1] on each axis, and position[3] holds the tangent handedness.
+// Normal and tangent are octahedral-encoded snorm16 pairs, UVs half floats.
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+
+// Size of the post-transform vertex cache assumed when estimating vertex
+// shader invocations.
+const int VERTEX_CACHE_SIZE = 32;
+
+// A mesh as built on the CPU, ready for glBufferData. Only one of indices
+// and shortIndices is filled; see CompactIndices. packedVertices is filled by
+// PackVertices and, when present, is what ViewOf hands out.
+struct MeshData {
+    std::vector<GLfloat> vertices; // FLOATS_PER_VERTEX floats per vertex
+    std::vector<PackedVertex> packedVertices;
+    VertexFormat packedFormat = VertexFormat::Float32;
+    std::vector<GLuint> indices;
+    std::vector<GLushort> shortIndices;
+    glm::vec3 aabbMin = glm::vec3(0.f);
+    glm::vec3 aabbMax = glm::vec3(0.f);
+    float boundingRadius = 0.f; // of the sphere centred on the AABB centre
+};
+
+struct WeldStats {
+    size_t corners = 0;          // vertices of the de-indexed mesh
+    size_t uniqueVertices = 0;
+    size_t vertexShaderRuns = 0; // estimated with a FIFO cache of VERTEX_CACHE_SIZE
+};
+
+// Non-owning view of mesh buffers, either from a MeshData or straight out of
+// a memory-mapped MeshCache.
+struct MeshView {
+    const void* vertices = nullptr;
+    size_t vertexCount = 0;
+    GLsizei vertexStride = 0;
+    VertexFormat vertexFormat = VertexFormat::Float32;
+    const void* indices = nullptr;
+    size_t indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    glm::vec3 aabbMin = glm::vec3(0.f);
+    glm::vec3 aabbMax = glm::vec3(0.f);
+    float boundingRadius = 0.f;
+
+    size_t vertexBytes() const { return vertexCount * vertexStride; }
+    size_t indexBytes() const { return indexCount * (indexType == GL_UNSIGNED_SHORT ? 2 : 4); }
+
+    // Maps decoded positions back to object space: pos * scale + offset.
+    glm::vec3 positionScale() const;
+    glm::vec3 positionOffset() const;
+};
+
+// Builds an indexed mesh from one OBJ shape. Corners sharing the same
+// (vertex, normal, texcoord) triple are welded into a single vertex, then
+// tangents are generated with GenerateTangents.
+WeldStats BuildMesh(const tinyobj::attrib_t& attrib, const tinyobj::shape_t& shape, MeshData& mesh);
+
+// Memory and vertex shader cost of the welded mesh against drawing every
+// corner as its own vertex with glDrawArrays.
+void PrintWeldStats(const std::string& name, const WeldStats& stats, const MeshView& mesh);
+
+// Moves the indices into shortIndices when every vertex fits in 16 bits.
+void CompactIndices(MeshData& mesh);
+
+// The AABB of the float vertices, and the radius of the smallest sphere
+// around the AABB centre that holds them all (often well inside the AABB's
+// corners).
+void ComputeBounds(MeshData& mesh);
+MeshView ViewOf(const MeshData& mesh);
+
+// Number of vertex shader runs needed to draw the triangle list with a FIFO
+// post-transform cache of the given size.
+size_t CountCacheMisses(const GLuint* indices, size_t indexCount, int cacheSize = VERTEX_CACHE_SIZE);
@@ -0,0 +1,222 @@
+#include "MeshArena.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Instancing.h"
+#include "RenderState.h"
+#include "Stats.h"
+#include "VertexPacking.h"
+
+namespace {
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t IndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+} // namespace
+
+MeshArena::~MeshArena()
+{
+    release();
+}
+
+bool MeshArena::create(size_t vertexPageBytes, size_t indexPageBytes)
+{
+    release();
+
+    m_vertexPageBytes = vertexPageBytes;
+    m_indexPageBytes = indexPageBytes;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+        m_storageAlignment = (size_t)alignment;
+
+    glGenBuffers(1, &m_commandBuffer);
+    glGenBuffers(1, &m_drawDataBuffer);
+    m_indirect = indirectSupported();
+    return true;
+}
+
+void MeshArena::release()
+{
+    for (Page& page : m_pages) {
+        glDeleteVertexArrays(1, &page.vao);
+        GetRenderState().deletedVertexArray(page.vao);
+        glDeleteBuffers(1, &page.vertexBuffer);
+        glDeleteBuffers(1, &page.indexBuffer);
+    }
+    m_pages.clear();
+    m_meshes.clear();
+
+    if (m_commandBuffer)
+        glDeleteBuffers(1, &m_commandBuffer);
+    if (m_drawDataBuffer)
+        glDeleteBuffers(1, &m_drawDataBuffer);
+    m_commandBuffer = 0;
+    m_drawDataBuffer = 0;
+    m_instanceBuffer = 0;
+}
+
+uint32_t MeshArena::add(const MeshView& mesh)
+{
+    uint32_t pageIndex = pageFor(mesh);
+    Page& page = m_pages[pageIndex];
+
+    Mesh entry;
+    entry.page = pageIndex;
+    entry.indexCount = (GLuint)mesh.indexCount;
+    entry.firstIndex = (GLuint)(page.indexUsed / IndexSize(page.indexType));
+    entry.baseVertex = (GLint)(page.vertexUsed / page.vertexStride);
+    entry.data.positionScale = glm::vec4(mesh.positionScale(), 0.f);
+    entry.data.positionOffset = glm::vec4(mesh.positionOffset(), 0.f);
+
+    // Through the copy target, so no VAO's element buffer binding changes.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, page.vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, page.vertexUsed, mesh.vertexBytes(), mesh.vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, page.indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, page.indexUsed, mesh.indexBytes(), mesh.indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    page.vertexUsed += mesh.vertexBytes();
+    page.indexUsed += mesh.indexBytes();
+
+    m_meshes.push_back(entry);
+    return (uint32_t)m_meshes.size() - 1;
+}
+
+uint32_t MeshArena::pageFor(const MeshView& mesh)
+{
+    for (uint32_t i = 0; i < (uint32_t)m_pages.size(); i++) {
+        const Page& page = m_pages[i];
+        if (page.vertexFormat == mesh.vertexFormat && page.vertexStride == mesh.vertexStride &&
+            page.indexType == mesh.indexType &&
+            page.vertexUsed + mesh.vertexBytes() <= page.vertexCapacity &&
+            page.indexUsed + mesh.indexBytes() <= page.indexCapacity)
+            return i;
+    }
+
+    Page page;
+    page.vertexFormat = mesh.vertexFormat;
+    page.vertexStride = mesh.vertexStride;
+    page.indexType = mesh.indexType;
+    page.vertexCapacity = std::max(m_vertexPageBytes, mesh.vertexBytes());
+    page.indexCapacity = std::max(m_indexPageBytes, mesh.indexBytes());
+
+    glGenVertexArrays(1, &page.vao);
+    glGenBuffers(1, &page.vertexBuffer);
+    glGenBuffers(1, &page.indexBuffer);
+
+    GetRenderState().bindVertexArray(page.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, page.vertexCapacity, nullptr, GL_STATIC_DRAW);
+    BindPackedVertexLayout(mesh);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, page.indexCapacity, nullptr, GL_STATIC_DRAW);
+    if (m_instanceBuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+        BindInstanceLayout();
+    }
+    GetRenderState().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_pages.push_back(page);
+    return (uint32_t)m_pages.size() - 1;
+}
+
+void MeshArena::setInstanceBuffer(GLuint buffer)
+{
+    m_instanceBuffer = buffer;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (const Page& page : m_pages) {
+        GetRenderState().bindVertexArray(page.vao);
+        BindInstanceLayout();
+    }
+    GetRenderState().bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool MeshArena::indirectSupported() const
+{
+    return (GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect) &&
+           (GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_shader_draw_parameters);
+}
+
+void MeshArena::setIndirect(bool indirect)
+{
+    m_indirect = indirect && indirectSupported();
+}
+
+void MeshArena::draw(const std::vector<MeshDraw>& draws)
+{
+    // A multi-draw reads its page's data as one array. Draws issued one at
+    // a time each bind their own entry, so those sit on the storage buffer
+    // offset alignment.
+    size_t stride = m_indirect ? sizeof(DrawData) : AlignUp(sizeof(DrawData), m_storageAlignment);
+
+    m_commands.clear();
+    m_drawData.clear();
+    m_batches.clear();
+    for (uint32_t pageIndex = 0; pageIndex < (uint32_t)m_pages.size(); pageIndex++) {
+        Batch batch = { pageIndex, m_commands.size(), 0, AlignUp(m_drawData.size(), m_storageAlignment) };
+        for (const MeshDraw& draw : draws) {
+            if (draw.mesh >= m_meshes.size() || m_meshes[draw.mesh].page != pageIndex || draw.instanceCount == 0)
+                continue;
+            const Mesh& mesh = m_meshes[draw.mesh];
+            m_commands.push_back({ mesh.indexCount, draw.instanceCount, mesh.firstIndex, mesh.baseVertex,
+                                   draw.firstInstance });
+
+            size_t offset = batch.dataOffset + batch.commandCount * stride;
+            m_drawData.resize(offset + sizeof(DrawData));
+            std::memcpy(&m_drawData[offset], &mesh.data, sizeof(DrawData));
+            batch.commandCount++;
+        }
+        if (batch.commandCount > 0)
+            m_batches.push_back(batch);
+    }
+    if (m_batches.empty())
+        return;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawData.size(), m_drawData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (m_indirect) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand),
+                     m_commands.data(), GL_STREAM_DRAW);
+    }
+
+    for (const Batch& batch : m_batches) {
+        const Page& page = m_pages[batch.page];
+        GetRenderState().bindVertexArray(page.vao);
+        if (m_indirect) {
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataBuffer, batch.dataOffset,
+                              batch.commandCount * sizeof(DrawData));
+            glMultiDrawElementsIndirect(GL_TRIANGLES, page.indexType,
+                                        (const void*)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                        (GLsizei)batch.commandCount, 0);
+            GetFrameStats().add(StatCounter::DrawCalls);
+        }
+        else {
+            for (size_t i = 0; i < batch.commandCount; i++) {
+                const DrawElementsIndirectCommand& command = m_commands[batch.firstCommand + i];
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataBuffer,
+                                  batch.dataOffset + i * stride, sizeof(DrawData));
+                glDrawElementsInstancedBaseVertexBaseInstance(
+                    GL_TRIANGLES, (GLsizei)command.count, page.indexType,
+                    (const void*)(command.firstIndex * IndexSize(page.indexType)),
+                    (GLsizei)command.instanceCount, command.baseVertex, command.baseInstance);
+            }
+            GetFrameStats().add(StatCounter::DrawCalls, batch.commandCount);
+        }
+        GetFrameStats().add(StatCounter::DrawCommands, batch.commandCount);
+    }
+    if (m_indirect)
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+// Shader storage binding of the per-draw data sample.vert indexes with
+// gl_DrawID.
+const GLuint DRAW_DATA_BINDING = 0;
+
+// Layout of the DrawElementsIndirectCommand the GL reads from
+// GL_DRAW_INDIRECT_BUFFER.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match the GL layout");
+
+// What sample.vert reads for each draw: the mesh's position dequantization.
+struct DrawData {
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+};
+
+// One object to draw: instances [firstInstance, firstInstance +
+// instanceCount) of the instance buffer, all with the same mesh.
+struct MeshDraw {
+    uint32_t mesh = 0;
+    GLuint firstInstance = 0;
+    GLuint instanceCount = 1;
+};
+
+// Suballocates every mesh into a few large shared vertex and index buffers
+// ("pages"), one VAO per page, so drawing any number of meshes needs no
+// buffer or VAO switches beyond one per page. Meshes with the same vertex
+// format and index type share pages; a mesh larger than a page gets a
+// page of its own.
+//
+// draw() turns the frame's draw list into DrawElementsIndirectCommands and
+// submits each page's share with a single glMultiDrawElementsIndirect, so
+// the number of GL calls does not grow with the number of objects. Per-draw
+// data goes into a shader storage buffer that the shader indexes with
+// gl_DrawID. Without multi-draw indirect or shader draw parameters every
+// draw is issued on its own, with the storage buffer bound at that draw's
+// data (gl_DrawID is 0 for a non-multi draw).
+class MeshArena {
+public:
+    MeshArena() = default;
+    ~MeshArena();
+
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+
+    bool create(size_t vertexPageBytes, size_t indexPageBytes);
+    void release();
+
+    // Copies the mesh into a page and returns its id for MeshDraw::mesh.
+    uint32_t add(const MeshView& mesh);
+
+    // The per-instance attributes of every page VAO, present and future,
+    // read from this buffer (see BindInstanceLayout).
+    void setInstanceBuffer(GLuint buffer);
+
+    // Draws the list with the current program. Draws are grouped by page
+    // and otherwise keep their order. Leaves the last page's VAO bound.
+    void draw(const std::vector<MeshDraw>& draws);
+
+    // Whether draw() uses glMultiDrawElementsIndirect. Can only be turned
+    // on when the GL supports it.
+    bool indirect() const { return m_indirect; }
+    void setIndirect(bool indirect);
+    bool indirectSupported() const;
+
+    size_t pageCount() const { return m_pages.size(); }
+
+private:
+    struct Page {
+        VertexFormat vertexFormat = VertexFormat::Float32;
+        GLsizei vertexStride = 0;
+        GLenum indexType = GL_UNSIGNED_INT;
+        GLuint vao = 0;
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        size_t vertexCapacity = 0;
+        size_t vertexUsed = 0;
+        size_t indexCapacity = 0;
+        size_t indexUsed = 0;
+    };
+
+    struct Mesh {
+        uint32_t page = 0;
+        GLuint indexCount = 0;
+        GLuint firstIndex = 0;
+        GLint baseVertex = 0;
+        DrawData data;
+    };
+
+    // A run of commands that share a page, submitted together.
+    struct Batch {
+        uint32_t page;
+        size_t firstCommand;
+        size_t commandCount;
+        size_t dataOffset; // into m_drawData
+    };
+
+    uint32_t pageFor(const MeshView& mesh);
+
+    size_t m_vertexPageBytes = 0;
+    size_t m_indexPageBytes = 0;
+    std::vector<Page> m_pages;
+    std::vector<Mesh> m_meshes;
+    GLuint m_instanceBuffer = 0;
+
+    bool m_indirect = false;
+    size_t m_storageAlignment = 16;
+    GLuint m_commandBuffer = 0;
+    GLuint m_drawDataBuffer = 0;
+    // Rebuilt every draw(); kept to reuse their memory.
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<unsigned char> m_drawData;
+    std::vector<Batch> m_batches;
+};
@@ -0,0 +1,187 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace {
+
+// Bump when the file layout below changes.
+const uint32_t MESH_CACHE_FILE_VERSION = 3;
+const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+
+// Bytes hashed from each end of the source file. Enough to catch edits that
+// keep the size and timestamp, without reading a multi-hundred-MB scan.
+const size_t HASH_SAMPLE_BYTES = 64 * 1024;
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t fileVersion;
+    uint32_t layoutVersion;
+    uint32_t vertexStride;
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+
+    uint64_t vertexCount;
+    uint64_t vertexOffset;
+    uint64_t indexCount;
+    uint64_t indexOffset;
+    uint32_t indexType;
+    uint32_t vertexFormat;
+
+    float aabbMin[3];
+    float aabbMax[3];
+    float boundingRadius;
+};
+
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+};
+
+uint64_t Fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool StampSource(const std::string& path, SourceStamp& stamp)
+{
+    std::error_code ec;
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    stamp.time = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if (ec)
+        return false;
+
+    MappedFile file;
+    if (!file.open(path.c_str()))
+        return false;
+    size_t head = std::min(file.size(), HASH_SAMPLE_BYTES);
+    size_t tail = std::min(file.size() - head, HASH_SAMPLE_BYTES);
+    stamp.hash = Fnv1a(file.data(), head);
+    stamp.hash = Fnv1a(file.data() + file.size() - tail, tail, stamp.hash);
+    return true;
+}
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+std::string MeshCache::PathFor(const std::string& sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+bool MeshCache::load(const std::string& sourcePath, VertexFormat format)
+{
+    m_file.close();
+    m_view = MeshView();
+
+    SourceStamp stamp;
+    if (!StampSource(sourcePath, stamp))
+        return false;
+    if (!m_file.open(PathFor(sourcePath).c_str()))
+        return false;
+
+    MeshCacheHeader header;
+    if (m_file.size() < sizeof(header)) {
+        m_file.close();
+        return false;
+    }
+    memcpy(&header, m_file.data(), sizeof(header));
+
+    size_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    bool valid =
+        memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.fileVersion == MESH_CACHE_FILE_VERSION &&
+        header.layoutVersion == MESH_LAYOUT_VERSION &&
+        header.vertexFormat == (uint32_t)format &&
+        header.sourceSize == stamp.size &&
+        header.sourceTime == stamp.time &&
+        header.sourceHash == stamp.hash &&
+        header.vertexOffset + header.vertexCount * header.vertexStride <= m_file.size() &&
+        header.indexOffset + header.indexCount * indexSize <= m_file.size();
+    if (!valid) {
+        m_file.close();
+        return false;
+    }
+
+    m_view.vertices = m_file.data() + header.vertexOffset;
+    m_view.vertexCount = (size_t)header.vertexCount;
+    m_view.vertexStride = (GLsizei)header.vertexStride;
+    m_view.vertexFormat = format;
+    m_view.indices = header.indexCount > 0 ? m_file.data() + header.indexOffset : nullptr;
+    m_view.indexCount = (size_t)header.indexCount;
+    m_view.indexType = (GLenum)header.indexType;
+    m_view.aabbMin = glm::vec3(header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]);
+    m_view.aabbMax = glm::vec3(header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]);
+    m_view.boundingRadius = header.boundingRadius;
+    return true;
+}
+
+bool MeshCache::save(const std::string& sourcePath, const MeshView& mesh)
+{
+    SourceStamp stamp;
+    if (!StampSource(sourcePath, stamp))
+        return false;
+
+    MeshCacheHeader header = {};
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.fileVersion = MESH_CACHE_FILE_VERSION;
+    header.layoutVersion = MESH_LAYOUT_VERSION;
+    header.vertexStride = (uint32_t)mesh.vertexStride;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+    header.vertexCount = mesh.vertexCount;
+    header.vertexOffset = AlignUp(sizeof(header), 16);
+    header.indexCount = mesh.indexCount;
+    header.indexOffset = AlignUp(header.vertexOffset + mesh.vertexBytes(), 16);
+    header.indexType = mesh.indexType;
+    header.vertexFormat = (uint32_t)mesh.vertexFormat;
+    for (int i = 0; i < 3; i++) {
+        header.aabbMin[i] = mesh.aabbMin[i];
+        header.aabbMax[i] = mesh.aabbMax[i];
+    }
+    header.boundingRadius = mesh.boundingRadius;
+
+    // Write to a temporary file and rename it over the cache, so a crash
+    // halfway through never leaves a truncated cache that looks valid.
+    std::string path = PathFor(sourcePath);
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    const char padding[16] = {};
+    bool ok =
+        std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+        std::fwrite(padding, 1, header.vertexOffset - sizeof(header), file) == header.vertexOffset - sizeof(header) &&
+        std::fwrite(mesh.vertices, 1, mesh.vertexBytes(), file) == mesh.vertexBytes() &&
+        std::fwrite(padding, 1, header.indexOffset - header.vertexOffset - mesh.vertexBytes(), file) ==
+            header.indexOffset - header.vertexOffset - mesh.vertexBytes() &&
+        std::fwrite(mesh.indices, 1, mesh.indexBytes(), file) == mesh.indexBytes();
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(tempPath, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+
+// Binary sidecar (<source>.meshcache) holding the final interleaved vertex
+// buffer, index buffer and bounds of a mesh. The cache is only used when the
+// source file's size, modification time and sampled content hash match and
+// it was written with the current MESH_LAYOUT_VERSION in the requested
+// vertex format. A hit maps the file and hands out pointers into the
+// mapping, so the data goes straight into glBufferData without being parsed
+// or copied.
+class MeshCache {
+public:
+    static std::string PathFor(const std::string& sourcePath);
+
+    bool load(const std::string& sourcePath, VertexFormat format);
+    static bool save(const std::string& sourcePath, const MeshView& mesh);
+
+    // Valid until the MeshCache is destroyed or load() is called again.
+    const MeshView& view() const { return m_view; }
+
+private:
+    MappedFile m_file;
+    MeshView m_view;
+};
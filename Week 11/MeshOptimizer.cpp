@@ -0,0 +1,298 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Tuning from Forsyth's article. The cache modelled here is LRU, which is
+// what the scoring function was designed for; the stats still use FIFO.
+const int FORSYTH_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRI_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float VertexScore(int cachePosition, unsigned remaining)
+{
+    if (remaining == 0)
+        return -1.f; // no triangles left to draw with this vertex
+
+    float score = 0.f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = LAST_TRI_SCORE;
+        else {
+            float scaler = 1.f / (FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+glm::vec3 PositionOf(const GLfloat* vertices, int floatsPerVertex, GLuint index)
+{
+    const GLfloat* p = vertices + (size_t)index * floatsPerVertex;
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t indexCount)
+{
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+    stats.misses = CountCacheMisses(indices, indexCount);
+
+    std::vector<GLuint> used(indices, indices + indexCount);
+    std::sort(used.begin(), used.end());
+    stats.vertices = std::unique(used.begin(), used.end()) - used.begin();
+    return stats;
+}
+
+void OptimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles touching each vertex, packed per vertex. The first
+    // remaining[v] entries of a vertex's range are the ones not yet drawn.
+    std::vector<unsigned> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++)
+        remaining[indices[i]]++;
+
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<unsigned> adjacency(indexCount);
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i++)
+        adjacency[fill[indices[i]]++] = (unsigned)(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+            vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<GLuint> output;
+    output.reserve(indexCount);
+    std::vector<GLuint> cache, nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    size_t cursor = 0;
+
+    while (output.size() < triangleCount * 3) {
+        if (best == (size_t)-1) {
+            // Nothing in the cache has triangles left; restart from the next
+            // undrawn triangle in input order.
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        const GLuint* tri = indices + best * 3;
+        emitted[best] = 1;
+        for (int k = 0; k < 3; k++) {
+            GLuint v = tri[k];
+            output.push_back(v);
+
+            unsigned* list = &adjacency[offsets[v]];
+            unsigned* last = list + remaining[v] - 1;
+            *std::find(list, last + 1, (unsigned)best) = *last;
+            remaining[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache.
+        nextCache.assign(tri, tri + 3);
+        for (GLuint v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+        }
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            GLuint v = nextCache[i];
+            cachePosition[v] = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // Rescore triangles around every vertex whose score changed, including
+        // the ones that just fell out of the cache, and pick the best one
+        // that still has a vertex in the cache.
+        best = (size_t)-1;
+        float bestScore = -1.f;
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            GLuint v = nextCache[i];
+            for (size_t j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+                unsigned t = adjacency[j];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                    vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if (i < (size_t)FORSYTH_CACHE_SIZE && score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(GLuint* indices, size_t indexCount, const GLfloat* vertices, size_t vertexCount,
+                      int floatsPerVertex, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Hard boundaries: triangles where all three vertices miss a FIFO cache,
+    // i.e. where the cache optimizer had to start a new strip anyway.
+    const size_t NEVER = (size_t)-1;
+    std::vector<size_t> enteredAt(vertexCount, NEVER);
+    std::vector<size_t> hard;
+    std::vector<unsigned> triangleMisses(triangleCount);
+    size_t misses = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        unsigned m = 0;
+        for (int k = 0; k < 3; k++) {
+            size_t& entered = enteredAt[indices[t * 3 + k]];
+            if (entered == NEVER || misses - entered >= (size_t)VERTEX_CACHE_SIZE) {
+                entered = misses++;
+                m++;
+            }
+        }
+        triangleMisses[t] = m;
+        if (m == 3 || t == 0)
+            hard.push_back(t);
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries: inside each hard cluster, cut wherever the ACMR of the
+    // run since the last cut, simulated from a cold cache, is already within
+    // threshold of the whole cluster's. Reordering clusters later flushes the
+    // cache at every cut, so this bounds what the reordering can cost.
+    std::vector<size_t> clusters;
+    std::fill(enteredAt.begin(), enteredAt.end(), NEVER);
+    misses = 0;
+    for (size_t c = 0; c + 1 < hard.size(); c++) {
+        size_t begin = hard[c], end = hard[c + 1];
+        size_t clusterMisses = 0;
+        for (size_t t = begin; t < end; t++)
+            clusterMisses += triangleMisses[t];
+        float limit = threshold * clusterMisses / (end - begin);
+
+        clusters.push_back(begin);
+        size_t runStart = misses, runTriangles = 0;
+        for (size_t t = begin; t < end; t++) {
+            for (int k = 0; k < 3; k++) {
+                size_t& entered = enteredAt[indices[t * 3 + k]];
+                if (entered == NEVER || entered < runStart || misses - entered >= (size_t)VERTEX_CACHE_SIZE)
+                    entered = misses++;
+            }
+            runTriangles++;
+            if (t + 1 < end && misses - runStart <= limit * runTriangles) {
+                clusters.push_back(t + 1);
+                runStart = misses;
+                runTriangles = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Sort clusters by how much they face away from the mesh centre; those
+    // drawn first then occlude the ones behind them from most viewpoints.
+    glm::vec3 meshCentroid(0.f);
+    for (size_t i = 0; i < indexCount; i++)
+        meshCentroid += PositionOf(vertices, floatsPerVertex, indices[i]);
+    meshCentroid /= (float)indexCount;
+
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<float> sortKey(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.f), normal(0.f);
+        float area = 0.f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            glm::vec3 p0 = PositionOf(vertices, floatsPerVertex, indices[t * 3]);
+            glm::vec3 p1 = PositionOf(vertices, floatsPerVertex, indices[t * 3 + 1]);
+            glm::vec3 p2 = PositionOf(vertices, floatsPerVertex, indices[t * 3 + 2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+            float a = glm::length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.f);
+            normal += n;
+            area += a;
+        }
+        centroid = area > 0.f ? centroid / area : PositionOf(vertices, floatsPerVertex, indices[clusters[c] * 3]);
+        float len = glm::length(normal);
+        sortKey[c] = len > 0.f ? glm::dot(centroid - meshCentroid, normal / len) : 0.f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<GLuint> output;
+    output.reserve(indexCount);
+    for (size_t c : order)
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(std::vector<GLfloat>& vertices, int floatsPerVertex, GLuint* indices, size_t indexCount)
+{
+    size_t vertexCount = vertices.size() / floatsPerVertex;
+    const GLuint UNUSED = (GLuint)-1;
+    std::vector<GLuint> remap(vertexCount, UNUSED);
+    std::vector<GLfloat> reordered;
+    reordered.reserve(vertices.size());
+
+    GLuint next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        GLuint& target = remap[indices[i]];
+        if (target == UNUSED) {
+            target = next++;
+            const GLfloat* src = &vertices[(size_t)indices[i] * floatsPerVertex];
+            reordered.insert(reordered.end(), src, src + floatsPerVertex);
+        }
+        indices[i] = target;
+    }
+
+    vertices.swap(reordered);
+    return next;
+}
+
+void OptimizeMesh(MeshData& mesh, VertexCacheStats* before, VertexCacheStats* after)
+{
+    size_t vertexCount = mesh.vertices.size() / FLOATS_PER_VERTEX;
+    if (before)
+        *before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size());
+
+    OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+    OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), vertexCount, FLOATS_PER_VERTEX);
+    OptimizeVertexFetch(mesh.vertices, FLOATS_PER_VERTEX, mesh.indices.data(), mesh.indices.size());
+
+    if (after)
+        *after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size());
+}
+
+void PrintVertexCacheStats(const std::string& name, const VertexCacheStats& before, const VertexCacheStats& after)
+{
+    std::cout << name << ": ACMR " << before.acmr() << " -> " << after.acmr()
+              << ", ATVR " << before.atvr() << " -> " << after.atvr()
+              << " (" << after.triangles << " triangles, FIFO " << VERTEX_CACHE_SIZE << ")" << std::endl;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "Mesh.h"
+
+struct VertexCacheStats {
+    size_t triangles = 0;
+    size_t vertices = 0; // vertices referenced by the index buffer
+    size_t misses = 0;   // vertex shader runs with a FIFO cache of VERTEX_CACHE_SIZE
+
+    float acmr() const { return triangles ? (float)misses / triangles : 0.f; } // misses per triangle, 0.5 is ideal
+    float atvr() const { return vertices ? (float)misses / vertices : 0.f; }   // misses per vertex, 1.0 is ideal
+};
+
+VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t indexCount);
+
+// Reorders triangles for post-transform cache locality (Forsyth, "Linear-Speed
+// Vertex Cache Optimisation"). Vertices are left where they are.
+void OptimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount);
+
+// Splits an already cache-optimized index buffer into clusters wherever the
+// cache was flushed (or the local ACMR stays within `threshold` of the
+// cluster's), then sorts clusters so outward-facing ones are drawn first
+// (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw"). A threshold of 1.05 costs at most ~5% of the cache gains.
+void OptimizeOverdraw(GLuint* indices, size_t indexCount, const GLfloat* vertices, size_t vertexCount,
+                      int floatsPerVertex, float threshold = 1.05f);
+
+// Renumbers vertices in the order the index buffer first uses them and
+// reorders the vertex buffer to match, so vertex fetch walks memory forward.
+// Unreferenced vertices are dropped; returns the new vertex count.
+size_t OptimizeVertexFetch(std::vector<GLfloat>& vertices, int floatsPerVertex, GLuint* indices, size_t indexCount);
+
+// Runs the three passes above on a mesh built by BuildMesh, before
+// CompactIndices. Returns the cache stats before and after.
+void OptimizeMesh(MeshData& mesh, VertexCacheStats* before = nullptr, VertexCacheStats* after = nullptr);
+
+void PrintVertexCacheStats(const std::string& name, const VertexCacheStats& before, const VertexCacheStats& after);
@@ -0,0 +1,292 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const float PI = 3.14159265f;
+const float KAISER_WIDTH = 3.f;
+const float KAISER_ALPHA = 4.f;
+const float LANCZOS_WIDTH = 3.f;
+
+float Sinc(float x)
+{
+    if (std::fabs(x) < 1e-6f)
+        return 1.f;
+    x *= PI;
+    return std::sin(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0.
+float BesselI0(float x)
+{
+    float sum = 1.f, term = 1.f;
+    for (int k = 1; k < 32 && term > sum * 1e-8f; k++) {
+        float f = x / (2.f * k);
+        term *= f * f;
+        sum += term;
+    }
+    return sum;
+}
+
+// Half-width of the filter, in destination texels.
+float FilterSupport(MipFilter filter)
+{
+    switch (filter) {
+    case MipFilter::Box: return 0.5f;
+    case MipFilter::Kaiser: return KAISER_WIDTH;
+    case MipFilter::Lanczos: return LANCZOS_WIDTH;
+    }
+    return 0.5f;
+}
+
+float FilterWeight(MipFilter filter, float t)
+{
+    t = std::fabs(t);
+    switch (filter) {
+    case MipFilter::Box:
+        return t <= 0.5f ? 1.f : 0.f;
+    case MipFilter::Kaiser: {
+        if (t >= KAISER_WIDTH)
+            return 0.f;
+        float x = t / KAISER_WIDTH;
+        return Sinc(t) * BesselI0(KAISER_ALPHA * std::sqrt(1.f - x * x)) / BesselI0(KAISER_ALPHA);
+    }
+    case MipFilter::Lanczos:
+        return t < LANCZOS_WIDTH ? Sinc(t) * Sinc(t / LANCZOS_WIDTH) : 0.f;
+    }
+    return 0.f;
+}
+
+// Source texels and normalized weights for each destination texel of a
+// 1D resample, `count` per texel. With MipWrap::Repeat taps outside the
+// image wrap around, so the small levels of a tiling texture keep its
+// mean. With MipWrap::Clamp they get no weight and the rest are
+// renormalized; clamping them to the edge instead would pile the weight of
+// the whole kernel tail onto the border texels once the kernel is wider
+// than the image.
+struct Taps {
+    int count = 0;
+    std::vector<int> index;
+    std::vector<float> weight;
+};
+
+Taps BuildTaps(int srcSize, int dstSize, MipFilter filter, MipWrap wrap)
+{
+    float scale = (float)srcSize / dstSize;
+    float support = FilterSupport(filter) * scale;
+
+    Taps taps;
+    taps.count = (int)std::ceil(support * 2.f) + 2;
+    taps.index.resize((size_t)dstSize * taps.count);
+    taps.weight.resize((size_t)dstSize * taps.count);
+    for (int d = 0; d < dstSize; d++) {
+        float center = (d + 0.5f) * scale;
+        int first = (int)std::floor(center - support - 0.5f);
+        int* index = &taps.index[(size_t)d * taps.count];
+        float* weight = &taps.weight[(size_t)d * taps.count];
+        float sum = 0.f;
+        for (int k = 0; k < taps.count; k++) {
+            int s = first + k;
+            bool inside = s >= 0 && s < srcSize;
+            if (wrap == MipWrap::Repeat) {
+                index[k] = (s % srcSize + srcSize) % srcSize;
+                inside = true;
+            }
+            else {
+                index[k] = std::clamp(s, 0, srcSize - 1);
+            }
+            weight[k] = inside ? FilterWeight(filter, (s + 0.5f - center) / scale) : 0.f;
+            sum += weight[k];
+        }
+        for (int k = 0; k < taps.count; k++)
+            weight[k] = sum != 0.f ? weight[k] / sum : 0.f;
+    }
+    return taps;
+}
+
+// Resamples each row of a float RGBA image from srcWidth to dstWidth.
+void FilterRows(const float* src, int srcWidth, int rows, const Taps& taps, int dstWidth, float* dst)
+{
+    for (int y = 0; y < rows; y++) {
+        const float* row = src + (size_t)y * srcWidth * 4;
+        float* out = dst + (size_t)y * dstWidth * 4;
+        for (int x = 0; x < dstWidth; x++) {
+            const int* index = &taps.index[(size_t)x * taps.count];
+            const float* weight = &taps.weight[(size_t)x * taps.count];
+#ifdef MIP_GENERATOR_SSE
+            // Two accumulators so consecutive taps do not wait on each
+            // other's add.
+            __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+            int k = 0;
+            for (; k + 2 <= taps.count; k += 2) {
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(row + index[k] * 4), _mm_set1_ps(weight[k])));
+                sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(row + index[k + 1] * 4), _mm_set1_ps(weight[k + 1])));
+            }
+            if (k < taps.count)
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(row + index[k] * 4), _mm_set1_ps(weight[k])));
+            _mm_storeu_ps(out + x * 4, _mm_add_ps(sum0, sum1));
+#else
+            float sum[4] = {};
+            for (int k = 0; k < taps.count; k++) {
+                for (int c = 0; c < 4; c++)
+                    sum[c] += row[index[k] * 4 + c] * weight[k];
+            }
+            std::copy(sum, sum + 4, out + x * 4);
+#endif
+        }
+    }
+}
+
+// Resamples each column of a float RGBA image to dstHeight rows, one
+// weighted source row at a time so the inner loop streams.
+void FilterColumns(const float* src, int width, const Taps& taps, int dstHeight, float* dst)
+{
+    size_t rowFloats = (size_t)width * 4;
+    for (int y = 0; y < dstHeight; y++) {
+        float* out = dst + y * rowFloats;
+        std::fill(out, out + rowFloats, 0.f);
+        for (int k = 0; k < taps.count; k++) {
+            float weight = taps.weight[(size_t)y * taps.count + k];
+            if (weight == 0.f)
+                continue;
+            const float* row = src + taps.index[(size_t)y * taps.count + k] * rowFloats;
+#ifdef MIP_GENERATOR_SSE
+            __m128 w = _mm_set1_ps(weight);
+            for (size_t i = 0; i < rowFloats; i += 4)
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), w)));
+#else
+            for (size_t i = 0; i < rowFloats; i++)
+                out[i] += row[i] * weight;
+#endif
+        }
+    }
+}
+
+float SrgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+}
+
+unsigned char ToByte(float v)
+{
+    return (unsigned char)std::lround(std::clamp(v, 0.f, 1.f) * 255.f);
+}
+
+// Bytes to the space the filter runs in: linear light, [-1, 1] vectors or
+// plain [0, 1].
+void ToFloat(const unsigned char* rgba, size_t pixels, const MipSettings& settings, float* out)
+{
+    float table[256];
+    for (int i = 0; i < 256; i++) {
+        float v = i / 255.f;
+        table[i] = settings.normalMap ? v * 2.f - 1.f : settings.srgb ? SrgbToLinear(v) : v;
+    }
+    for (size_t p = 0; p < pixels; p++) {
+        for (int c = 0; c < 3; c++)
+            out[p * 4 + c] = table[rgba[p * 4 + c]];
+        out[p * 4 + 3] = rgba[p * 4 + 3] / 255.f;
+    }
+}
+
+void ToBytes(const float* in, size_t pixels, const MipSettings& settings, unsigned char* out)
+{
+    for (size_t p = 0; p < pixels; p++) {
+        const float* v = in + p * 4;
+        if (settings.normalMap) {
+            float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            float n[3] = { 0.f, 0.f, 1.f };
+            if (length > 1e-6f) {
+                for (int c = 0; c < 3; c++)
+                    n[c] = v[c] / length;
+            }
+            for (int c = 0; c < 3; c++)
+                out[p * 4 + c] = ToByte(n[c] * 0.5f + 0.5f);
+        }
+        else {
+            for (int c = 0; c < 3; c++)
+                out[p * 4 + c] = ToByte(settings.srgb ? LinearToSrgb(std::max(v[c], 0.f)) : v[c]);
+        }
+        out[p * 4 + 3] = ToByte(v[3]);
+    }
+}
+
+} // namespace
+
+std::vector<std::vector<std::vector<unsigned char>>> GenerateMipChains(
+    const unsigned char* const* faces, int faceCount, int width, int height,
+    const MipSettings& settings, unsigned threads)
+{
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
+
+    std::vector<std::vector<std::vector<unsigned char>>> chains(faceCount);
+    for (int face = 0; face < faceCount; face++) {
+        chains[face].resize(levels);
+        chains[face][0].assign(faces[face], faces[face] + (size_t)width * height * 4);
+    }
+    if (levels == 1)
+        return chains;
+
+    std::vector<Taps> rowTaps(levels), columnTaps(levels);
+    for (int level = 1; level < levels; level++) {
+        rowTaps[level] = BuildTaps(width, std::max(1, width >> level), settings.filter, settings.wrapS);
+        columnTaps[level] = BuildTaps(height, std::max(1, height >> level), settings.filter, settings.wrapT);
+    }
+
+    std::vector<std::vector<float>> base(faceCount);
+    ParallelFor((size_t)faceCount, [&](size_t begin, size_t end, unsigned) {
+        for (size_t face = begin; face < end; face++) {
+            base[face].resize((size_t)width * height * 4);
+            ToFloat(faces[face], (size_t)width * height, settings, base[face].data());
+        }
+    }, threads);
+
+    // Every level is filtered straight from level 0, so each (face, level)
+    // pair is independent and costs about the same: the column pass reads
+    // all of level 0 whatever the level. Columns go first because that pass
+    // streams whole rows; the row pass then only sees the reduced height.
+    size_t items = (size_t)faceCount * (levels - 1);
+    ParallelFor(items, [&](size_t begin, size_t end, unsigned) {
+        std::vector<float> columns, mip;
+        for (size_t item = begin; item < end; item++) {
+            int face = (int)(item / (levels - 1));
+            int level = (int)(item % (levels - 1)) + 1;
+            int w = std::max(1, width >> level);
+            int h = std::max(1, height >> level);
+
+            columns.resize((size_t)width * h * 4);
+            FilterColumns(base[face].data(), width, columnTaps[level], h, columns.data());
+            mip.resize((size_t)w * h * 4);
+            FilterRows(columns.data(), width, h, rowTaps[level], w, mip.data());
+
+            chains[face][level].resize((size_t)w * h * 4);
+            ToBytes(mip.data(), (size_t)w * h, settings, chains[face][level].data());
+        }
+    }, threads);
+    return chains;
+}
+
+const char* MipFilterName(MipFilter filter)
+{
+    switch (filter) {
+    case MipFilter::Box: return "box";
+    case MipFilter::Kaiser: return "kaiser";
+    case MipFilter::Lanczos: return "lanczos";
+    }
+    return "?";
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter : uint32_t {
+    Box,     // average of the source texels each mip texel covers
+    Kaiser,  // Kaiser-windowed sinc, 3 texels wide; sharp with little ringing
+    Lanczos, // Lanczos-3; a little sharper than Kaiser, a little more ringing
+};
+
+// What the filter does with taps past the edge of the image; it should
+// match how the texture is sampled.
+enum class MipWrap : uint32_t {
+    Clamp,  // dropped, and the taps inside reweighted to sum to one
+    Repeat, // wrapped to the other side, for tiling textures
+};
+
+struct MipSettings {
+    MipFilter filter = MipFilter::Kaiser;
+    // Filter in linear light. RGB is treated as sRGB-encoded (alpha is not),
+    // so mips of albedo textures do not darken.
+    bool srgb = false;
+    // RGB holds a unit vector as (n + 1) / 2. Filtered vectors are
+    // renormalized so the mips do not flatten the lighting.
+    bool normalMap = false;
+    // Across the width and the height.
+    MipWrap wrapS = MipWrap::Repeat;
+    MipWrap wrapT = MipWrap::Repeat;
+};
+
+// Builds the full mip chains of one or more same-sized RGBA8 images (e.g.
+// the six faces of a cube map). Every level is filtered directly from level
+// 0, so the (face, level) pairs are independent and run in parallel. The
+// filtering uses SSE where available. Returns the levels as
+// chains[face][level]; level 0 is a copy of the input.
+std::vector<std::vector<std::vector<unsigned char>>> GenerateMipChains(
+    const unsigned char* const* faces, int faceCount, int width, int height,
+    const MipSettings& settings, unsigned threads = 0);
+
+const char* MipFilterName(MipFilter filter);
@@ -0,0 +1,78 @@
+#include "NormalMatrix.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NORMAL_MATRIX_SSE 1
+#include <emmintrin.h>
+#endif
+
+glm::mat3 NormalMatrix(const glm::mat4& model)
+{
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 r0 = glm::cross(c1, c2);
+    float det = glm::dot(c0, r0);
+    float invDet = det != 0.f ? 1.f / det : 0.f;
+    return glm::mat3(r0 * invDet, glm::cross(c2, c0) * invDet, glm::cross(c0, c1) * invDet);
+}
+
+#ifdef NORMAL_MATRIX_SSE
+
+namespace {
+
+struct Vec3x4 {
+    __m128 x, y, z;
+};
+
+inline Vec3x4 Cross(const Vec3x4& a, const Vec3x4& b)
+{
+    return {
+        _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+        _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+        _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)),
+    };
+}
+
+// Column `column` of the upper 3x3 of four matrices, one per lane.
+inline Vec3x4 LoadColumn(const glm::mat4* m, int column)
+{
+    return {
+        _mm_setr_ps(m[0][column].x, m[1][column].x, m[2][column].x, m[3][column].x),
+        _mm_setr_ps(m[0][column].y, m[1][column].y, m[2][column].y, m[3][column].y),
+        _mm_setr_ps(m[0][column].z, m[1][column].z, m[2][column].z, m[3][column].z),
+    };
+}
+
+inline void StoreColumn(glm::mat3* out, int column, const Vec3x4& v, __m128 scale)
+{
+    alignas(16) float x[4], y[4], z[4];
+    _mm_store_ps(x, _mm_mul_ps(v.x, scale));
+    _mm_store_ps(y, _mm_mul_ps(v.y, scale));
+    _mm_store_ps(z, _mm_mul_ps(v.z, scale));
+    for (int l = 0; l < 4; l++)
+        out[l][column] = glm::vec3(x[l], y[l], z[l]);
+}
+
+} // namespace
+
+#endif
+
+void NormalMatrices(const glm::mat4* models, glm::mat3* out, size_t count)
+{
+    size_t i = 0;
+#ifdef NORMAL_MATRIX_SSE
+    for (; i + 4 <= count; i += 4) {
+        Vec3x4 c0 = LoadColumn(models + i, 0);
+        Vec3x4 c1 = LoadColumn(models + i, 1);
+        Vec3x4 c2 = LoadColumn(models + i, 2);
+
+        Vec3x4 r0 = Cross(c1, c2);
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0.x, r0.x), _mm_mul_ps(c0.y, r0.y)), _mm_mul_ps(c0.z, r0.z));
+        __m128 invDet = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.f), det), _mm_cmpneq_ps(det, _mm_setzero_ps()));
+
+        StoreColumn(out + i, 0, r0, invDet);
+        StoreColumn(out + i, 1, Cross(c2, c0), invDet);
+        StoreColumn(out + i, 2, Cross(c0, c1), invDet);
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = NormalMatrix(models[i]);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// transpose(inverse(mat3(model))), the matrix that carries normals into
+// world space. Built from the cofactors of the upper 3x3, so it costs three
+// cross products and a dot instead of a 4x4 inverse. Singular matrices
+// give a zero matrix.
+glm::mat3 NormalMatrix(const glm::mat4& model);
+
+// NormalMatrix for many instances. Four matrices per iteration with SSE when
+// it is available.
+void NormalMatrices(const glm::mat4* models, glm::mat3* out, size_t count);
@@ -0,0 +1,469 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "ObjLoader.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include "MappedFile.h"
+#include "Parallel.h"
+
+namespace {
+
+// Files smaller than this are parsed on a single thread; spinning up
+// workers costs more than it saves.
+const size_t MIN_BYTES_PER_CHUNK = 1 << 20;
+
+struct NamedMarker {
+    size_t triangle; // first triangle (chunk-local) the name applies to
+    std::string name;
+};
+
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<tinyobj::real_t> vertices;
+    std::vector<tinyobj::real_t> colors;
+    std::vector<tinyobj::real_t> normals;
+    std::vector<tinyobj::real_t> texcoords;
+    std::vector<tinyobj::index_t> indices;
+
+    // Slots (index * 3 + component) that hold a negative OBJ index resolved
+    // against this chunk only. They get the chunk's global offset added when
+    // the chunks are merged.
+    std::vector<size_t> relative;
+
+    // First triangle (chunk-local) of each quad. Quads are emitted as
+    // 0-1-2 / 0-2-3 and re-split once all positions are known.
+    std::vector<size_t> quads;
+
+    std::vector<NamedMarker> shapes;
+    std::vector<NamedMarker> materials;
+    std::vector<std::string> mtllibs;
+
+    size_t vertexOffset = 0;
+    size_t normalOffset = 0;
+    size_t texcoordOffset = 0;
+    size_t triangleOffset = 0;
+    size_t badIndices = 0;
+};
+
+inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline const char* SkipSpace(const char* p, const char* end)
+{
+    while (p < end && IsSpace(*p))
+        ++p;
+    return p;
+}
+
+inline const char* ParseFloat(const char* p, const char* end, tinyobj::real_t& out)
+{
+    p = SkipSpace(p, end);
+    if (p < end && *p == '+')
+        ++p;
+    std::from_chars_result res = std::from_chars(p, end, out);
+    if (res.ec == std::errc::invalid_argument) {
+        out = 0;
+        return p;
+    }
+    if (res.ec == std::errc::result_out_of_range)
+        out = 0; // denormals and the like
+    return res.ptr;
+}
+
+inline const char* ParseInt(const char* p, const char* end, int& out)
+{
+    if (p < end && *p == '+')
+        ++p;
+    std::from_chars_result res = std::from_chars(p, end, out);
+    if (res.ec != std::errc()) {
+        out = 0;
+        return p;
+    }
+    return res.ptr;
+}
+
+inline std::string RestOfLine(const char* p, const char* end)
+{
+    p = SkipSpace(p, end);
+    while (end > p && IsSpace(end[-1]))
+        --end;
+    return std::string(p, end);
+}
+
+struct FaceCorner {
+    tinyobj::index_t idx;
+    unsigned char relative; // bit per component: 1 = vertex, 2 = normal, 4 = texcoord
+};
+
+// Converts a 1-based (or negative, relative) OBJ index into a 0-based one.
+// Negative indices are resolved against the attributes parsed so far in
+// this chunk and flagged so the merge step can shift them.
+inline int ResolveIndex(int idx, size_t localCount, ObjChunk& chunk, unsigned char& relative, unsigned char bit)
+{
+    if (idx > 0)
+        return idx - 1;
+    if (idx < 0) {
+        relative |= bit;
+        return (int)localCount + idx;
+    }
+    chunk.badIndices++;
+    return -1;
+}
+
+void ParseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<FaceCorner>& face)
+{
+    face.clear();
+    size_t vertexCount = chunk.vertices.size() / 3;
+    size_t normalCount = chunk.normals.size() / 3;
+    size_t texcoordCount = chunk.texcoords.size() / 2;
+
+    while (true) {
+        p = SkipSpace(p, end);
+        if (p >= end)
+            break;
+
+        FaceCorner corner = { { -1, -1, -1 }, 0 };
+        int raw = 0;
+
+        p = ParseInt(p, end, raw);
+        corner.idx.vertex_index = ResolveIndex(raw, vertexCount, chunk, corner.relative, 1);
+        if (p < end && *p == '/') {
+            ++p;
+            if (p < end && *p != '/') {
+                p = ParseInt(p, end, raw);
+                corner.idx.texcoord_index = ResolveIndex(raw, texcoordCount, chunk, corner.relative, 4);
+            }
+            if (p < end && *p == '/') {
+                ++p;
+                p = ParseInt(p, end, raw);
+                corner.idx.normal_index = ResolveIndex(raw, normalCount, chunk, corner.relative, 2);
+            }
+        }
+        face.push_back(corner);
+
+        // Skip anything we did not understand in this token.
+        while (p < end && !IsSpace(*p))
+            ++p;
+    }
+
+    if (face.size() < 3)
+        return;
+
+    if (face.size() == 4)
+        chunk.quads.push_back(chunk.indices.size() / 3);
+
+    for (size_t k = 1; k + 1 < face.size(); k++) {
+        const FaceCorner* tri[3] = { &face[0], &face[k], &face[k + 1] };
+        for (const FaceCorner* corner : tri) {
+            size_t slot = chunk.indices.size() * 3;
+            if (corner->relative & 1)
+                chunk.relative.push_back(slot);
+            if (corner->relative & 2)
+                chunk.relative.push_back(slot + 1);
+            if (corner->relative & 4)
+                chunk.relative.push_back(slot + 2);
+            chunk.indices.push_back(corner->idx);
+        }
+    }
+}
+
+void ParseChunk(ObjChunk& chunk)
+{
+    std::vector<FaceCorner> face;
+
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* eol = (const char*)memchr(p, '\n', chunk.end - p);
+        if (!eol)
+            eol = chunk.end;
+        const char* lineEnd = eol;
+        if (lineEnd > p && lineEnd[-1] == '\r')
+            --lineEnd;
+
+        const char* s = SkipSpace(p, lineEnd);
+        size_t len = lineEnd - s;
+
+        if (len >= 2 && s[0] == 'v' && IsSpace(s[1])) {
+            tinyobj::real_t x, y, z;
+            s = ParseFloat(s + 2, lineEnd, x);
+            s = ParseFloat(s, lineEnd, y);
+            s = ParseFloat(s, lineEnd, z);
+            chunk.vertices.push_back(x);
+            chunk.vertices.push_back(y);
+            chunk.vertices.push_back(z);
+
+            // As tinyobj: three more numbers are a vertex colour, anything
+            // else (none, or a w) leaves it white.
+            tinyobj::real_t rgb[3] = { 1.0f, 1.0f, 1.0f };
+            int found = 0;
+            for (; found < 3; found++) {
+                const char* start = SkipSpace(s, lineEnd);
+                if (start == lineEnd || (s = ParseFloat(start, lineEnd, rgb[found])) == start)
+                    break;
+            }
+            for (int i = 0; i < 3; i++)
+                chunk.colors.push_back(found == 3 ? rgb[i] : 1.0f);
+        }
+        else if (len >= 3 && s[0] == 'v' && s[1] == 'n' && IsSpace(s[2])) {
+            tinyobj::real_t x, y, z;
+            s = ParseFloat(s + 3, lineEnd, x);
+            s = ParseFloat(s, lineEnd, y);
+            ParseFloat(s, lineEnd, z);
+            chunk.normals.push_back(x);
+            chunk.normals.push_back(y);
+            chunk.normals.push_back(z);
+        }
+        else if (len >= 3 && s[0] == 'v' && s[1] == 't' && IsSpace(s[2])) {
+            tinyobj::real_t u, v;
+            s = ParseFloat(s + 3, lineEnd, u);
+            ParseFloat(s, lineEnd, v);
+            chunk.texcoords.push_back(u);
+            chunk.texcoords.push_back(v);
+        }
+        else if (len >= 2 && s[0] == 'f' && IsSpace(s[1])) {
+            ParseFace(s + 2, lineEnd, chunk, face);
+        }
+        else if (len >= 2 && (s[0] == 'o' || s[0] == 'g') && IsSpace(s[1])) {
+            chunk.shapes.push_back({ chunk.indices.size() / 3, RestOfLine(s + 2, lineEnd) });
+        }
+        else if (len >= 7 && strncmp(s, "usemtl", 6) == 0 && IsSpace(s[6])) {
+            chunk.materials.push_back({ chunk.indices.size() / 3, RestOfLine(s + 7, lineEnd) });
+        }
+        else if (len >= 7 && strncmp(s, "mtllib", 6) == 0 && IsSpace(s[6])) {
+            chunk.mtllibs.push_back(RestOfLine(s + 7, lineEnd));
+        }
+
+        p = eol + 1;
+    }
+}
+
+// Adds the chunk's global offsets to its indices and copies everything into
+// the merged buffers.
+void MergeChunk(ObjChunk& chunk, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices,
+                size_t totalVertices, size_t totalNormals, size_t totalTexcoords)
+{
+    for (size_t slot : chunk.relative) {
+        tinyobj::index_t& idx = chunk.indices[slot / 3];
+        switch (slot % 3) {
+            case 0: idx.vertex_index += (int)chunk.vertexOffset; break;
+            case 1: idx.normal_index += (int)chunk.normalOffset; break;
+            case 2: idx.texcoord_index += (int)chunk.texcoordOffset; break;
+        }
+    }
+
+    for (const tinyobj::index_t& idx : chunk.indices) {
+        if (idx.vertex_index < 0 || (size_t)idx.vertex_index >= totalVertices ||
+            idx.normal_index < -1 || idx.normal_index >= (int)totalNormals ||
+            idx.texcoord_index < -1 || idx.texcoord_index >= (int)totalTexcoords)
+            chunk.badIndices++;
+    }
+
+    std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib.vertices.begin() + chunk.vertexOffset * 3);
+    std::copy(chunk.colors.begin(), chunk.colors.end(), attrib.colors.begin() + chunk.vertexOffset * 3);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + chunk.normalOffset * 3);
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + chunk.texcoordOffset * 2);
+    std::copy(chunk.indices.begin(), chunk.indices.end(), indices.begin() + chunk.triangleOffset * 3);
+
+    // Release the chunk's memory as soon as it has been merged.
+    chunk.vertices = {};
+    chunk.colors = {};
+    chunk.normals = {};
+    chunk.texcoords = {};
+    chunk.indices = {};
+    chunk.relative = {};
+}
+
+// tinyobj splits a quad along its shorter diagonal: 0-1-2 / 0-2-3 when 0-2
+// is shorter, 0-1-3 / 1-2-3 otherwise. Needs the merged positions, since a
+// quad may index vertices parsed by another chunk.
+void SplitQuads(ObjChunk& chunk, const std::vector<tinyobj::real_t>& v, std::vector<tinyobj::index_t>& indices)
+{
+    for (size_t quad : chunk.quads) {
+        tinyobj::index_t* tri = &indices[(chunk.triangleOffset + quad) * 3];
+        tinyobj::index_t c0 = tri[0], c1 = tri[1], c2 = tri[2], c3 = tri[5];
+
+        const tinyobj::real_t* p0 = &v[c0.vertex_index * 3];
+        const tinyobj::real_t* p1 = &v[c1.vertex_index * 3];
+        const tinyobj::real_t* p2 = &v[c2.vertex_index * 3];
+        const tinyobj::real_t* p3 = &v[c3.vertex_index * 3];
+        tinyobj::real_t e02x = p2[0] - p0[0], e02y = p2[1] - p0[1], e02z = p2[2] - p0[2];
+        tinyobj::real_t e13x = p3[0] - p1[0], e13y = p3[1] - p1[1], e13z = p3[2] - p1[2];
+        tinyobj::real_t sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+        tinyobj::real_t sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+        if (!(sqr02 < sqr13)) {
+            tri[0] = c0; tri[1] = c1; tri[2] = c3;
+            tri[3] = c1; tri[4] = c2; tri[5] = c3;
+        }
+    }
+    chunk.quads = {};
+}
+
+void LoadMaterials(const std::vector<ObjChunk>& chunks, const char* mtl_basedir,
+                   std::vector<tinyobj::material_t>* materials,
+                   std::map<std::string, int>& materialMap, std::string& warning)
+{
+    std::string baseDir = mtl_basedir ? mtl_basedir : "";
+    if (!baseDir.empty() && baseDir.back() != '/' && baseDir.back() != '\\')
+        baseDir += '/';
+
+    for (const ObjChunk& chunk : chunks) {
+        for (const std::string& lib : chunk.mtllibs) {
+            std::ifstream mtl(baseDir + lib);
+            if (!mtl) {
+                warning += "Material file [ " + baseDir + lib + " ] not found.\n";
+                continue;
+            }
+            std::string mtlWarning, mtlError;
+            tinyobj::LoadMtl(&materialMap, materials, &mtl, &mtlWarning, &mtlError);
+            warning += mtlWarning + mtlError;
+        }
+    }
+}
+
+} // namespace
+
+bool LoadObjParallel(tinyobj::attrib_t* attrib,
+                     std::vector<tinyobj::shape_t>* shapes,
+                     std::vector<tinyobj::material_t>* materials,
+                     std::string* warn,
+                     std::string* err,
+                     const char* filename,
+                     const char* mtl_basedir,
+                     unsigned threads)
+{
+    *attrib = tinyobj::attrib_t();
+    shapes->clear();
+    materials->clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        if (err)
+            *err = std::string("Cannot open file [") + filename + "]\n";
+        return false;
+    }
+
+    // Split on line boundaries, one chunk per worker.
+    const char* data = file.data();
+    const char* dataEnd = data + file.size();
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(WorkerCount(threads), file.size() / MIN_BYTES_PER_CHUNK));
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* cursor = data;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* split = (i + 1 == chunkCount) ? dataEnd : data + file.size() * (i + 1) / chunkCount;
+        if (split < cursor)
+            split = cursor;
+        const char* eol = split < dataEnd ? (const char*)memchr(split, '\n', dataEnd - split) : nullptr;
+        split = eol ? eol + 1 : dataEnd;
+        chunks[i].begin = cursor;
+        chunks[i].end = split;
+        cursor = split;
+    }
+
+    ParallelFor(chunkCount, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++)
+            ParseChunk(chunks[i]);
+    }, (unsigned)chunkCount);
+
+    size_t totalVertices = 0, totalNormals = 0, totalTexcoords = 0, totalTriangles = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.vertexOffset = totalVertices;
+        chunk.normalOffset = totalNormals;
+        chunk.texcoordOffset = totalTexcoords;
+        chunk.triangleOffset = totalTriangles;
+        totalVertices += chunk.vertices.size() / 3;
+        totalNormals += chunk.normals.size() / 3;
+        totalTexcoords += chunk.texcoords.size() / 2;
+        totalTriangles += chunk.indices.size() / 3;
+    }
+
+    attrib->vertices.resize(totalVertices * 3);
+    attrib->colors.resize(totalVertices * 3);
+    attrib->normals.resize(totalNormals * 3);
+    attrib->texcoords.resize(totalTexcoords * 2);
+    std::vector<tinyobj::index_t> indices(totalTriangles * 3);
+
+    ParallelFor(chunkCount, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++)
+            MergeChunk(chunks[i], *attrib, indices, totalVertices, totalNormals, totalTexcoords);
+    }, (unsigned)chunkCount);
+
+    size_t badIndices = 0;
+    for (const ObjChunk& chunk : chunks)
+        badIndices += chunk.badIndices;
+    if (badIndices > 0) {
+        if (err)
+            *err = "Face index out of bounds (" + std::to_string(badIndices) + " corners) in [" + filename + "]\n";
+        return false;
+    }
+
+    ParallelFor(chunkCount, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++)
+            SplitQuads(chunks[i], attrib->vertices, indices);
+    }, (unsigned)chunkCount);
+
+    std::string warning;
+    std::map<std::string, int> materialMap;
+    LoadMaterials(chunks, mtl_basedir, materials, materialMap, warning);
+
+    // Per-triangle material ids, in file order across chunks.
+    std::vector<int> materialIds(totalTriangles, -1);
+    int currentMaterial = -1;
+    size_t materialStart = 0;
+    auto fillMaterial = [&](size_t upTo) {
+        std::fill(materialIds.begin() + materialStart, materialIds.begin() + upTo, currentMaterial);
+        materialStart = upTo;
+    };
+    for (const ObjChunk& chunk : chunks) {
+        for (const NamedMarker& m : chunk.materials) {
+            fillMaterial(chunk.triangleOffset + m.triangle);
+            std::map<std::string, int>::const_iterator it = materialMap.find(m.name);
+            if (it != materialMap.end())
+                currentMaterial = it->second;
+            else {
+                currentMaterial = -1;
+                warning += "material [ '" + m.name + "' ] not found in .mtl\n";
+            }
+        }
+    }
+    fillMaterial(totalTriangles);
+
+    // Shape boundaries from o/g statements. Like tinyobj, shapes without
+    // faces are dropped.
+    std::vector<NamedMarker> boundaries = { { 0, "" } };
+    for (const ObjChunk& chunk : chunks) {
+        for (const NamedMarker& m : chunk.shapes)
+            boundaries.push_back({ chunk.triangleOffset + m.triangle, m.name });
+    }
+    boundaries.push_back({ totalTriangles, "" });
+
+    for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+        size_t first = boundaries[i].triangle;
+        size_t last = boundaries[i + 1].triangle;
+        if (last <= first)
+            continue;
+
+        tinyobj::shape_t shape;
+        shape.name = boundaries[i].name;
+        if (first == 0 && last == totalTriangles)
+            shape.mesh.indices.swap(indices);
+        else
+            shape.mesh.indices.assign(indices.begin() + first * 3, indices.begin() + last * 3);
+        shape.mesh.num_face_vertices.assign(last - first, 3);
+        shape.mesh.material_ids.assign(materialIds.begin() + first, materialIds.begin() + last);
+        shape.mesh.smoothing_group_ids.assign(last - first, 0);
+        shapes->push_back(std::move(shape));
+    }
+
+    if (warn)
+        *warn = warning;
+    return true;
+}
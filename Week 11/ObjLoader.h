@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tiny_obj_loader.h"
+
+// Parallel version of tinyobj::LoadObj. The file is memory mapped and split
+// on line boundaries into one chunk per worker thread; each chunk is parsed
+// on its own and the results are merged into the usual tinyobj attrib_t /
+// shape_t layout. Materials referenced through mtllib are loaded with
+// tinyobj::LoadMtl. Vertex colours (v x y z r g b) go to attrib.colors,
+// white when absent, as with tinyobj.
+// Faces are always triangulated. Triangles and quads come out as tinyobj's
+// (a quad is split along its shorter diagonal); larger polygons are fanned
+// from their first corner, where tinyobj ear-clips them. An out-of-range
+// face index fails the whole load, where tinyobj skips the face and
+// returns true.
+// threads = 0 uses every hardware thread.
+bool LoadObjParallel(tinyobj::attrib_t* attrib,
+                     std::vector<tinyobj::shape_t>* shapes,
+                     std::vector<tinyobj::material_t>* materials,
+                     std::string* warn,
+                     std::string* err,
+                     const char* filename,
+                     const char* mtl_basedir = nullptr,
+                     unsigned threads = 0);
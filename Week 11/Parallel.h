@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+inline unsigned WorkerCount(unsigned requested = 0)
+{
+    if (requested > 0)
+        return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+// Splits [0, count) into one contiguous range per worker and runs
+// fn(begin, end, worker) on each. The calling thread takes the first range.
+template <typename Fn>
+void ParallelFor(size_t count, Fn fn, unsigned workers = 0)
+{
+    workers = (unsigned)std::min<size_t>(WorkerCount(workers), std::max<size_t>(count, 1));
+    if (workers <= 1) {
+        fn((size_t)0, count, 0u);
+        return;
+    }
+
+    size_t step = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (unsigned w = 1; w < workers; w++) {
+        size_t begin = std::min(count, w * step);
+        size_t end = std::min(count, begin + step);
+        threads.emplace_back(fn, begin, end, w);
+    }
+    fn((size_t)0, std::min(count, step), 0u);
+
+    for (std::thread& t : threads)
+        t.join();
+}
+
+// Fixed set of worker threads pulling jobs from a shared queue. submit()
+// returns a future for the job's result; the destructor finishes the jobs
+// already queued and joins the workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned workers = 0)
+    {
+        workers = WorkerCount(workers);
+        m_threads.reserve(workers);
+        for (unsigned w = 0; w < workers; w++)
+            m_threads.emplace_back([this] { run(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& t : m_threads)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename Fn>
+    std::future<std::invoke_result_t<Fn>> submit(Fn fn)
+    {
+        using Result = std::invoke_result_t<Fn>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.emplace_back([task] { (*task)(); });
+        }
+        m_wake.notify_one();
+        return result;
+    }
+
+    unsigned size() const { return (unsigned)m_threads.size(); }
+
+private:
+    void run()
+    {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+                if (m_jobs.empty())
+                    return;
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
@@ -0,0 +1,104 @@
+#include "Picking.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "VertexPacking.h"
+
+namespace {
+
+// Moller-Trumbore; both sides of the triangle count.
+bool IntersectTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& t)
+{
+    glm::vec3 edge1 = b - a, edge2 = c - a;
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float det = glm::dot(edge1, p);
+    if (det == 0.f)
+        return false;
+    float invDet = 1.f / det;
+    glm::vec3 s = ray.origin - a;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.f || u > 1.f)
+        return false;
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(ray.direction, q) * invDet;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+    t = glm::dot(edge2, q) * invDet;
+    return t >= 0.f;
+}
+
+} // namespace
+
+void MeshPicker::build(const MeshView& mesh)
+{
+    m_positions.resize(mesh.vertexCount);
+    const unsigned char* vertices = (const unsigned char*)mesh.vertices;
+    glm::vec3 scale = mesh.positionScale(), offset = mesh.positionOffset();
+    for (size_t i = 0; i < mesh.vertexCount; i++) {
+        const unsigned char* vertex = vertices + i * mesh.vertexStride;
+        GLfloat decoded[FLOATS_PER_VERTEX];
+        if (mesh.vertexFormat == VertexFormat::Float32)
+            std::copy((const GLfloat*)vertex, (const GLfloat*)vertex + FLOATS_PER_VERTEX, decoded);
+        else
+            UnpackVertex(*(const PackedVertex*)vertex, mesh.vertexFormat, scale, offset, decoded);
+        m_positions[i] = glm::vec3(decoded[POSITION_OFFSET], decoded[POSITION_OFFSET + 1], decoded[POSITION_OFFSET + 2]);
+    }
+
+    m_indices.resize(mesh.indexCount);
+    for (size_t i = 0; i < mesh.indexCount; i++) {
+        m_indices[i] = mesh.indexType == GL_UNSIGNED_SHORT ? ((const GLushort*)mesh.indices)[i]
+                                                           : ((const GLuint*)mesh.indices)[i];
+    }
+
+    std::vector<Aabb> boxes(m_indices.size() / 3);
+    for (size_t t = 0; t < boxes.size(); t++) {
+        for (int corner = 0; corner < 3; corner++)
+            boxes[t].grow(m_positions[m_indices[t * 3 + corner]]);
+    }
+    m_bvh.build(boxes);
+}
+
+bool MeshPicker::raycast(const Ray& ray, float maxDistance, float& distance) const
+{
+    uint32_t triangle;
+    return m_bvh.raycast(ray, maxDistance, [&](uint32_t t, float& nearest) {
+        float hit;
+        if (!IntersectTriangle(ray, m_positions[m_indices[t * 3]], m_positions[m_indices[t * 3 + 1]],
+                               m_positions[m_indices[t * 3 + 2]], hit) || hit >= nearest)
+            return false;
+        nearest = hit;
+        return true;
+    }, triangle, distance);
+}
+
+Ray ScreenRay(double x, double y, float width, float height, const glm::mat4& viewProjection)
+{
+    float ndcX = (float)(x / width) * 2.f - 1.f;
+    float ndcY = 1.f - (float)(y / height) * 2.f;
+    glm::mat4 inverse = glm::inverse(viewProjection);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.f, 1.f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.f, 1.f);
+
+    Ray ray;
+    ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+    ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+    return ray;
+}
+
+bool PickObject(const Bvh& scene, const std::vector<glm::mat4>& transforms, const MeshPicker& mesh, const Ray& ray,
+                uint32_t& object, float& distance)
+{
+    return scene.raycast(ray, 1.f, [&](uint32_t candidate, float& nearest) {
+        // An affine transform keeps distances along the ray.
+        glm::mat4 toObject = glm::inverse(transforms[candidate]);
+        Ray local;
+        local.origin = glm::vec3(toObject * glm::vec4(ray.origin, 1.f));
+        local.direction = glm::mat3(toObject) * ray.direction;
+        float hit;
+        if (!mesh.raycast(local, nearest, hit))
+            return false;
+        nearest = hit;
+        return true;
+    }, object, distance);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "Mesh.h"
+
+// A mesh's triangles in object space with a BVH over them, for ray picks
+// against the actual surface rather than its bounds.
+class MeshPicker {
+public:
+    // Decodes the positions (packed or float) and builds the BVH.
+    void build(const MeshView& mesh);
+
+    // Nearest triangle the ray hits before maxDistance. Distances are in
+    // units of the ray direction's length, so they stay comparable after
+    // the ray is carried into another space by an affine transform.
+    bool raycast(const Ray& ray, float maxDistance, float& distance) const;
+
+    size_t triangleCount() const { return m_indices.size() / 3; }
+
+private:
+    std::vector<glm::vec3> m_positions;
+    std::vector<uint32_t> m_indices;
+    Bvh m_bvh;
+};
+
+// World-space ray through a window position (pixels from the top left, as
+// GLFW reports the cursor), from the near plane (distance 0) to the far
+// plane (distance 1).
+Ray ScreenRay(double x, double y, float width, float height, const glm::mat4& viewProjection);
+
+// First object the ray hits: the scene BVH finds the objects whose boxes
+// the ray enters, then the ray is carried into each one's object space and
+// tested against the mesh triangles, nearest first.
+bool PickObject(const Bvh& scene, const std::vector<glm::mat4>& transforms, const MeshPicker& mesh, const Ray& ray,
+                uint32_t& object, float& distance);
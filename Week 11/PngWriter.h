@@ -0,0 +1,7 @@
+#pragma once
+
+// Writes an 8-bit RGBA image as a PNG. The image data is stored in
+// uncompressed deflate blocks, so files are large but the writer needs no
+// zlib. Rows are written bottom-up when flipY is set, which is what
+// glReadPixels returns.
+bool WritePng(const char* path, int width, int height, const unsigned char* rgba, bool flipY = false);
@@ -0,0 +1,136 @@
+#include "ProgramCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include "MappedFile.h"
+#include "ShaderProgram.h"
+
+namespace {
+
+// Bump when the file layout below changes.
+const uint32_t PROGRAM_CACHE_FILE_VERSION = 1;
+const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'R', 'G', 'B' };
+
+struct ProgramCacheHeader {
+    char magic[4];
+    uint32_t fileVersion;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+uint64_t Fnv1a(const std::string& data, uint64_t hash = 14695981039346656037ull)
+{
+    for (char c : data) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+    // Separates fields, so ("ab", "c") and ("a", "bc") hash differently.
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+std::string GlString(GLenum name)
+{
+    const char* value = (const char*)glGetString(name);
+    return value ? value : "";
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(std::string directory) : m_directory(std::move(directory))
+{
+    m_driver = GlString(GL_VENDOR) + "\n" + GlString(GL_RENDERER) + "\n" + GlString(GL_VERSION);
+
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    m_enabled = formats > 0;
+}
+
+uint64_t ProgramCache::keyFor(const ShaderSource& source) const
+{
+    uint64_t key = Fnv1a(source.vert);
+    key = Fnv1a(source.frag, key);
+    key = Fnv1a(source.defines, key);
+    return Fnv1a(m_driver, key);
+}
+
+std::string ProgramCache::pathFor(uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return (std::filesystem::path(m_directory) / name).string();
+}
+
+bool ProgramCache::load(uint64_t key, GLuint program)
+{
+    if (!m_enabled)
+        return false;
+
+    MappedFile file;
+    ProgramCacheHeader header;
+    bool found = file.open(pathFor(key).c_str()) && file.size() >= sizeof(header);
+    if (found) {
+        memcpy(&header, file.data(), sizeof(header));
+        found = memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                header.fileVersion == PROGRAM_CACHE_FILE_VERSION && header.key == key &&
+                sizeof(header) + (size_t)header.binaryLength <= file.size();
+    }
+    if (!found) {
+        m_misses++;
+        return false;
+    }
+
+    glProgramBinary(program, (GLenum)header.binaryFormat, file.data() + sizeof(header), (GLsizei)header.binaryLength);
+    m_hits++;
+    return true;
+}
+
+bool ProgramCache::save(uint64_t key, GLuint program)
+{
+    if (!m_enabled)
+        return false;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    std::vector<char> binary((size_t)length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramCacheHeader header = {};
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.fileVersion = PROGRAM_CACHE_FILE_VERSION;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binaryLength = (uint32_t)length;
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+
+    // Written to a temporary file and renamed over the cache, as
+    // MeshCache::save does, so a crash never leaves a truncated binary.
+    std::string path = pathFor(key);
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(binary.data(), 1, (size_t)length, file) == (size_t)length;
+    ok = std::fclose(file) == 0 && ok;
+
+    if (ok)
+        std::filesystem::rename(tempPath, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+struct ShaderSource;
+
+// Linked program binaries on disk, one file per program in `directory`,
+// named by a key hashed from both stages' source, the defines and the GL
+// vendor, renderer and version strings. An edited shader or a driver update
+// changes the key, so a stale binary is never even tried; a driver that
+// still rejects a binary (glProgramBinary leaves the program unlinked) is
+// handled by ShaderProgram compiling from source and saving over it.
+//
+// Construct with the context current: the driver strings are read then.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::string directory = "ShaderCache");
+
+    // False when the driver offers no binary formats (or no
+    // glGetProgramBinary); load and save then do nothing.
+    bool enabled() const { return m_enabled; }
+
+    uint64_t keyFor(const ShaderSource& source) const;
+
+    // glProgramBinary from the key's file. True when a binary was handed to
+    // the driver; its link status still says whether it was accepted.
+    bool load(uint64_t key, GLuint program);
+
+    // Stores the program's binary under the key. The program must have been
+    // linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    bool save(uint64_t key, GLuint program);
+
+    // ShaderProgram reports a binary the driver did not link; it counts as
+    // a miss rather than a hit.
+    void rejected() { m_hits--; m_misses++; }
+
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+
+private:
+    std::string pathFor(uint64_t key) const;
+
+    std::string m_directory;
+    std::string m_driver;
+    bool m_enabled = false;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+};
@@ -0,0 +1,123 @@
+#include "RenderState.h"
+
+#include "Stats.h"
+
+namespace {
+
+// Never a valid name or enum for the shadowed state, so nothing matches it.
+const GLuint UNKNOWN = 0xffffffffu;
+
+int TargetSlot(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_CUBE_MAP:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+} // namespace
+
+RenderState& GetRenderState()
+{
+    static RenderState state;
+    return state;
+}
+
+bool RenderState::change(GLuint& shadow, GLuint value)
+{
+    if (shadow == value) {
+        GetFrameStats().add(StatCounter::StateChangesSkipped);
+        return false;
+    }
+    shadow = value;
+    GetFrameStats().add(StatCounter::StateChanges);
+    return true;
+}
+
+void RenderState::useProgram(GLuint program)
+{
+    if (change(m_program, program))
+        glUseProgram(program);
+}
+
+void RenderState::bindVertexArray(GLuint vertexArray)
+{
+    if (change(m_vertexArray, vertexArray))
+        glBindVertexArray(vertexArray);
+}
+
+void RenderState::activeTexture(GLenum unit)
+{
+    if (change(m_activeTexture, unit))
+        glActiveTexture(unit);
+}
+
+void RenderState::bindTexture(GLenum target, GLuint texture)
+{
+    int slot = TargetSlot(target);
+    GLuint unit = m_activeTexture - GL_TEXTURE0;
+    if (slot < 0 || m_activeTexture == UNKNOWN || unit >= TEXTURE_UNITS) {
+        glBindTexture(target, texture);
+        GetFrameStats().add(StatCounter::StateChanges);
+        return;
+    }
+    if (change(m_textures[unit][slot], texture))
+        glBindTexture(target, texture);
+}
+
+void RenderState::bindTexture(GLenum unit, GLenum target, GLuint texture)
+{
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void RenderState::depthMask(GLboolean mask)
+{
+    if (change(m_depthMask, mask))
+        glDepthMask(mask);
+}
+
+void RenderState::depthFunc(GLenum func)
+{
+    if (change(m_depthFunc, func))
+        glDepthFunc(func);
+}
+
+void RenderState::deletedProgram(GLuint program)
+{
+    if (m_program == program)
+        m_program = UNKNOWN;
+}
+
+void RenderState::deletedTexture(GLuint texture)
+{
+    for (auto& unit : m_textures) {
+        for (GLuint& bound : unit) {
+            if (bound == texture)
+                bound = 0;
+        }
+    }
+}
+
+void RenderState::deletedVertexArray(GLuint vertexArray)
+{
+    if (m_vertexArray == vertexArray)
+        m_vertexArray = 0;
+}
+
+void RenderState::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vertexArray = UNKNOWN;
+    m_activeTexture = UNKNOWN;
+    for (auto& unit : m_textures) {
+        for (GLuint& bound : unit)
+            bound = UNKNOWN;
+    }
+    m_depthMask = UNKNOWN;
+    m_depthFunc = UNKNOWN;
+}
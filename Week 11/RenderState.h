@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Shadows the GL state the render loop sets every frame (program, vertex
+// array, texture units, depth mask and function) and drops calls that would
+// set it to what it already is. Issued and dropped calls go to the
+// StateChanges and StateChangesSkipped frame counters.
+//
+// The shadow is only right while every change to this state goes through
+// here, so the render thread binds these with GetRenderState() rather than
+// with GL directly. Deleting a bound object changes GL's bindings too: tell
+// it with the deleted*() calls. After anything else touches the state (a
+// library, another context) call invalidate().
+class RenderState {
+public:
+    // Units past this, and targets other than 2D and cube map textures, are
+    // not shadowed: their binds are always issued.
+    static const int TEXTURE_UNITS = 16;
+
+    RenderState() { invalidate(); }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    // unit is GL_TEXTUREi, as for glActiveTexture.
+    void activeTexture(GLenum unit);
+    // Binds to the active unit.
+    void bindTexture(GLenum target, GLuint texture);
+    // Makes unit (GL_TEXTUREi) active and binds to it.
+    void bindTexture(GLenum unit, GLenum target, GLuint texture);
+    void depthMask(GLboolean mask);
+    void depthFunc(GLenum func);
+
+    // Call after deleting the object. GL unbinds deleted textures and vertex
+    // arrays; a deleted program stays in use until another is, and its name
+    // may be handed out again, so the current program becomes unknown.
+    void deletedProgram(GLuint program);
+    void deletedTexture(GLuint texture);
+    void deletedVertexArray(GLuint vertexArray);
+
+    // Forgets everything; the next call of each kind is issued.
+    void invalidate();
+
+private:
+    // True (and counted as issued) if value differs from the shadow, which
+    // then takes it.
+    bool change(GLuint& shadow, GLuint value);
+
+    GLuint m_program;
+    GLuint m_vertexArray;
+    GLuint m_activeTexture;
+    GLuint m_textures[TEXTURE_UNITS][2]; // 2D, cube map
+    GLuint m_depthMask;
+    GLuint m_depthFunc;
+};
+
+// The render thread's GL state.
+RenderState& GetRenderState();
@@ -0,0 +1,63 @@
+#include "SampleQuery.h"
+
+SampleQuery::~SampleQuery()
+{
+    release();
+}
+
+bool SampleQuery::create(StatCounter counter, int latency)
+{
+    release();
+    m_counter = counter;
+    m_queries.resize(latency > 0 ? latency : 1);
+    glGenQueries((GLsizei)m_queries.size(), m_queries.data());
+    m_next = 0;
+    m_pending = 0;
+    return true;
+}
+
+void SampleQuery::release()
+{
+    if (!m_queries.empty())
+        glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+    m_queries.clear();
+    m_pending = 0;
+}
+
+void SampleQuery::begin()
+{
+    if (m_queries.empty())
+        return;
+    // Only when every query is still in flight.
+    if (m_pending == (int)m_queries.size())
+        collect(true);
+    glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_next]);
+}
+
+void SampleQuery::end()
+{
+    if (m_queries.empty())
+        return;
+    glEndQuery(GL_SAMPLES_PASSED);
+    m_next = (m_next + 1) % (int)m_queries.size();
+    m_pending++;
+    collect(false);
+}
+
+void SampleQuery::collect(bool wait)
+{
+    int count = (int)m_queries.size();
+    while (m_pending > 0) {
+        GLuint query = m_queries[(m_next - m_pending + count) % count];
+        GLint available = GL_TRUE;
+        if (!wait)
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 samples = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+        GetFrameStats().add(m_counter, samples);
+        m_pending--;
+        wait = false;
+    }
+}
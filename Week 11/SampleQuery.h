@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "Stats.h"
+
+// Counts the samples that pass the depth test between begin() and end(),
+// i.e. how many pixels a pass actually shades. Each frame uses its own
+// GL_SAMPLES_PASSED query and results are read a few frames later, once
+// the GPU has them, so the CPU never waits. Results go to a frame counter.
+class SampleQuery {
+public:
+    SampleQuery() = default;
+    ~SampleQuery();
+
+    SampleQuery(const SampleQuery&) = delete;
+    SampleQuery& operator=(const SampleQuery&) = delete;
+
+    // latency is the number of queries in flight.
+    bool create(StatCounter counter, int latency = 4);
+    void release();
+
+    void begin();
+    void end();
+
+private:
+    // Adds finished results to the counter, oldest first. With wait set,
+    // blocks for the oldest one.
+    void collect(bool wait);
+
+    StatCounter m_counter = StatCounter::Count;
+    std::vector<GLuint> m_queries;
+    int m_next = 0;
+    int m_pending = 0;
+};
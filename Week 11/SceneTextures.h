@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "ShaderPermutations.h"
+#include "TextureCooker.h"
+
+// Every texture the Week 11 scene loads, with how it is cooked. Main.cpp
+// loads these in order (albedo, normal map, skybox) and --cook-textures
+// pre-cooks the same list.
+struct SceneTexture {
+    std::string cookedPath;
+    // One image, or the six faces of a cube map (+X, -X, +Y, -Y, +Z, -Z).
+    std::vector<std::string> sources;
+    TextureCookSettings settings;
+};
+
+// The mip wraps are also how each is sampled, on the GPU (GlWrap) and in
+// the software renderer: the bricks tile, the normal map is clamped
+// vertically and the cube faces meet at clamped edges.
+inline const SceneTexture SCENE_TEXTURES[] = {
+    { "3D/brickwall.jpg.dds", { "3D/brickwall.jpg" },
+      { BlockFormat::BC1, true, { MipFilter::Kaiser, true, false, MipWrap::Repeat, MipWrap::Repeat } } },
+    // Tangent-space normals only need x and y; z is rebuilt in the shader.
+    { "3D/brickwall_normal.jpg.dds", { "3D/brickwall_normal.jpg" },
+      { BlockFormat::BC5, true, { MipFilter::Kaiser, false, true, MipWrap::Repeat, MipWrap::Clamp } } },
+    { "Skybox/rainbow.dds", {
+          "Skybox/rainbow_rt.png", "Skybox/rainbow_lf.png", "Skybox/rainbow_up.png",
+          "Skybox/rainbow_dn.png", "Skybox/rainbow_ft.png", "Skybox/rainbow_bk.png" },
+      { BlockFormat::BC1, false, { MipFilter::Kaiser, true, false, MipWrap::Clamp, MipWrap::Clamp } } },
+};
+
+// The GL wrap mode for a texture cooked with `wrap`.
+inline GLint GlWrap(MipWrap wrap)
+{
+    return wrap == MipWrap::Repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+}
+
+// What the scene's meshes are drawn with: indices into SCENE_TEXTURES (-1
+// for none), and whether texels with alpha under 0.5 are cut out.
+struct SceneMaterial {
+    int albedo;
+    int normalMap;
+    bool alphaTest;
+};
+
+// The brick wall albedo is a JPEG: no alpha, so no alpha test.
+inline const SceneMaterial SCENE_MATERIALS[] = {
+    { 0, 1, false },
+};
+
+// The sample.frag permutation a material is drawn with.
+inline uint32_t ShaderFeaturesFor(const SceneMaterial& material)
+{
+    uint32_t features = SHADER_POINT_LIGHT;
+    if (material.normalMap >= 0)
+        features |= SHADER_NORMAL_MAP;
+    if (material.alphaTest)
+        features |= SHADER_ALPHA_TEST;
+    return features;
+}
@@ -0,0 +1,75 @@
+#include "ShaderPermutations.h"
+
+namespace {
+
+struct FeatureName {
+    ShaderFeature feature;
+    const char* define;
+    const char* name;
+};
+
+const FeatureName FEATURE_NAMES[SHADER_FEATURE_COUNT] = {
+    { SHADER_POINT_LIGHT, "POINT_LIGHT", "point light" },
+    { SHADER_NORMAL_MAP, "NORMAL_MAP", "normal map" },
+    { SHADER_ALPHA_TEST, "ALPHA_TEST", "alpha test" },
+};
+
+} // namespace
+
+std::string ShaderDefines(uint32_t features)
+{
+    std::string defines;
+    for (const FeatureName& feature : FEATURE_NAMES) {
+        if (features & feature.feature)
+            defines += std::string("#define ") + feature.define + " 1\n";
+    }
+    return defines;
+}
+
+std::string ShaderFeatureNames(uint32_t features)
+{
+    std::string names;
+    for (const FeatureName& feature : FEATURE_NAMES) {
+        if (features & feature.feature)
+            names += (names.empty() ? "" : " + ") + std::string(feature.name);
+    }
+    return names.empty() ? "unlit" : names;
+}
+
+ShaderPermutations::Permutation* ShaderPermutations::find(uint32_t features)
+{
+    for (Permutation& permutation : m_permutations) {
+        if (permutation.features == features)
+            return &permutation;
+    }
+    return nullptr;
+}
+
+void ShaderPermutations::addBuilds(const std::vector<uint32_t>& features, std::vector<ProgramBuild>& builds)
+{
+    for (uint32_t set : features) {
+        if (find(set))
+            continue;
+        m_permutations.push_back({ set, std::make_unique<ShaderProgram>() });
+        builds.push_back({ m_permutations.back().program.get(),
+                           ShaderSource::FromFiles(m_vertPath.c_str(), m_fragPath.c_str(), ShaderDefines(set)) });
+        builds.back().source.label += " [" + ShaderFeatureNames(set) + "]";
+    }
+}
+
+bool ShaderPermutations::prepare(const std::vector<uint32_t>& features)
+{
+    std::vector<ProgramBuild> builds;
+    addBuilds(features, builds);
+    return BuildPrograms(builds, m_cache);
+}
+
+ShaderProgram* ShaderPermutations::get(uint32_t features)
+{
+    Permutation* permutation = find(features);
+    if (!permutation) {
+        prepare({ features });
+        permutation = find(features);
+    }
+    return permutation->program->id() ? permutation->program.get() : nullptr;
+}
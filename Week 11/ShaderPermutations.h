@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ShaderProgram.h"
+
+class ProgramCache;
+
+// The feature flags of sample.frag, one #define each (see the top of the
+// shader). A permutation is the program built with a set of them.
+enum ShaderFeature : uint32_t {
+    SHADER_POINT_LIGHT = 1u << 0,
+    SHADER_NORMAL_MAP = 1u << 1,
+    SHADER_ALPHA_TEST = 1u << 2,
+};
+
+const uint32_t SHADER_FEATURE_COUNT = 3;
+
+// "#define POINT_LIGHT 1\n..." for ShaderSource::defines.
+std::string ShaderDefines(uint32_t features);
+// "point light + normal map", or "unlit" for none, for reports.
+std::string ShaderFeatureNames(uint32_t features);
+
+// The permutations of one vertex + fragment shader pair that are in use.
+// Nothing is built until asked for, so the variants no material needs
+// never reach the compiler.
+class ShaderPermutations {
+public:
+    struct Permutation {
+        uint32_t features;
+        std::unique_ptr<ShaderProgram> program;
+    };
+
+    ShaderPermutations(std::string vertPath, std::string fragPath, ProgramCache* cache = nullptr)
+        : m_vertPath(std::move(vertPath)), m_fragPath(std::move(fragPath)), m_cache(cache)
+    {
+    }
+
+    // Builds the ones of these not built yet, all at once (BuildPrograms).
+    // Returns false if any failed to build; get() returns null for those.
+    bool prepare(const std::vector<uint32_t>& features);
+    // Same, but only adds the builds to `builds`, to start them along with
+    // other programs; the caller runs BuildPrograms.
+    void addBuilds(const std::vector<uint32_t>& features, std::vector<ProgramBuild>& builds);
+
+    // The program for a set of features, built on the spot if prepare()
+    // did not include it. Null if it did not build.
+    ShaderProgram* get(uint32_t features);
+
+    // Every permutation asked for so far, in the order they were.
+    const std::vector<Permutation>& permutations() const { return m_permutations; }
+    const std::string& vertPath() const { return m_vertPath; }
+    const std::string& fragPath() const { return m_fragPath; }
+
+    // Releases every program. Needs the context.
+    void release() { m_permutations.clear(); }
+
+private:
+    Permutation* find(uint32_t features);
+
+    std::string m_vertPath;
+    std::string m_fragPath;
+    ProgramCache* m_cache;
+    std::vector<Permutation> m_permutations;
+};
@@ -0,0 +1,382 @@
+#include "ShaderProgram.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ProgramCache.h"
+#include "RenderState.h"
+#include "Stats.h"
+
+namespace {
+
+std::string ReadFile(const char* path)
+{
+    std::fstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+// Inserts the defines after the #version line, which has to stay first.
+std::string WithDefines(const std::string& source, const std::string& defines)
+{
+    if (defines.empty())
+        return source;
+    size_t version = source.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return defines + source;
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+// Starts the compile; the status is checked after linking, so the driver
+// is not made to finish it here.
+GLuint CompileShader(GLenum stage, const std::string& source)
+{
+    GLuint shader = glCreateShader(stage);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+void PrintShaderLog(GLuint shader, const std::string& label)
+{
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cout << label << ": " << log << std::endl;
+    }
+}
+
+bool ParallelCompileSupported()
+{
+    return GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+}
+
+// Bytes of one element of a uniform type; only used to size the value cache.
+size_t UniformTypeSize(GLenum type)
+{
+    switch (type) {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 16;
+        case GL_FLOAT_MAT3: return 36;
+        case GL_FLOAT_MAT4: return 64;
+        default: return 4; // scalars and samplers
+    }
+}
+
+} // namespace
+
+ShaderProgram::~ShaderProgram()
+{
+    release();
+}
+
+void ShaderProgram::release()
+{
+    for (GLuint& shader : m_shaders) {
+        if (shader)
+            glDeleteShader(shader);
+        shader = 0;
+    }
+    if (m_program) {
+        glDeleteProgram(m_program);
+        GetRenderState().deletedProgram(m_program);
+    }
+    m_program = 0;
+    m_building = false;
+    m_table.clear();
+    m_values.clear();
+}
+
+void ShaderProgram::use() const
+{
+    GetRenderState().useProgram(m_program);
+}
+
+void ShaderProgram::swap(ShaderProgram& other) noexcept
+{
+    std::swap(m_program, other.m_program);
+    std::swap(m_building, other.m_building);
+    std::swap(m_shaders, other.m_shaders);
+    std::swap(m_source, other.m_source);
+    std::swap(m_cache, other.m_cache);
+    std::swap(m_cacheKey, other.m_cacheKey);
+    std::swap(m_fromCache, other.m_fromCache);
+    std::swap(m_table, other.m_table);
+    std::swap(m_values, other.m_values);
+}
+
+ShaderSource ShaderSource::FromFiles(const char* vertPath, const char* fragPath, std::string defines)
+{
+    ShaderSource source;
+    source.vert = ReadFile(vertPath);
+    source.frag = ReadFile(fragPath);
+    source.defines = std::move(defines);
+    source.label = std::string(vertPath) + " + " + fragPath;
+    return source;
+}
+
+bool ShaderProgram::load(const char* vertPath, const char* fragPath)
+{
+    startBuild(ShaderSource::FromFiles(vertPath, fragPath));
+    return finishBuild();
+}
+
+bool ShaderProgram::build(const char* vertSource, const char* fragSource, const char* label)
+{
+    startBuild({ vertSource, fragSource, "", label });
+    return finishBuild();
+}
+
+void ShaderProgram::startBuild(const ShaderSource& source, ProgramCache* cache)
+{
+    release();
+    m_source = source;
+    m_cache = cache && cache->enabled() ? cache : nullptr;
+    m_building = true;
+    m_program = glCreateProgram();
+
+    m_fromCache = false;
+    if (m_cache) {
+        m_cacheKey = m_cache->keyFor(source);
+        m_fromCache = m_cache->load(m_cacheKey, m_program);
+    }
+    if (!m_fromCache)
+        compileAndLink();
+}
+
+void ShaderProgram::compileAndLink()
+{
+    m_shaders[0] = CompileShader(GL_VERTEX_SHADER, WithDefines(m_source.vert, m_source.defines));
+    m_shaders[1] = CompileShader(GL_FRAGMENT_SHADER, WithDefines(m_source.frag, m_source.defines));
+    glAttachShader(m_program, m_shaders[0]);
+    glAttachShader(m_program, m_shaders[1]);
+    if (m_cache)
+        glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(m_program);
+}
+
+bool ShaderProgram::buildComplete() const
+{
+    if (!m_building || !ParallelCompileSupported())
+        return true;
+    GLint complete = GL_TRUE;
+    glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+bool ShaderProgram::finishBuild()
+{
+    if (!m_building)
+        return m_program != 0;
+    m_building = false;
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(m_program, GL_LINK_STATUS, &ok);
+    if (!ok && m_fromCache) {
+        // The driver no longer takes this binary; the rebuilt program is
+        // saved over it below.
+        m_cache->rejected();
+        glDeleteProgram(m_program);
+        GetRenderState().deletedProgram(m_program);
+        m_program = glCreateProgram();
+        m_fromCache = false;
+        compileAndLink();
+        glGetProgramiv(m_program, GL_LINK_STATUS, &ok);
+    }
+
+    if (!ok) {
+        for (GLuint shader : m_shaders)
+            PrintShaderLog(shader, m_source.label);
+        char log[1024];
+        glGetProgramInfoLog(m_program, sizeof(log), NULL, log);
+        std::cout << m_source.label << ": " << log << std::endl;
+        release();
+        return false;
+    }
+
+    // The program keeps what it needs; the shaders are freed with it.
+    for (GLuint& shader : m_shaders) {
+        if (shader) {
+            glDetachShader(m_program, shader);
+            glDeleteShader(shader);
+        }
+        shader = 0;
+    }
+    if (m_cache && !m_fromCache)
+        m_cache->save(m_cacheKey, m_program);
+    return introspect();
+}
+
+bool ShaderProgram::introspect()
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    size_t tableSize = 8;
+    while (tableSize < (size_t)count * 2)
+        tableSize *= 2;
+    m_table.assign(tableSize, Uniform());
+    m_values.clear();
+
+    std::vector<char> name(maxLength + 1);
+    bool ok = true;
+    for (GLint i = 0; i < count; i++) {
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_program, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+
+        // Uniforms in blocks have no location and are set through buffers.
+        GLint location = glGetUniformLocation(m_program, name.data());
+        if (location < 0)
+            continue;
+
+        // Arrays are reported as "name[0]"; they are set through the plain name.
+        if (char* bracket = strchr(name.data(), '['))
+            *bracket = '\0';
+
+        uint32_t hash = UniformName::Hash(name.data());
+        size_t slot = hash & (tableSize - 1);
+        while (m_table[slot].location >= 0 && m_table[slot].hash != hash)
+            slot = (slot + 1) & (tableSize - 1);
+        if (m_table[slot].location >= 0) {
+            std::cout << "Uniform " << name.data() << " collides with another uniform's hash" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        Uniform& uniform = m_table[slot];
+        uniform.hash = hash;
+        uniform.location = location;
+        uniform.valueOffset = (uint32_t)m_values.size();
+        uniform.valueSize = (uint32_t)(UniformTypeSize(type) * size);
+        m_values.resize(m_values.size() + uniform.valueSize);
+    }
+    return ok;
+}
+
+ShaderProgram::Uniform* ShaderProgram::find(uint32_t hash)
+{
+    if (m_table.empty())
+        return nullptr;
+    size_t mask = m_table.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        Uniform& uniform = m_table[slot];
+        if (uniform.location < 0)
+            return nullptr;
+        if (uniform.hash == hash)
+            return &uniform;
+    }
+}
+
+bool ShaderProgram::changed(Uniform& uniform, const void* value, size_t size)
+{
+    if (size > uniform.valueSize)
+        size = uniform.valueSize;
+    unsigned char* cached = &m_values[uniform.valueOffset];
+    if (uniform.valid && memcmp(cached, value, size) == 0) {
+        GetFrameStats().add(StatCounter::UniformsSkipped);
+        return false;
+    }
+    memcpy(cached, value, size);
+    uniform.valid = true;
+    GetFrameStats().add(StatCounter::UniformUploads);
+    return true;
+}
+
+void ShaderProgram::bindUniformBlock(const char* name, GLuint binding)
+{
+    GLuint index = glGetUniformBlockIndex(m_program, name);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_program, index, binding);
+}
+
+void ShaderProgram::invalidate()
+{
+    for (Uniform& uniform : m_table)
+        uniform.valid = false;
+}
+
+void ShaderProgram::set(UniformName name, int value)
+{
+    Uniform* uniform = find(name.hash);
+    if (uniform && changed(*uniform, &value, sizeof(value)))
+        glProgramUniform1i(m_program, uniform->location, value);
+}
+
+void ShaderProgram::set(UniformName name, float value)
+{
+    Uniform* uniform = find(name.hash);
+    if (uniform && changed(*uniform, &value, sizeof(value)))
+        glProgramUniform1f(m_program, uniform->location, value);
+}
+
+void ShaderProgram::set(UniformName name, const glm::vec3& value)
+{
+    Uniform* uniform = find(name.hash);
+    if (uniform && changed(*uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniform3fv(m_program, uniform->location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(UniformName name, const glm::vec4& value)
+{
+    Uniform* uniform = find(name.hash);
+    if (uniform && changed(*uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniform4fv(m_program, uniform->location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(UniformName name, const glm::mat3& value)
+{
+    Uniform* uniform = find(name.hash);
+    if (uniform && changed(*uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniformMatrix3fv(m_program, uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::set(UniformName name, const glm::mat4& value)
+{
+    Uniform* uniform = find(name.hash);
+    if (uniform && changed(*uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniformMatrix4fv(m_program, uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+bool BuildPrograms(const std::vector<ProgramBuild>& builds, ProgramCache* cache)
+{
+    // Let the driver use as many compiler threads as it likes.
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xffffffffu);
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xffffffffu);
+
+    for (const ProgramBuild& build : builds)
+        build.program->startBuild(build.source, cache);
+
+    bool ok = true;
+    std::vector<bool> finished(builds.size(), false);
+    for (size_t remaining = builds.size(); remaining > 0;) {
+        bool progressed = false;
+        for (size_t i = 0; i < builds.size(); i++) {
+            if (finished[i] || !builds[i].program->buildComplete())
+                continue;
+            ok = builds[i].program->finishBuild() && ok;
+            finished[i] = true;
+            remaining--;
+            progressed = true;
+        }
+        if (!progressed)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return ok;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class ProgramCache;
+
+// FNV-1a hash of a uniform name. constexpr so that names written as
+// literals are hashed by the compiler rather than every frame.
+struct UniformName {
+    uint32_t hash;
+
+    constexpr UniformName(const char* name) : hash(Hash(name)) {}
+
+    static constexpr uint32_t Hash(const char* name, uint32_t h = 2166136261u)
+    {
+        return *name ? Hash(name + 1, (h ^ (uint8_t)*name) * 16777619u) : h;
+    }
+};
+
+// Both stages of a program. defines (e.g. "#define FOO 1\n") goes right
+// after each stage's #version line.
+struct ShaderSource {
+    std::string vert;
+    std::string frag;
+    std::string defines;
+    std::string label; // prefixes compile and link errors
+
+    static ShaderSource FromFiles(const char* vertPath, const char* fragPath, std::string defines = "");
+
+    bool operator==(const ShaderSource& other) const
+    {
+        return vert == other.vert && frag == other.frag && defines == other.defines;
+    }
+    bool operator!=(const ShaderSource& other) const { return !(*this == other); }
+};
+
+// A linked vertex + fragment program. After linking, every active uniform is
+// looked up once and stored in a flat open-addressed table keyed by the
+// hash of its name, so setting a uniform never goes through
+// glGetUniformLocation. Setters keep a copy of the last value uploaded and
+// skip the GL call when it has not changed.
+class ShaderProgram {
+public:
+    ShaderProgram() = default;
+    ~ShaderProgram();
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Compiles and links the two shader files. Compile and link errors are
+    // printed; returns false if the program did not link.
+    bool load(const char* vertPath, const char* fragPath);
+
+    // Same as load, from source strings. label prefixes any error output.
+    bool build(const char* vertSource, const char* fragSource, const char* label);
+
+    // Compiles and links, or with a cache loads the cached binary, without
+    // waiting for the driver; finishBuild() waits and checks the result.
+    // With GL_KHR_parallel_shader_compile the driver works on every program
+    // started in between on its own threads (see BuildPrograms).
+    void startBuild(const ShaderSource& source, ProgramCache* cache = nullptr);
+    // Whether finishBuild() would return without waiting on the driver.
+    bool buildComplete() const;
+    // Prints compile and link errors; returns false if the program did not
+    // link. A cached binary the driver rejects is rebuilt from source, and
+    // a program built from source is saved to the cache.
+    bool finishBuild();
+
+    // Deletes the program. Needs the context, so call it before glfwTerminate.
+    void release();
+
+    // Exchanges the two programs, uniform tables and all; used to put a
+    // rebuilt program in place of the one being drawn with.
+    void swap(ShaderProgram& other) noexcept;
+
+    const ShaderSource& source() const { return m_source; }
+
+    GLuint id() const { return m_program; }
+    void use() const;
+
+    // Points the named uniform block at a uniform buffer binding point.
+    // Blocks the program does not use are ignored.
+    void bindUniformBlock(const char* name, GLuint binding);
+
+    // Uniforms the program does not use (or that the compiler removed) are
+    // silently ignored, like location -1 with glUniform*.
+    void set(UniformName name, int value);
+    void set(UniformName name, float value);
+    void set(UniformName name, const glm::vec3& value);
+    void set(UniformName name, const glm::vec4& value);
+    void set(UniformName name, const glm::mat3& value);
+    void set(UniformName name, const glm::mat4& value);
+
+    // Drops the cached values, e.g. after something else wrote the uniforms.
+    void invalidate();
+
+private:
+    struct Uniform {
+        uint32_t hash = 0;
+        GLint location = -1;
+        uint32_t valueOffset = 0; // into m_values
+        uint32_t valueSize = 0;
+        bool valid = false;       // m_values holds what was last uploaded
+    };
+
+    void compileAndLink();
+    bool introspect();
+    Uniform* find(uint32_t hash);
+    bool changed(Uniform& uniform, const void* value, size_t size);
+
+    GLuint m_program = 0;
+    // Between startBuild and finishBuild.
+    bool m_building = false;
+    GLuint m_shaders[2] = {};
+    ShaderSource m_source;
+    ProgramCache* m_cache = nullptr;
+    uint64_t m_cacheKey = 0;
+    bool m_fromCache = false;
+
+    std::vector<Uniform> m_table; // power-of-two size, empty slots have location -1
+    std::vector<unsigned char> m_values;
+};
+
+struct ProgramBuild {
+    ShaderProgram* program;
+    ShaderSource source;
+};
+
+// Builds every program at once: all compiles and links (or binary loads)
+// are started before any is waited on, then each is finished as the driver
+// completes it. Returns false if any of them failed to build.
+bool BuildPrograms(const std::vector<ProgramBuild>& builds, ProgramCache* cache = nullptr);
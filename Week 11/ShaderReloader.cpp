@@ -0,0 +1,174 @@
+#include "ShaderReloader.h"
+
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool DirectoryWatcher::open(const std::string& directory)
+{
+    close();
+    m_directory = directory;
+    HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE,
+                                                 FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    m_handle = handle;
+    return true;
+}
+
+void DirectoryWatcher::close()
+{
+    if (m_handle)
+        FindCloseChangeNotification(m_handle);
+    m_handle = nullptr;
+}
+
+bool DirectoryWatcher::poll()
+{
+    if (!m_handle || WaitForSingleObject(m_handle, 0) != WAIT_OBJECT_0)
+        return false;
+    FindNextChangeNotification(m_handle);
+    return true;
+}
+
+#elif defined(__linux__)
+
+bool DirectoryWatcher::open(const std::string& directory)
+{
+    close();
+    m_directory = directory;
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        return false;
+    // IN_CLOSE_WRITE rather than IN_MODIFY, so a file is not read half
+    // written; IN_MOVED_TO catches editors that save by renaming.
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+    if (inotify_add_watch(m_fd, directory.c_str(), mask) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void DirectoryWatcher::close()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+}
+
+bool DirectoryWatcher::poll()
+{
+    if (m_fd < 0)
+        return false;
+    bool changed = false;
+    alignas(inotify_event) char events[4096];
+    while (read(m_fd, events, sizeof(events)) > 0)
+        changed = true;
+    return changed;
+}
+
+#else
+
+namespace {
+
+long long DirectoryStamp(const std::string& directory)
+{
+    size_t stamp = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        auto time = std::filesystem::last_write_time(entry.path(), ec);
+        stamp = stamp * 31 + std::hash<std::string>()(entry.path().string());
+        stamp = stamp * 31 + (size_t)time.time_since_epoch().count();
+    }
+    return (long long)stamp;
+}
+
+} // namespace
+
+bool DirectoryWatcher::open(const std::string& directory)
+{
+    m_directory = directory;
+    m_open = std::filesystem::is_directory(directory);
+    m_stamp = m_open ? DirectoryStamp(directory) : 0;
+    return m_open;
+}
+
+void DirectoryWatcher::close()
+{
+    m_open = false;
+}
+
+bool DirectoryWatcher::poll()
+{
+    if (!m_open)
+        return false;
+    long long stamp = DirectoryStamp(m_directory);
+    bool changed = stamp != m_stamp;
+    m_stamp = stamp;
+    return changed;
+}
+
+#endif
+
+bool ShaderReloader::open(const std::string& directory)
+{
+    if (!m_watcher.open(directory)) {
+        std::cout << "Could not watch " << directory << "; shaders will not reload" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ShaderReloader::watch(ShaderProgram* program, std::string vertPath, std::string fragPath, std::string defines)
+{
+    ShaderSource built = program->source();
+    m_programs.push_back({ program, std::move(vertPath), std::move(fragPath), std::move(defines), built, nullptr });
+}
+
+bool ShaderReloader::update()
+{
+    bool changed = m_watcher.poll();
+    bool replaced = false;
+    for (Watched& watched : m_programs) {
+        if (changed) {
+            ShaderSource source = ShaderSource::FromFiles(watched.vertPath.c_str(), watched.fragPath.c_str(),
+                                                          watched.defines);
+            // An unrelated file changed, or a file is mid-save; a rebuild
+            // already running for an older edit is restarted.
+            if (!source.vert.empty() && !source.frag.empty() && source != watched.lastTried) {
+                watched.lastTried = source;
+                if (!watched.pending)
+                    watched.pending = std::make_unique<ShaderProgram>();
+                watched.pending->startBuild(source, m_cache);
+            }
+        }
+
+        if (!watched.pending || !watched.pending->buildComplete())
+            continue;
+        if (watched.pending->finishBuild()) {
+            watched.program->swap(*watched.pending);
+            std::cout << "Reloaded " << watched.program->source().label << std::endl;
+            replaced = true;
+        }
+        else {
+            std::cout << "Kept the previous " << watched.vertPath << " + " << watched.fragPath << std::endl;
+        }
+        // Deletes the old program, or what is left of the failed one.
+        watched.pending.reset();
+    }
+    return replaced;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ShaderProgram.h"
+
+class ProgramCache;
+
+// Reports changes to the files of one directory (not its subdirectories)
+// without blocking: inotify on Linux, a change notification handle on
+// Windows. Anywhere else every poll() compares the files' write times.
+class DirectoryWatcher {
+public:
+    DirectoryWatcher() = default;
+    ~DirectoryWatcher() { close(); }
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    bool open(const std::string& directory);
+    void close();
+
+    // True if a file was written, created, renamed or deleted since the
+    // last poll. Several changes in between report once.
+    bool poll();
+
+private:
+    std::string m_directory;
+#ifdef _WIN32
+    void* m_handle = nullptr;
+#elif defined(__linux__)
+    int m_fd = -1;
+#else
+    bool m_open = false;
+    long long m_stamp = 0;
+#endif
+};
+
+// Rebuilds programs whose shader files changed while the app runs, so a
+// shader can be edited without reloading the meshes and textures. Builds
+// go into a spare ShaderProgram and are finished on a later update() once
+// the driver is done (straight away without parallel shader compile); the
+// program in use is only swapped out when the new one links. A failed build
+// prints its info log and the old program stays.
+class ShaderReloader {
+public:
+    explicit ShaderReloader(ProgramCache* cache = nullptr) : m_cache(cache) {}
+
+    // Starts watching the directory the programs' files are in.
+    bool open(const std::string& directory);
+
+    // program must have been built from these files and defines already.
+    void watch(ShaderProgram* program, std::string vertPath, std::string fragPath, std::string defines = "");
+
+    // Call once per frame on the GL thread. Returns true when a program was
+    // replaced: its uniform block bindings need setting again.
+    bool update();
+
+private:
+    struct Watched {
+        ShaderProgram* program;
+        std::string vertPath;
+        std::string fragPath;
+        std::string defines;
+        ShaderSource lastTried; // the latest source built, linked or not
+        std::unique_ptr<ShaderProgram> pending;
+    };
+
+    ProgramCache* m_cache;
+    DirectoryWatcher m_watcher;
+    std::vector<Watched> m_programs;
+};
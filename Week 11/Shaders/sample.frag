@@ -3,18 +3,31 @@
  *  		   POINT LIGHT			   *
  * * * * * * * * * * * * * * * * * * * */
 
+// Features are switched on by defines inserted after #version, see
+// ShaderPermutations.h:
+//   POINT_LIGHT  diffuse, specular and ambient from lightPos, falling off
+//                with distance; without it the texture is drawn unlit
+//   NORMAL_MAP   normals from norm_tex; without it the vertex normal
+//   ALPHA_TEST   discards texels with alpha under 0.5. Only for materials
+//                with alpha: a shader that can discard loses early-Z.
+
 uniform sampler2D tex0;
 uniform sampler2D norm_tex;
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-
-uniform float ambientStr;
-uniform vec3 ambientColor;
-
-uniform vec3 cameraPos;
-uniform float specStr;
-uniform float specPhong;
+layout(std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	vec3 cameraPos;
+};
+
+layout(std140) uniform Lighting {
+	vec3 lightPos;
+	float ambientStr;
+	vec3 lightColor;
+	float specStr;
+	vec3 ambientColor;
+	float specPhong;
+};
 
 in vec2 texCoord;
 
@@ -29,14 +42,24 @@ out vec4 FragColor;
 
 void main() {
 	vec4 pixelColor = texture(tex0, texCoord);
+#ifdef ALPHA_TEST
 	if (pixelColor.a < 0.5) {
 		discard;
 	}
-	//vec3 normal = normalize(normCoord);
-	vec3 normal = texture(norm_tex, texCoord).rgb;
-	normal = normalize(normal * 2.0 - 1.0);
+#endif
+
+#ifndef POINT_LIGHT
+	FragColor = pixelColor;
+#else
+#ifdef NORMAL_MAP
+	// BC5 normal map: x and y only, z is rebuilt from the unit length.
+	vec2 normalXY = texture(norm_tex, texCoord).rg * 2.0 - 1.0;
+	vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
 
 	normal = normalize(TBN * normal);
+#else
+	vec3 normal = normalize(normCoord);
+#endif
 
 	vec3 lightDir = normalize(lightPos - fragPos);
 
@@ -62,5 +85,6 @@ void main() {
     diffuse  *= intensity;
     ambientCol *= intensity;
 
-	FragColor = vec4(specColor + diffuse + ambientCol, 1.0) * texture(tex0, texCoord);
+	FragColor = vec4(specColor + diffuse + ambientCol, 1.0) * pixelColor;
+#endif
 }
\ No newline at end of file
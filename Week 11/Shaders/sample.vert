@@ -1,31 +1,65 @@
-#version 330 core
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : enable
 
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 vertexNormal;
+layout(location = 0) in vec4 aPos;         // xyz in [-1, 1] across the mesh AABB, w tangent handedness
+layout(location = 1) in vec2 vertexNormal; // octahedral
 layout(location = 2) in vec2 aTex;
-layout(location = 3) in vec3 m_tan;
-layout(location = 4) in vec3 m_btan;
+layout(location = 3) in vec2 m_tan;        // octahedral
+
+// Per instance (divisor 1)
+layout(location = 4) in mat4 transform;
+layout(location = 8) in mat3 normalMatrix; // transpose(inverse(mat3(transform))), computed on the CPU
 
 out vec2 texCoord;
 out vec3 normCoord;
 out vec3 fragPos;
 out mat3 TBN;
 
-uniform mat4 transform, projection, view;
+layout(std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	vec3 cameraPos;
+};
+
+// One entry per draw of the multi-draw, see MeshArena. A draw issued on its
+// own has gl_DrawID 0 and the buffer bound at its entry.
+struct DrawData {
+	vec4 posScale;
+	vec4 posOffset;
+};
+
+layout(std430, binding = 0) readonly buffer Draws {
+	DrawData draws[];
+};
+
+#ifdef GL_ARB_shader_draw_parameters
+#define DRAW_ID gl_DrawIDARB
+#else
+#define DRAW_ID 0
+#endif
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
 
 void main() {
+	vec3 pos = aPos.xyz * draws[DRAW_ID].posScale.xyz + draws[DRAW_ID].posOffset.xyz;
+
 	//vec3 newPos = vec3(aPos.x + x, aPos.y + y, aPos.z);
-	gl_Position = projection * view * transform * vec4(aPos, 1.0);
+	gl_Position = projection * view * transform * vec4(pos, 1.0);
 	texCoord = aTex;
 
-	mat3 modelMat = mat3(transpose(inverse(transform)));
-	normCoord = modelMat * vertexNormal;
+	normCoord = normalMatrix * octDecode(vertexNormal);
 
-	vec3 T = normalize(modelMat * m_tan);
-	vec3 B = normalize(modelMat * m_btan);
 	vec3 N = normalize(normCoord);
+	vec3 T = normalize(normalMatrix * octDecode(m_tan));
+	vec3 B = cross(N, T) * (aPos.w < 0.0 ? -1.0 : 1.0);
 
 	TBN = mat3(T, B, N);
 
-	fragPos = vec3(transform * vec4(aPos, 1.0));
-}
\ No newline at end of file
+	fragPos = vec3(transform * vec4(pos, 1.0));
+}
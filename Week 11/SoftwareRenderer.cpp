@@ -0,0 +1,715 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+
+#include "VertexPacking.h"
+
+#if defined(__AVX__)
+#define RASTER_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// A tile pixel's triangle is stored as (setup job << JOB_SHIFT) | index of
+// the triangle in that job.
+const uint32_t NO_TRIANGLE = 0xffffffffu;
+const int JOB_SHIFT = 24;
+const size_t MAX_SETUP_JOBS = 128;
+// Clipping makes at most 6 triangles out of one (5 planes), so a job of
+// this many input triangles cannot overflow its index bits.
+const size_t MAX_JOB_TRIANGLES = ((size_t)1 << JOB_SHIFT) / 8;
+// Vertex and setup work is split into this many jobs per worker, so one
+// slow job does not leave the others idle.
+const unsigned JOBS_PER_WORKER = 4;
+// x and y are clipped at this many times w, well outside the screen, which
+// keeps the screen coordinates the edge functions see small enough for
+// float precision while leaving almost every triangle unclipped.
+const float GUARD_BAND = 8.f;
+// Vertex positions are snapped to 1/SUBPIXELS of a pixel, as GPUs do.
+const float SUBPIXELS = 256.f;
+
+// Pixels per row of a block, one per lane.
+const int LANES = SoftwareRenderer::BLOCK_SIZE;
+
+#if defined(RASTER_AVX)
+
+struct Lanes {
+    __m256 v;
+};
+
+inline Lanes Splat(float f) { return { _mm256_set1_ps(f) }; }
+inline Lanes Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void Store(float* p, Lanes a) { _mm256_storeu_ps(p, a.v); }
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator&(Lanes a, Lanes b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline Lanes Greater(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline Lanes GreaterEqual(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline Lanes Less(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+inline int Mask(Lanes a) { return _mm256_movemask_ps(a.v); }
+inline float HorizontalMax(Lanes a)
+{
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+#elif defined(RASTER_SSE)
+
+// Two SSE registers make a row of a block.
+struct Lanes {
+    __m128 lo, hi;
+};
+
+inline Lanes Splat(float f) { return { _mm_set1_ps(f), _mm_set1_ps(f) }; }
+inline Lanes Load(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+inline void Store(float* p, Lanes a)
+{
+    _mm_storeu_ps(p, a.lo);
+    _mm_storeu_ps(p + 4, a.hi);
+}
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+inline Lanes operator&(Lanes a, Lanes b) { return { _mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi) }; }
+inline Lanes Greater(Lanes a, Lanes b) { return { _mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi) }; }
+inline Lanes GreaterEqual(Lanes a, Lanes b) { return { _mm_cmpge_ps(a.lo, b.lo), _mm_cmpge_ps(a.hi, b.hi) }; }
+inline Lanes Less(Lanes a, Lanes b) { return { _mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+inline Lanes Select(Lanes mask, Lanes a, Lanes b)
+{
+    return { _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo)),
+             _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi)) };
+}
+inline int Mask(Lanes a) { return _mm_movemask_ps(a.lo) | _mm_movemask_ps(a.hi) << 4; }
+inline float HorizontalMax(Lanes a)
+{
+    __m128 m = _mm_max_ps(a.lo, a.hi);
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+#else
+
+// Comparisons give 1 or 0 per lane rather than all bits set.
+struct Lanes {
+    float v[LANES];
+};
+
+template <typename Fn>
+inline Lanes Each(Fn fn)
+{
+    Lanes r;
+    for (int i = 0; i < LANES; i++)
+        r.v[i] = fn(i);
+    return r;
+}
+
+inline Lanes Splat(float f) { return Each([&](int) { return f; }); }
+inline Lanes Load(const float* p) { return Each([&](int i) { return p[i]; }); }
+inline void Store(float* p, Lanes a) { std::memcpy(p, a.v, sizeof(a.v)); }
+inline Lanes operator+(Lanes a, Lanes b) { return Each([&](int i) { return a.v[i] + b.v[i]; }); }
+inline Lanes operator*(Lanes a, Lanes b) { return Each([&](int i) { return a.v[i] * b.v[i]; }); }
+inline Lanes operator&(Lanes a, Lanes b) { return Each([&](int i) { return a.v[i] != 0.f && b.v[i] != 0.f ? 1.f : 0.f; }); }
+inline Lanes Greater(Lanes a, Lanes b) { return Each([&](int i) { return a.v[i] > b.v[i] ? 1.f : 0.f; }); }
+inline Lanes GreaterEqual(Lanes a, Lanes b) { return Each([&](int i) { return a.v[i] >= b.v[i] ? 1.f : 0.f; }); }
+inline Lanes Less(Lanes a, Lanes b) { return Each([&](int i) { return a.v[i] < b.v[i] ? 1.f : 0.f; }); }
+inline Lanes Max(Lanes a, Lanes b) { return Each([&](int i) { return std::max(a.v[i], b.v[i]); }); }
+inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return Each([&](int i) { return mask.v[i] != 0.f ? a.v[i] : b.v[i]; }); }
+inline int Mask(Lanes a)
+{
+    int mask = 0;
+    for (int i = 0; i < LANES; i++)
+        mask |= (a.v[i] != 0.f) << i;
+    return mask;
+}
+inline float HorizontalMax(Lanes a) { return *std::max_element(a.v, a.v + LANES); }
+
+#endif
+
+// Runs fn(0) .. fn(jobs - 1) on the pool and waits for all of them.
+template <typename Fn>
+void RunJobs(ThreadPool& pool, size_t jobs, Fn fn)
+{
+    std::vector<std::future<void>> pending;
+    pending.reserve(jobs);
+    for (size_t j = 0; j < jobs; j++)
+        pending.push_back(pool.submit([&fn, j] { fn(j); }));
+    for (std::future<void>& job : pending)
+        job.get();
+}
+
+glm::vec4 Sample(const SoftwareTexture* texture, const glm::vec2& uv, const glm::vec2& uvDx, const glm::vec2& uvDy)
+{
+    return texture ? texture->sample(uv, uvDx, uvDy) : glm::vec4(0.f, 0.f, 0.f, 1.f);
+}
+
+// sample.frag built with features (SHADER_* flags), apart from the alpha
+// test, which is done while rasterizing so that discarded pixels never
+// reach the depth buffer.
+glm::vec4 ShadeFragment(uint32_t features, const CameraBlock& camera, const LightingBlock& lighting,
+                        const SoftwareTexture* albedo, const SoftwareTexture* normalMap, const glm::vec3& fragPos,
+                        const glm::vec2& texCoord, const glm::vec2& texCoordDx, const glm::vec2& texCoordDy,
+                        const glm::mat3& tbn)
+{
+    glm::vec4 pixelColor = Sample(albedo, texCoord, texCoordDx, texCoordDy);
+    if (!(features & SHADER_POINT_LIGHT))
+        return pixelColor;
+
+    glm::vec3 normal;
+    if (features & SHADER_NORMAL_MAP) {
+        glm::vec2 normalXY = glm::vec2(Sample(normalMap, texCoord, texCoordDx, texCoordDy)) * 2.f - 1.f;
+        normal = glm::vec3(normalXY, std::sqrt(std::max(1.f - glm::dot(normalXY, normalXY), 0.f)));
+        normal = glm::normalize(tbn * normal);
+    }
+    else {
+        // The vertex normal, which is the TBN's last column.
+        normal = glm::normalize(tbn[2]);
+    }
+
+    glm::vec3 lightDir = glm::normalize(lighting.lightPos - fragPos);
+
+    float diff = std::max(glm::dot(normal, lightDir), 0.f);
+    glm::vec3 diffuse = diff * lighting.lightColor;
+
+    glm::vec3 ambientCol = lighting.ambientColor * lighting.ambientStr;
+
+    glm::vec3 viewDir = glm::normalize(camera.cameraPos - fragPos);
+    glm::vec3 reflectDir = glm::reflect(-lightDir, normal);
+
+    float spec = std::pow(std::max(glm::dot(reflectDir, viewDir), 0.1f), lighting.specPhong);
+    glm::vec3 specColor = spec * lighting.specStr * lighting.lightColor;
+
+    glm::vec3 toLight = lighting.lightPos - fragPos;
+    float intensity = 100.f / glm::dot(toLight, toLight);
+
+    specColor *= intensity;
+    diffuse *= intensity;
+    ambientCol *= intensity;
+
+    return glm::vec4(specColor + diffuse + ambientCol, 1.f) * pixelColor;
+}
+
+unsigned char ToUnorm8(float f)
+{
+    return (unsigned char)(std::clamp(f, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+} // namespace
+
+void SoftwareRenderer::resize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    m_tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_pixels.assign((size_t)width * height * 4, 0);
+
+    const int blocksPerTile = (TILE_SIZE / BLOCK_SIZE) * (TILE_SIZE / BLOCK_SIZE);
+    m_tiles.resize((size_t)m_tilesX * m_tilesY);
+    for (int ty = 0; ty < m_tilesY; ty++) {
+        for (int tx = 0; tx < m_tilesX; tx++) {
+            Tile& tile = m_tiles[(size_t)ty * m_tilesX + tx];
+            tile.x = tx * TILE_SIZE;
+            tile.y = ty * TILE_SIZE;
+            tile.depth.resize(TILE_SIZE * TILE_SIZE);
+            tile.triangle.resize(TILE_SIZE * TILE_SIZE);
+            tile.blockMaxDepth.resize(blocksPerTile);
+        }
+    }
+}
+
+uint32_t SoftwareRenderer::add(const MeshView& mesh)
+{
+    Mesh entry;
+    entry.vertices.resize(mesh.vertexCount);
+    const unsigned char* vertices = (const unsigned char*)mesh.vertices;
+    glm::vec3 scale = mesh.positionScale(), offset = mesh.positionOffset();
+    for (size_t i = 0; i < mesh.vertexCount; i++) {
+        const unsigned char* vertex = vertices + i * mesh.vertexStride;
+        GLfloat decoded[FLOATS_PER_VERTEX];
+        if (mesh.vertexFormat == VertexFormat::Float32)
+            std::memcpy(decoded, vertex, sizeof(decoded));
+        else
+            UnpackVertex(*(const PackedVertex*)vertex, mesh.vertexFormat, scale, offset, decoded);
+
+        ObjectVertex& out = entry.vertices[i];
+        out.position = glm::vec3(decoded[POSITION_OFFSET], decoded[POSITION_OFFSET + 1], decoded[POSITION_OFFSET + 2]);
+        out.normal = glm::vec3(decoded[NORMAL_OFFSET], decoded[NORMAL_OFFSET + 1], decoded[NORMAL_OFFSET + 2]);
+        out.tangent = glm::vec3(decoded[TANGENT_OFFSET], decoded[TANGENT_OFFSET + 1], decoded[TANGENT_OFFSET + 2]);
+        out.uv = glm::vec2(decoded[UV_OFFSET], decoded[UV_OFFSET + 1]);
+        out.handedness = decoded[TANGENT_OFFSET + 3];
+    }
+
+    entry.indices.resize(mesh.indexCount);
+    for (size_t i = 0; i < mesh.indexCount; i++) {
+        entry.indices[i] = mesh.indexType == GL_UNSIGNED_SHORT ? ((const GLushort*)mesh.indices)[i]
+                                                               : ((const GLuint*)mesh.indices)[i];
+    }
+
+    m_meshes.push_back(std::move(entry));
+    return (uint32_t)(m_meshes.size() - 1);
+}
+
+void SoftwareRenderer::setInstances(const InstanceData* instances, size_t count)
+{
+    m_instances = instances;
+    m_instanceCount = count;
+}
+
+void SoftwareRenderer::setTextures(const SoftwareTexture* albedo, const SoftwareTexture* normalMap,
+                                   const SoftwareTexture* sky)
+{
+    m_albedo = albedo;
+    m_normalMap = normalMap;
+    m_sky = sky;
+}
+
+glm::vec3 SoftwareRenderer::Triangle::weights(float x, float y) const
+{
+    glm::vec3 w;
+    for (int e = 0; e < 3; e++)
+        w[e] = (edgeA[e] * x + edgeB[e] * y + edgeC[e]) * invW[e];
+    return w / (w.x + w.y + w.z);
+}
+
+glm::vec2 SoftwareRenderer::Triangle::texCoord(const glm::vec3& w) const
+{
+    return vertex[0]->texCoord * w.x + vertex[1]->texCoord * w.y + vertex[2]->texCoord * w.z;
+}
+
+void SoftwareRenderer::draw(const std::vector<MeshDraw>& draws)
+{
+    m_stats = SoftwareFrameStats();
+    m_viewProjection = m_camera.projection * m_camera.view;
+
+    size_t vertexCount = 0, triangleCount = 0;
+    m_frameInstances.clear();
+    for (const MeshDraw& draw : draws) {
+        if (draw.mesh >= m_meshes.size())
+            continue;
+        const Mesh& mesh = m_meshes[draw.mesh];
+        for (size_t i = draw.firstInstance; i < (size_t)draw.firstInstance + draw.instanceCount && i < m_instanceCount; i++) {
+            m_frameInstances.push_back({ draw.mesh, (uint32_t)i, vertexCount, triangleCount });
+            vertexCount += mesh.vertices.size();
+            triangleCount += mesh.indices.size() / 3;
+        }
+    }
+    m_stats.trianglesIn = triangleCount;
+
+    size_t workers = m_pool.size();
+    m_varyings.resize(vertexCount);
+    size_t vertexJobs = std::max<size_t>(1, std::min<size_t>(workers * JOBS_PER_WORKER, vertexCount / 256));
+    RunJobs(m_pool, vertexJobs, [&](size_t j) {
+        shadeVertices(vertexCount * j / vertexJobs, vertexCount * (j + 1) / vertexJobs);
+    });
+
+    size_t setupJobs = std::max<size_t>(1, std::min<size_t>(workers * JOBS_PER_WORKER, triangleCount / 256));
+    setupJobs = std::min(MAX_SETUP_JOBS, std::max(setupJobs, (triangleCount + MAX_JOB_TRIANGLES - 1) / MAX_JOB_TRIANGLES));
+    if (m_jobs.size() < setupJobs)
+        m_jobs.resize(setupJobs);
+    RunJobs(m_pool, setupJobs, [&](size_t j) {
+        SetupJob& job = m_jobs[j];
+        job.triangles.clear();
+        job.clipped.clear();
+        job.bins.resize(m_tiles.size());
+        for (std::vector<uint32_t>& bin : job.bins)
+            bin.clear();
+        setupTriangles(triangleCount * j / setupJobs, triangleCount * (j + 1) / setupJobs, job);
+    });
+    m_jobCount = setupJobs;
+
+    RunJobs(m_pool, m_tiles.size(), [&](size_t t) {
+        rasterizeTile(m_tiles[t]);
+        shadeTile(m_tiles[t]);
+    });
+
+    for (size_t j = 0; j < m_jobCount; j++)
+        m_stats.trianglesBinned += m_jobs[j].triangles.size();
+    for (const Tile& tile : m_tiles) {
+        m_stats.blocksSkipped += tile.blocksSkipped;
+        m_stats.pixelsShaded += tile.pixelsShaded;
+    }
+}
+
+size_t SoftwareRenderer::instanceAt(size_t index, bool triangles) const
+{
+    auto first = [triangles](const Instance& instance) {
+        return triangles ? instance.firstTriangle : instance.firstVertex;
+    };
+    auto next = std::upper_bound(m_frameInstances.begin(), m_frameInstances.end(), index,
+                                 [&](size_t i, const Instance& instance) { return i < first(instance); });
+    return (size_t)(next - m_frameInstances.begin()) - 1;
+}
+
+void SoftwareRenderer::shadeVertices(size_t begin, size_t end)
+{
+    if (begin >= end)
+        return;
+    for (size_t k = instanceAt(begin, false); begin < end; k++) {
+        const Instance& instance = m_frameInstances[k];
+        const Mesh& mesh = m_meshes[instance.mesh];
+        const InstanceData& data = m_instances[instance.instance];
+        glm::mat3 normalMatrix(glm::vec3(data.normalMatrix[0]), glm::vec3(data.normalMatrix[1]),
+                               glm::vec3(data.normalMatrix[2]));
+
+        size_t stop = std::min(end, instance.firstVertex + mesh.vertices.size());
+        for (size_t i = begin; i < stop; i++) {
+            // sample.vert
+            const ObjectVertex& vertex = mesh.vertices[i - instance.firstVertex];
+            Varyings& out = m_varyings[i];
+            glm::vec4 world = data.transform * glm::vec4(vertex.position, 1.f);
+            out.position = m_viewProjection * world;
+            out.texCoord = vertex.uv;
+
+            glm::vec3 n = glm::normalize(normalMatrix * vertex.normal);
+            glm::vec3 t = glm::normalize(normalMatrix * vertex.tangent);
+            glm::vec3 b = glm::cross(n, t) * (vertex.handedness < 0.f ? -1.f : 1.f);
+            out.tbn = glm::mat3(t, b, n);
+
+            out.fragPos = glm::vec3(world);
+        }
+        begin = stop;
+    }
+}
+
+void SoftwareRenderer::setupTriangles(size_t begin, size_t end, SetupJob& job)
+{
+    if (begin >= end)
+        return;
+
+    // Outcode bits 0-5 are the frustum planes, 6-9 the guard band. The
+    // near plane (bit 4) and the guard band are clipped against.
+    const glm::vec4 CLIP_PLANES[] = {
+        glm::vec4(0.f, 0.f, 1.f, 1.f),         // near
+        glm::vec4(1.f, 0.f, 0.f, GUARD_BAND),  // left guard
+        glm::vec4(-1.f, 0.f, 0.f, GUARD_BAND), // right guard
+        glm::vec4(0.f, 1.f, 0.f, GUARD_BAND),  // bottom guard
+        glm::vec4(0.f, -1.f, 0.f, GUARD_BAND), // top guard
+    };
+    const uint32_t CLIP_BITS[] = { 1u << 4, 1u << 6, 1u << 7, 1u << 8, 1u << 9 };
+    auto outcode = [](const glm::vec4& p) {
+        uint32_t code = 0;
+        code |= (p.x < -p.w) << 0;
+        code |= (p.x > p.w) << 1;
+        code |= (p.y < -p.w) << 2;
+        code |= (p.y > p.w) << 3;
+        code |= (p.z < -p.w) << 4;
+        code |= (p.z > p.w) << 5;
+        code |= (p.x < -GUARD_BAND * p.w) << 6;
+        code |= (p.x > GUARD_BAND * p.w) << 7;
+        code |= (p.y < -GUARD_BAND * p.w) << 8;
+        code |= (p.y > GUARD_BAND * p.w) << 9;
+        return code;
+    };
+    auto lerp = [](const Varyings& a, const Varyings& b, float t) {
+        Varyings v;
+        v.position = glm::mix(a.position, b.position, t);
+        v.fragPos = glm::mix(a.fragPos, b.fragPos, t);
+        v.texCoord = glm::mix(a.texCoord, b.texCoord, t);
+        v.tbn = a.tbn + (b.tbn - a.tbn) * t;
+        return v;
+    };
+
+    for (size_t k = instanceAt(begin, true); begin < end; k++) {
+        const Instance& instance = m_frameInstances[k];
+        const Mesh& mesh = m_meshes[instance.mesh];
+        const Varyings* varyings = &m_varyings[instance.firstVertex];
+
+        size_t stop = std::min(end, instance.firstTriangle + mesh.indices.size() / 3);
+        for (size_t t = begin; t < stop; t++) {
+            const uint32_t* index = &mesh.indices[(t - instance.firstTriangle) * 3];
+            const Varyings* v[3] = { &varyings[index[0]], &varyings[index[1]], &varyings[index[2]] };
+            uint32_t codes[3] = { outcode(v[0]->position), outcode(v[1]->position), outcode(v[2]->position) };
+            if (codes[0] & codes[1] & codes[2] & 0x3fu)
+                continue;
+
+            uint32_t crossed = codes[0] | codes[1] | codes[2];
+            bool clip = false;
+            for (uint32_t bit : CLIP_BITS)
+                clip |= (crossed & bit) != 0;
+            if (!clip) {
+                emitTriangle(v[0], v[1], v[2], job);
+                continue;
+            }
+
+            // Sutherland-Hodgman against the planes the triangle crosses.
+            Varyings polygon[2][9];
+            int count = 3;
+            for (int i = 0; i < 3; i++)
+                polygon[0][i] = *v[i];
+            int in = 0;
+            for (int p = 0; p < 5 && count > 0; p++) {
+                if (!(crossed & CLIP_BITS[p]))
+                    continue;
+                const glm::vec4& plane = CLIP_PLANES[p];
+                int out = 0;
+                for (int i = 0; i < count; i++) {
+                    const Varyings& a = polygon[in][i];
+                    const Varyings& b = polygon[in][(i + 1) % count];
+                    float da = glm::dot(plane, a.position), db = glm::dot(plane, b.position);
+                    if (da >= 0.f)
+                        polygon[1 - in][out++] = a;
+                    if ((da >= 0.f) != (db >= 0.f))
+                        polygon[1 - in][out++] = lerp(a, b, da / (da - db));
+                }
+                count = out;
+                in = 1 - in;
+            }
+            if (count < 3)
+                continue;
+
+            size_t first = job.clipped.size();
+            for (int i = 0; i < count; i++)
+                job.clipped.push_back(polygon[in][i]);
+            for (int i = 1; i + 1 < count; i++)
+                emitTriangle(&job.clipped[first], &job.clipped[first + i], &job.clipped[first + i + 1], job);
+        }
+        begin = stop;
+    }
+}
+
+void SoftwareRenderer::emitTriangle(const Varyings* a, const Varyings* b, const Varyings* c, SetupJob& job)
+{
+    Triangle tri;
+    tri.vertex[0] = a;
+    tri.vertex[1] = b;
+    tri.vertex[2] = c;
+
+    glm::vec3 screen[3];
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& p = tri.vertex[i]->position;
+        tri.invW[i] = 1.f / p.w;
+        glm::vec3 ndc = glm::vec3(p) * tri.invW[i];
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * m_width, (0.5f - ndc.y * 0.5f) * m_height, ndc.z * 0.5f + 0.5f);
+        // Snapped to the subpixel grid, so edge coefficients are exact.
+        screen[i].x = std::round(screen[i].x * SUBPIXELS) / SUBPIXELS;
+        screen[i].y = std::round(screen[i].y * SUBPIXELS) / SUBPIXELS;
+    }
+
+    float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                 (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+    if (!(std::fabs(area) > 0.f) || !std::isfinite(area))
+        return;
+
+    // Edge i runs between the other two vertices. C is taken at whichever
+    // end comes first in x, then y, rather than as p.x q.y - p.y q.x, which
+    // loses most of its precision to cancellation far from the origin. Both
+    // triangles sharing an edge pick the same end, so they see exactly
+    // opposite values along it and the fill rule gives each pixel on it to
+    // one of them.
+    float sign = area > 0.f ? 1.f : -1.f;
+    tri.ownsEdge = 0;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec3& p = screen[(i + 1) % 3];
+        const glm::vec3& q = screen[(i + 2) % 3];
+        const glm::vec3& origin = p.x < q.x || (p.x == q.x && p.y < q.y) ? p : q;
+        tri.edgeA[i] = sign * (p.y - q.y);
+        tri.edgeB[i] = sign * (q.x - p.x);
+        tri.edgeC[i] = -(tri.edgeA[i] * origin.x + tri.edgeB[i] * origin.y);
+        // Top-left rule: left edges (inside towards +x) and top edges
+        // (horizontal, inside towards +y, which is down) own their pixels.
+        if (tri.edgeA[i] > 0.f || (tri.edgeA[i] == 0.f && tri.edgeB[i] > 0.f))
+            tri.ownsEdge |= 1 << i;
+    }
+
+    // Depth as a plane through vertex 0, from the depth differences, which
+    // stay accurate where the depths themselves are all close to 1.
+    float invArea = 1.f / (area * sign);
+    float dz1 = screen[1].z - screen[0].z, dz2 = screen[2].z - screen[0].z;
+    tri.depthA = (tri.edgeA[1] * dz1 + tri.edgeA[2] * dz2) * invArea;
+    tri.depthB = (tri.edgeB[1] * dz1 + tri.edgeB[2] * dz2) * invArea;
+    tri.depthC = screen[0].z - tri.depthA * screen[0].x - tri.depthB * screen[0].y;
+    tri.minDepth = std::min({ screen[0].z, screen[1].z, screen[2].z });
+
+    // Pixels whose centres fall inside the bounds.
+    float minX = std::min({ screen[0].x, screen[1].x, screen[2].x });
+    float maxX = std::max({ screen[0].x, screen[1].x, screen[2].x });
+    float minY = std::min({ screen[0].y, screen[1].y, screen[2].y });
+    float maxY = std::max({ screen[0].y, screen[1].y, screen[2].y });
+    tri.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+    tri.maxX = std::min(m_width - 1, (int)std::floor(maxX - 0.5f));
+    tri.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+    tri.maxY = std::min(m_height - 1, (int)std::floor(maxY - 0.5f));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+        return;
+
+    uint32_t index = (uint32_t)job.triangles.size();
+    job.triangles.push_back(tri);
+    for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++) {
+        for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++) {
+            // Skip tiles the bounds overlap but the triangle misses, which
+            // long thin triangles do a lot: some edge is negative at every
+            // pixel centre of the tile.
+            float x0 = tx * TILE_SIZE + 0.5f, x1 = std::min((tx + 1) * TILE_SIZE, m_width) - 0.5f;
+            float y0 = ty * TILE_SIZE + 0.5f, y1 = std::min((ty + 1) * TILE_SIZE, m_height) - 0.5f;
+            bool outside = false;
+            for (int i = 0; i < 3 && !outside; i++) {
+                float x = tri.edgeA[i] > 0.f ? x1 : x0;
+                float y = tri.edgeB[i] > 0.f ? y1 : y0;
+                outside = tri.edgeA[i] * x + tri.edgeB[i] * y + tri.edgeC[i] < 0.f;
+            }
+            if (!outside)
+                job.bins[(size_t)ty * m_tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void SoftwareRenderer::rasterizeTile(Tile& tile)
+{
+    std::fill(tile.depth.begin(), tile.depth.end(), 1.f);
+    std::fill(tile.triangle.begin(), tile.triangle.end(), NO_TRIANGLE);
+    std::fill(tile.blockMaxDepth.begin(), tile.blockMaxDepth.end(), 1.f);
+    tile.blocksSkipped = 0;
+
+    const int BLOCKS = TILE_SIZE / BLOCK_SIZE;
+    // Without an albedo texture alpha samples as 1 and nothing is discarded.
+    const bool alphaTest = (m_features & SHADER_ALPHA_TEST) && m_albedo;
+    const size_t tileIndex = (size_t)(tile.y / TILE_SIZE) * m_tilesX + tile.x / TILE_SIZE;
+    float laneOffsets[LANES];
+    for (int i = 0; i < LANES; i++)
+        laneOffsets[i] = i + 0.5f;
+    const Lanes offsets = Load(laneOffsets);
+    const Lanes zero = Splat(0.f);
+
+    for (size_t j = 0; j < m_jobCount; j++) {
+        const SetupJob& job = m_jobs[j];
+        for (uint32_t index : job.bins[tileIndex]) {
+            const Triangle& tri = job.triangles[index];
+            uint32_t packed = (uint32_t)j << JOB_SHIFT | index;
+            int x0 = std::max(tri.minX, tile.x) - tile.x, x1 = std::min(tri.maxX, tile.x + TILE_SIZE - 1) - tile.x;
+            int y0 = std::max(tri.minY, tile.y) - tile.y, y1 = std::min(tri.maxY, tile.y + TILE_SIZE - 1) - tile.y;
+
+            for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+                for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+                    float& blockMax = tile.blockMaxDepth[by * BLOCKS + bx];
+                    if (tri.minDepth >= blockMax) {
+                        tile.blocksSkipped++;
+                        continue;
+                    }
+
+                    float px = (float)(tile.x + bx * BLOCK_SIZE);
+                    Lanes xs = Splat(px) + offsets;
+                    Lanes edgeA[3] = { Splat(tri.edgeA[0]), Splat(tri.edgeA[1]), Splat(tri.edgeA[2]) };
+                    Lanes depthA = Splat(tri.depthA);
+
+                    bool wrote = false;
+                    int rowBegin = std::max(by * BLOCK_SIZE, y0), rowEnd = std::min(by * BLOCK_SIZE + BLOCK_SIZE - 1, y1);
+                    for (int row = rowBegin; row <= rowEnd; row++) {
+                        float y = tile.y + row + 0.5f;
+                        Lanes inside = GreaterEqual(zero, zero);
+                        for (int i = 0; i < 3; i++) {
+                            Lanes e = edgeA[i] * xs + Splat(tri.edgeB[i] * y + tri.edgeC[i]);
+                            inside = inside & ((tri.ownsEdge >> i & 1) ? GreaterEqual(e, zero) : Greater(e, zero));
+                        }
+                        if (!Mask(inside))
+                            continue;
+
+                        float* depthRow = &tile.depth[row * TILE_SIZE + bx * BLOCK_SIZE];
+                        Lanes depth = Load(depthRow);
+                        Lanes z = depthA * xs + Splat(tri.depthB * y + tri.depthC);
+                        Lanes pass = inside & Less(z, depth);
+                        int mask = Mask(pass);
+                        if (!mask)
+                            continue;
+
+                        uint32_t* triangleRow = &tile.triangle[row * TILE_SIZE + bx * BLOCK_SIZE];
+                        if (alphaTest) {
+                            // sample.frag discards texels with alpha under
+                            // 0.5; those pixels keep what was behind.
+                            float zs[LANES];
+                            Store(zs, z);
+                            for (int lanes = mask; lanes; lanes &= lanes - 1) {
+                                int i = 0;
+                                while (!(lanes >> i & 1))
+                                    i++;
+                                float sx = px + i + 0.5f;
+                                glm::vec2 uv = tri.texCoord(tri.weights(sx, y));
+                                glm::vec2 uvDx = tri.texCoord(tri.weights(sx + 1.f, y)) - uv;
+                                glm::vec2 uvDy = tri.texCoord(tri.weights(sx, y + 1.f)) - uv;
+                                if (m_albedo->sample(uv, uvDx, uvDy).a < 0.5f)
+                                    continue;
+                                depthRow[i] = zs[i];
+                                triangleRow[i] = packed;
+                                wrote = true;
+                            }
+                            continue;
+                        }
+
+                        Store(depthRow, Select(pass, z, depth));
+                        for (int lanes = mask; lanes; lanes &= lanes - 1) {
+                            int i = 0;
+                            while (!(lanes >> i & 1))
+                                i++;
+                            triangleRow[i] = packed;
+                        }
+                        wrote = true;
+                    }
+
+                    if (wrote) {
+                        Lanes farthest = Load(&tile.depth[by * BLOCK_SIZE * TILE_SIZE + bx * BLOCK_SIZE]);
+                        for (int row = 1; row < BLOCK_SIZE; row++)
+                            farthest = Max(farthest, Load(&tile.depth[(by * BLOCK_SIZE + row) * TILE_SIZE + bx * BLOCK_SIZE]));
+                        blockMax = HorizontalMax(farthest);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SoftwareRenderer::shadeTile(Tile& tile)
+{
+    tile.pixelsShaded = 0;
+    // The skybox shader's direction: inverse(projection * rotation-only
+    // view) applied to the point on the far plane under the pixel.
+    glm::mat4 skyInverse = glm::inverse(m_camera.projection * glm::mat4(glm::mat3(m_camera.view)));
+
+    int width = std::min(TILE_SIZE, m_width - tile.x), height = std::min(TILE_SIZE, m_height - tile.y);
+    for (int row = 0; row < height; row++) {
+        int y = tile.y + row;
+        unsigned char* out = &m_pixels[((size_t)y * m_width + tile.x) * 4];
+        for (int col = 0; col < width; col++, out += 4) {
+            uint32_t packed = tile.triangle[row * TILE_SIZE + col];
+            float sx = tile.x + col + 0.5f, sy = y + 0.5f;
+            if (packed == NO_TRIANGLE) {
+                glm::vec4 ndc(sx / m_width * 2.f - 1.f, 1.f - sy / m_height * 2.f, 1.f, 1.f);
+                glm::vec4 sky = m_sky ? m_sky->sampleCube(glm::vec3(skyInverse * ndc)) : glm::vec4(0.f, 0.f, 0.f, 1.f);
+                out[0] = ToUnorm8(sky.r);
+                out[1] = ToUnorm8(sky.g);
+                out[2] = ToUnorm8(sky.b);
+                out[3] = 255;
+                continue;
+            }
+
+            // Perspective-correct weights at the pixel and one pixel right
+            // and down, for the texture derivatives.
+            const Triangle& tri = m_jobs[packed >> JOB_SHIFT].triangles[packed & ((1u << JOB_SHIFT) - 1)];
+            glm::vec3 w = tri.weights(sx, sy);
+            glm::vec2 uv = tri.texCoord(w);
+            glm::vec2 uvDx = tri.texCoord(tri.weights(sx + 1.f, sy)) - uv;
+            glm::vec2 uvDy = tri.texCoord(tri.weights(sx, sy + 1.f)) - uv;
+            glm::vec3 fragPos = tri.vertex[0]->fragPos * w.x + tri.vertex[1]->fragPos * w.y + tri.vertex[2]->fragPos * w.z;
+            glm::mat3 tbn = tri.vertex[0]->tbn * w.x + tri.vertex[1]->tbn * w.y + tri.vertex[2]->tbn * w.z;
+
+            glm::vec4 color = ShadeFragment(m_features, m_camera, m_lighting, m_albedo, m_normalMap, fragPos, uv, uvDx, uvDy, tbn);
+            // Blended over the black clear with GL_SRC_ALPHA,
+            // GL_ONE_MINUS_SRC_ALPHA, as the GL path does.
+            out[0] = ToUnorm8(color.r * color.a);
+            out[1] = ToUnorm8(color.g * color.a);
+            out[2] = ToUnorm8(color.b * color.a);
+            out[3] = ToUnorm8(color.a * color.a);
+            tile.pixelsShaded++;
+        }
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Instancing.h"
+#include "Mesh.h"
+#include "MeshArena.h"
+#include "Parallel.h"
+#include "ShaderPermutations.h"
+#include "SoftwareTexture.h"
+#include "UniformBlocks.h"
+
+// What one SoftwareRenderer::draw did.
+struct SoftwareFrameStats {
+    size_t trianglesIn = 0;     // triangles of every instance drawn
+    size_t trianglesBinned = 0; // after frustum rejection and clipping
+    size_t blocksSkipped = 0;   // pixel blocks a triangle was entirely behind
+    size_t pixelsShaded = 0;    // sample.frag runs, one per covered pixel
+};
+
+// Draws the Week 11 scene on the CPU, for machines without a GPU. It takes
+// what the GL path takes: meshes as MeshViews, the frame's MeshDraws over an
+// array of InstanceData, the Camera and Lighting blocks, and the cooked
+// textures (decoded into SoftwareTextures). sample.vert, sample.frag and the
+// skybox shaders are ported to C++ below the rasterizer.
+//
+// A frame runs in three passes on a ThreadPool:
+//   1. vertices: sample.vert for every vertex of every instance
+//   2. setup: triangles rejected against the frustum, clipped against the
+//      near plane and a guard band, turned into edge functions and binned
+//      into every TILE_SIZE square tile they touch
+//   3. tiles: one job per tile, so a tile's memory is only ever touched by
+//      one worker. Edge functions are evaluated a BLOCK_SIZE row of
+//      pixels at a time, in one AVX or two SSE registers. Every BLOCK_SIZE
+//      block of the tile keeps the farthest depth in it, and a triangle
+//      wholly behind that skips the block. Each pixel keeps the nearest
+//      triangle, then sample.frag runs once per covered pixel and the sky
+//      fills the rest.
+// Triangles are not culled by facing, as the GL path does not cull them.
+class SoftwareRenderer {
+public:
+    static const int TILE_SIZE = 64;
+    static const int BLOCK_SIZE = 8;
+
+    explicit SoftwareRenderer(unsigned threads = 0) : m_pool(threads) {}
+
+    SoftwareRenderer(const SoftwareRenderer&) = delete;
+    SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+    void resize(int width, int height);
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Decodes the mesh once and returns its id for MeshDraw::mesh.
+    uint32_t add(const MeshView& mesh);
+
+    // Read by every draw() until changed; the array must outlive them.
+    void setInstances(const InstanceData* instances, size_t count);
+    void setCamera(const CameraBlock& camera) { m_camera = camera; }
+    void setLighting(const LightingBlock& lighting) { m_lighting = lighting; }
+    // Any of them may be null, which samples like an incomplete GL texture.
+    void setTextures(const SoftwareTexture* albedo, const SoftwareTexture* normalMap, const SoftwareTexture* sky);
+    // The sample.frag permutation to shade with, as SHADER_* flags
+    // (ShaderFeaturesFor the material drawn).
+    void setFeatures(uint32_t features) { m_features = features; }
+
+    // Clears and draws a whole frame: the draws, then the sky behind them.
+    void draw(const std::vector<MeshDraw>& draws);
+
+    // The last frame as RGBA8, rows top to bottom.
+    const unsigned char* pixels() const { return m_pixels.data(); }
+    const SoftwareFrameStats& stats() const { return m_stats; }
+    unsigned threads() const { return m_pool.size(); }
+
+private:
+    // sample.vert's outputs.
+    struct Varyings {
+        glm::vec4 position; // clip space
+        glm::vec3 fragPos;
+        glm::vec2 texCoord;
+        glm::mat3 tbn;
+    };
+
+    // A triangle ready to rasterize. Edge i is >= 0 inside the triangle
+    // (> 0 unless the edge owns the pixels on it, see the fill rule) and is
+    // the barycentric weight of vertex i times twice the area.
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3]; // edge i = A x + B y + C at pixel centres
+        float depthA, depthB, depthC;       // window depth, the same way
+        float minDepth;
+        float invW[3];
+        int minX, minY, maxX, maxY;         // pixel bounds, inclusive
+        uint8_t ownsEdge;                   // bit i: edge i keeps pixels exactly on it
+        const Varyings* vertex[3];
+
+        // Perspective-correct weights of the vertices at a point, and the
+        // texture coordinate they give.
+        glm::vec3 weights(float x, float y) const;
+        glm::vec2 texCoord(const glm::vec3& w) const;
+    };
+
+    struct ObjectVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 tangent;
+        glm::vec2 uv;
+        float handedness;
+    };
+
+    struct Mesh {
+        std::vector<ObjectVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // One instance of a mesh in this frame, with where its varyings start.
+    struct Instance {
+        uint32_t mesh;
+        uint32_t instance;
+        size_t firstVertex;
+        size_t firstTriangle;
+    };
+
+    // Triangles set up by one job and their bins; a job's triangles are
+    // contiguous in draw order, so walking jobs in order keeps it.
+    struct SetupJob {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins; // per tile, into triangles
+        std::deque<Varyings> clipped;            // vertices made by clipping
+    };
+
+    struct Tile {
+        int x = 0, y = 0; // top left pixel
+        std::vector<float> depth;
+        std::vector<uint32_t> triangle; // packed (job, index), NO_TRIANGLE if none
+        std::vector<float> blockMaxDepth;
+        size_t blocksSkipped = 0;
+        size_t pixelsShaded = 0;
+    };
+
+    void shadeVertices(size_t begin, size_t end);
+    void setupTriangles(size_t begin, size_t end, SetupJob& job);
+    void emitTriangle(const Varyings* a, const Varyings* b, const Varyings* c, SetupJob& job);
+    void rasterizeTile(Tile& tile);
+    void shadeTile(Tile& tile);
+    size_t instanceAt(size_t index, bool triangles) const;
+
+    ThreadPool m_pool;
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    std::vector<Tile> m_tiles;
+    std::vector<unsigned char> m_pixels;
+
+    std::vector<Mesh> m_meshes;
+    const InstanceData* m_instances = nullptr;
+    size_t m_instanceCount = 0;
+    CameraBlock m_camera = {};
+    LightingBlock m_lighting = {};
+    const SoftwareTexture* m_albedo = nullptr;
+    const SoftwareTexture* m_normalMap = nullptr;
+    const SoftwareTexture* m_sky = nullptr;
+    uint32_t m_features = SHADER_POINT_LIGHT | SHADER_NORMAL_MAP;
+
+    // Rebuilt every draw(); kept to reuse their memory.
+    glm::mat4 m_viewProjection = glm::mat4(1.f);
+    std::vector<Instance> m_frameInstances;
+    std::vector<Varyings> m_varyings;
+    std::vector<SetupJob> m_jobs;
+    size_t m_jobCount = 0; // jobs of m_jobs used this frame
+    SoftwareFrameStats m_stats;
+};
@@ -0,0 +1,118 @@
+#include "SoftwareTexture.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+int Wrap(int i, int size, MipWrap wrap)
+{
+    if (wrap == MipWrap::Clamp)
+        return std::clamp(i, 0, size - 1);
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+} // namespace
+
+bool SoftwareTexture::decode(const CompressedTexture& texture)
+{
+    m_levels.clear();
+    m_levelCount = texture.levels();
+    m_faceCount = texture.faces();
+    if (!texture)
+        return false;
+
+    m_levels.resize((size_t)m_faceCount * m_levelCount);
+    for (int face = 0; face < m_faceCount; face++) {
+        for (int l = 0; l < m_levelCount; l++) {
+            Level& out = m_levels[(size_t)face * m_levelCount + l];
+            out.width = texture.levelWidth(l);
+            out.height = texture.levelHeight(l);
+            out.rgba.resize((size_t)out.width * out.height * 4);
+            if (!DecompressImage(texture.levelData(face, l), out.width, out.height, texture.format(),
+                                 out.rgba.data())) {
+                m_levels.clear();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+glm::vec4 SoftwareTexture::texel(const Level& level, int x, int y) const
+{
+    const unsigned char* p = &level.rgba[((size_t)y * level.width + x) * 4];
+    return glm::vec4(p[0], p[1], p[2], p[3]) * (1.f / 255.f);
+}
+
+glm::vec4 SoftwareTexture::bilinear(const Level& level, float u, float v, MipWrap wrapS, MipWrap wrapT) const
+{
+    float x = u * level.width - 0.5f;
+    float y = v * level.height - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float ax = x - fx, ay = y - fy;
+    int x0 = Wrap((int)fx, level.width, wrapS), x1 = Wrap((int)fx + 1, level.width, wrapS);
+    int y0 = Wrap((int)fy, level.height, wrapT), y1 = Wrap((int)fy + 1, level.height, wrapT);
+    glm::vec4 top = glm::mix(texel(level, x0, y0), texel(level, x1, y0), ax);
+    glm::vec4 bottom = glm::mix(texel(level, x0, y1), texel(level, x1, y1), ax);
+    return glm::mix(top, bottom, ay);
+}
+
+glm::vec4 SoftwareTexture::sample(const glm::vec2& uv, const glm::vec2& uvDx, const glm::vec2& uvDy) const
+{
+    // An incomplete texture samples as opaque black in GL.
+    if (m_levels.empty())
+        return glm::vec4(0.f, 0.f, 0.f, 1.f);
+
+    glm::vec2 size((float)width(), (float)height());
+    float rho = std::max(glm::length(uvDx * size), glm::length(uvDy * size));
+    float lambda = rho > 0.f ? std::log2(rho) : 0.f;
+    if (lambda <= 0.f || m_levelCount == 1)
+        return bilinear(level(0, 0), uv.x, uv.y, m_wrapS, m_wrapT);
+
+    // GL_NEAREST_MIPMAP_LINEAR: the nearest texel of the two levels around
+    // lambda, blended.
+    auto nearest = [&](int l) {
+        const Level& lv = level(0, l);
+        return texel(lv, Wrap((int)std::floor(uv.x * lv.width), lv.width, m_wrapS),
+                     Wrap((int)std::floor(uv.y * lv.height), lv.height, m_wrapT));
+    };
+    float d = std::min(lambda, (float)(m_levelCount - 1));
+    int l0 = (int)d;
+    if (l0 >= m_levelCount - 1)
+        return nearest(m_levelCount - 1);
+    return glm::mix(nearest(l0), nearest(l0 + 1), d - l0);
+}
+
+glm::vec4 SoftwareTexture::sampleCube(const glm::vec3& direction) const
+{
+    if (m_levels.empty() || m_faceCount != 6)
+        return glm::vec4(0.f, 0.f, 0.f, 1.f);
+
+    // Face selection and (s, t) as in the GL spec's cube map table.
+    glm::vec3 a = glm::abs(direction);
+    int face;
+    float sc, tc, ma;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = direction.x >= 0.f ? 0 : 1;
+        sc = direction.x >= 0.f ? -direction.z : direction.z;
+        tc = -direction.y;
+        ma = a.x;
+    }
+    else if (a.y >= a.z) {
+        face = direction.y >= 0.f ? 2 : 3;
+        sc = direction.x;
+        tc = direction.y >= 0.f ? direction.z : -direction.z;
+        ma = a.y;
+    }
+    else {
+        face = direction.z >= 0.f ? 4 : 5;
+        sc = direction.z >= 0.f ? direction.x : -direction.x;
+        tc = -direction.y;
+        ma = a.z;
+    }
+    if (ma <= 0.f)
+        return glm::vec4(0.f, 0.f, 0.f, 1.f);
+    return bilinear(level(face, 0), 0.5f * (sc / ma + 1.f), 0.5f * (tc / ma + 1.f), MipWrap::Clamp, MipWrap::Clamp);
+}
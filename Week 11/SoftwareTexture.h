@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "CompressedTexture.h"
+#include "MipGenerator.h"
+
+// A cooked texture decoded back to RGBA8 so it can be sampled on the CPU,
+// every level of every face. Sampling follows what the GL path gets from
+// the same .dds: 2D textures wrap as set with setWrap (GL_REPEAT or
+// GL_CLAMP_TO_EDGE) and use the GL default filters (bilinear when
+// magnified, GL_NEAREST_MIPMAP_LINEAR when minified); cube maps are sampled
+// bilinearly from their top level, clamped to each face's edge, as the
+// skybox is set up in Main.cpp. Components come back in [0, 1], BC5 as
+// (r, g, 0, 1) like an RG texture.
+class SoftwareTexture {
+public:
+    // Returns false for formats DecompressImage cannot decode (BC7).
+    bool decode(const CompressedTexture& texture);
+
+    int width() const { return m_levels.empty() ? 0 : m_levels[0].width; }
+    int height() const { return m_levels.empty() ? 0 : m_levels[0].height; }
+    int levels() const { return m_levelCount; }
+    int faces() const { return m_faceCount; }
+
+    // How sample() wraps u and v. Both repeat until set.
+    void setWrap(MipWrap wrapS, MipWrap wrapT) { m_wrapS = wrapS; m_wrapT = wrapT; }
+
+    // texture(sampler2D, uv). The level comes from the UV derivatives
+    // across one pixel in x and in y, as the GPU takes them.
+    glm::vec4 sample(const glm::vec2& uv, const glm::vec2& uvDx, const glm::vec2& uvDy) const;
+
+    // texture(samplerCube, direction).
+    glm::vec4 sampleCube(const glm::vec3& direction) const;
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> rgba;
+    };
+
+    const Level& level(int face, int level) const { return m_levels[(size_t)face * m_levelCount + level]; }
+    glm::vec4 texel(const Level& level, int x, int y) const;
+    glm::vec4 bilinear(const Level& level, float u, float v, MipWrap wrapS, MipWrap wrapT) const;
+
+    std::vector<Level> m_levels; // face by face, levels 0..m_levelCount-1 each
+    int m_levelCount = 0;
+    int m_faceCount = 0;
+    MipWrap m_wrapS = MipWrap::Repeat;
+    MipWrap m_wrapT = MipWrap::Repeat;
+};
@@ -0,0 +1,85 @@
+#include "Stats.h"
+
+#include <cstdio>
+
+namespace {
+
+const char* TIMER_NAMES[(int)StatTimer::Count] = { "frame", "uniforms", "draw calls", "texture uploads", "culling" };
+const char* COUNTER_NAMES[(int)StatCounter::Count] = {
+    "uniform uploads", "uniforms skipped", "uniform block bytes", "texture upload bytes",
+    "texture cache hits", "texture cache misses", "texture evictions", "texture mips dropped",
+    "skybox samples", "draw calls", "draw commands", "objects culled", "raster triangles",
+    "raster block skips", "raster pixels shaded", "state changes", "state changes skipped"
+};
+
+} // namespace
+
+const char* StatName(StatTimer timer)
+{
+    return TIMER_NAMES[(int)timer];
+}
+
+const char* StatName(StatCounter counter)
+{
+    return COUNTER_NAMES[(int)counter];
+}
+
+FrameStats& GetFrameStats()
+{
+    static FrameStats stats;
+    return stats;
+}
+
+void FrameStats::beginFrame()
+{
+    m_frameStart = Clock::now();
+}
+
+void FrameStats::endFrame()
+{
+    std::chrono::duration<double> elapsed = Clock::now() - m_frameStart;
+    m_frameTimes[(int)StatTimer::Frame] += elapsed.count();
+
+    for (int i = 0; i < (int)StatTimer::Count; i++) {
+        if (m_recording)
+            m_recordedTimes[i].push_back(m_frameTimes[i]);
+        m_totalTimes[i] += m_frameTimes[i];
+        m_frameTimes[i] = 0.0;
+    }
+    for (int i = 0; i < (int)StatCounter::Count; i++) {
+        if (m_recording)
+            m_recordedCounts[i] += m_frameCounts[i];
+        m_totalCounts[i] += m_frameCounts[i];
+        m_frameCounts[i] = 0;
+    }
+    m_frames++;
+
+    std::chrono::duration<double> sinceReport = Clock::now() - m_reportStart;
+    if (m_reportInterval > 0.0 && sinceReport.count() >= m_reportInterval)
+        report();
+}
+
+void FrameStats::report()
+{
+    std::printf("%llu frames:", (unsigned long long)m_frames);
+    for (int i = 0; i < (int)StatTimer::Count; i++)
+        std::printf(" %s %.3f ms", TIMER_NAMES[i], m_totalTimes[i] * 1000.0 / m_frames);
+    for (int i = 0; i < (int)StatCounter::Count; i++)
+        std::printf(", %s %.1f", COUNTER_NAMES[i], (double)m_totalCounts[i] / m_frames);
+    std::printf(" (per frame)\n");
+
+    for (double& t : m_totalTimes)
+        t = 0.0;
+    for (uint64_t& c : m_totalCounts)
+        c = 0;
+    m_frames = 0;
+    m_reportStart = Clock::now();
+}
+
+void FrameStats::clearRecording()
+{
+    for (std::vector<double>& times : m_recordedTimes)
+        times.clear();
+    for (uint64_t& count : m_recordedCounts)
+        count = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+enum class StatTimer {
+    Frame,          // CPU time from beginFrame to endFrame
+    Uniforms,       // CPU time spent setting uniforms
+    Draw,           // CPU time spent issuing draw calls
+    TextureUploads, // CPU time spent issuing streamed texture uploads
+    Culling,        // CPU time spent frustum culling
+    Count
+};
+
+enum class StatCounter {
+    UniformUploads,     // glProgramUniform* calls issued
+    UniformsSkipped,    // setter calls dropped because the value was unchanged
+    UniformBlockBytes,  // bytes written to the uniform ring
+    TextureUploadBytes, // bytes of texture data uploaded from the streaming ring
+    TextureCacheHits,   // texture requests served by an already resident texture
+    TextureCacheMisses, // texture requests that had to (re)stream the texture
+    TextureEvictions,   // textures deleted to get back under the texture budget
+    TextureMipsDropped, // top mip levels dropped to get back under the budget
+    SkyboxSamples,      // samples the skybox pass shaded (read back a few frames late)
+    DrawCalls,          // glDraw* calls issued
+    DrawCommands,       // objects drawn through the mesh arena, one command each
+    ObjectsCulled,      // objects left out of the frame by frustum culling
+    RasterTriangles,    // triangles the software renderer set up and binned
+    RasterBlockSkips,   // software renderer pixel blocks a triangle was wholly behind
+    RasterPixelsShaded, // pixels the software renderer ran sample.frag for
+    StateChanges,       // GL state calls issued through RenderState
+    StateChangesSkipped, // RenderState calls dropped because the state was already set
+    Count
+};
+
+// Per-frame CPU timings and counters. Time spent inside GL calls on the
+// render thread is where driver overhead shows up, so the timers wrap the
+// calls themselves. Averages are printed once every reportInterval seconds.
+class FrameStats {
+public:
+    explicit FrameStats(double reportInterval = 1.0) : m_reportInterval(reportInterval) {}
+
+    void beginFrame();
+    void endFrame();
+
+    void addTime(StatTimer timer, double seconds) { m_frameTimes[(int)timer] += seconds; }
+    void add(StatCounter counter, uint64_t n = 1) { m_frameCounts[(int)counter] += n; }
+
+    // 0 turns the periodic report off.
+    void setReportInterval(double seconds) { m_reportInterval = seconds; }
+
+    // While recording, every frame's timers are kept (for percentiles) and
+    // counters are summed until clearRecording.
+    void setRecording(bool recording) { m_recording = recording; }
+    void clearRecording();
+    const std::vector<double>& recorded(StatTimer timer) const { return m_recordedTimes[(int)timer]; }
+    uint64_t recordedTotal(StatCounter counter) const { return m_recordedCounts[(int)counter]; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void report();
+
+    double m_reportInterval;
+    Clock::time_point m_frameStart;
+    Clock::time_point m_reportStart = Clock::now();
+    uint64_t m_frames = 0;
+
+    double m_frameTimes[(int)StatTimer::Count] = {};
+    uint64_t m_frameCounts[(int)StatCounter::Count] = {};
+    double m_totalTimes[(int)StatTimer::Count] = {};
+    uint64_t m_totalCounts[(int)StatCounter::Count] = {};
+
+    bool m_recording = false;
+    std::vector<double> m_recordedTimes[(int)StatTimer::Count];
+    uint64_t m_recordedCounts[(int)StatCounter::Count] = {};
+};
+
+const char* StatName(StatTimer timer);
+const char* StatName(StatCounter counter);
+
+// The render thread's stats.
+FrameStats& GetFrameStats();
+
+// Adds the time between construction and destruction to a timer.
+class ScopedStatTimer {
+public:
+    explicit ScopedStatTimer(StatTimer timer) : m_timer(timer), m_start(std::chrono::steady_clock::now()) {}
+    ~ScopedStatTimer()
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        GetFrameStats().addTime(m_timer, elapsed.count());
+    }
+
+    ScopedStatTimer(const ScopedStatTimer&) = delete;
+    ScopedStatTimer& operator=(const ScopedStatTimer&) = delete;
+
+private:
+    StatTimer m_timer;
+    std::chrono::steady_clock::time_point m_start;
+};
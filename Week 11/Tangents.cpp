@@ -0,0 +1,256 @@
+#include "Tangents.h"
+
+#include <cmath>
+
+#include "Parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENTS_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Per-face tangent and bitangent, stored one component per array so four
+// faces can be written with one SSE store.
+struct FaceFrames {
+    std::vector<float> tx, ty, tz, bx, by, bz;
+};
+
+const GLfloat* VertexAt(const MeshData& mesh, GLuint index)
+{
+    return &mesh.vertices[(size_t)index * FLOATS_PER_VERTEX];
+}
+
+void FaceFrameScalar(const MeshData& mesh, size_t face, FaceFrames& out)
+{
+    const GLfloat* v0 = VertexAt(mesh, mesh.indices[face * 3]);
+    const GLfloat* v1 = VertexAt(mesh, mesh.indices[face * 3 + 1]);
+    const GLfloat* v2 = VertexAt(mesh, mesh.indices[face * 3 + 2]);
+
+    glm::vec3 p0(v0[POSITION_OFFSET], v0[POSITION_OFFSET + 1], v0[POSITION_OFFSET + 2]);
+    glm::vec3 deltaPos1 = glm::vec3(v1[POSITION_OFFSET], v1[POSITION_OFFSET + 1], v1[POSITION_OFFSET + 2]) - p0;
+    glm::vec3 deltaPos2 = glm::vec3(v2[POSITION_OFFSET], v2[POSITION_OFFSET + 1], v2[POSITION_OFFSET + 2]) - p0;
+
+    glm::vec2 uv0(v0[UV_OFFSET], v0[UV_OFFSET + 1]);
+    glm::vec2 deltaUV1 = glm::vec2(v1[UV_OFFSET], v1[UV_OFFSET + 1]) - uv0;
+    glm::vec2 deltaUV2 = glm::vec2(v2[UV_OFFSET], v2[UV_OFFSET + 1]) - uv0;
+
+    float det = (deltaUV1.x * deltaUV2.y) - (deltaUV1.y * deltaUV2.x);
+    float r = det != 0.f ? 1.0f / det : 0.f;
+
+    glm::vec3 tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+    glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * r;
+
+    out.tx[face] = tangent.x;
+    out.ty[face] = tangent.y;
+    out.tz[face] = tangent.z;
+    out.bx[face] = bitangent.x;
+    out.by[face] = bitangent.y;
+    out.bz[face] = bitangent.z;
+}
+
+#ifdef TANGENTS_SSE
+
+// Same as FaceFrameScalar for faces [face, face + 4).
+void FaceFrameSse(const MeshData& mesh, size_t face, FaceFrames& out)
+{
+    alignas(16) float lanes[15][4];
+    for (int l = 0; l < 4; l++) {
+        const GLfloat* v[3];
+        for (int k = 0; k < 3; k++)
+            v[k] = VertexAt(mesh, mesh.indices[(face + l) * 3 + k]);
+        for (int k = 0; k < 3; k++) {
+            lanes[k * 5 + 0][l] = v[k][POSITION_OFFSET];
+            lanes[k * 5 + 1][l] = v[k][POSITION_OFFSET + 1];
+            lanes[k * 5 + 2][l] = v[k][POSITION_OFFSET + 2];
+            lanes[k * 5 + 3][l] = v[k][UV_OFFSET];
+            lanes[k * 5 + 4][l] = v[k][UV_OFFSET + 1];
+        }
+    }
+
+    __m128 x0 = _mm_load_ps(lanes[0]), y0 = _mm_load_ps(lanes[1]), z0 = _mm_load_ps(lanes[2]);
+    __m128 u0 = _mm_load_ps(lanes[3]), w0 = _mm_load_ps(lanes[4]);
+
+    __m128 e1x = _mm_sub_ps(_mm_load_ps(lanes[5]), x0);
+    __m128 e1y = _mm_sub_ps(_mm_load_ps(lanes[6]), y0);
+    __m128 e1z = _mm_sub_ps(_mm_load_ps(lanes[7]), z0);
+    __m128 du1 = _mm_sub_ps(_mm_load_ps(lanes[8]), u0);
+    __m128 dv1 = _mm_sub_ps(_mm_load_ps(lanes[9]), w0);
+
+    __m128 e2x = _mm_sub_ps(_mm_load_ps(lanes[10]), x0);
+    __m128 e2y = _mm_sub_ps(_mm_load_ps(lanes[11]), y0);
+    __m128 e2z = _mm_sub_ps(_mm_load_ps(lanes[12]), z0);
+    __m128 du2 = _mm_sub_ps(_mm_load_ps(lanes[13]), u0);
+    __m128 dv2 = _mm_sub_ps(_mm_load_ps(lanes[14]), w0);
+
+    __m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+    __m128 valid = _mm_cmpneq_ps(det, _mm_setzero_ps());
+    __m128 r = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.f), det), valid);
+
+    _mm_storeu_ps(&out.tx[face], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1x, dv2), _mm_mul_ps(e2x, dv1)), r));
+    _mm_storeu_ps(&out.ty[face], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1y, dv2), _mm_mul_ps(e2y, dv1)), r));
+    _mm_storeu_ps(&out.tz[face], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1z, dv2), _mm_mul_ps(e2z, dv1)), r));
+    _mm_storeu_ps(&out.bx[face], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2x, du1), _mm_mul_ps(e1x, du2)), r));
+    _mm_storeu_ps(&out.by[face], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2y, du1), _mm_mul_ps(e1y, du2)), r));
+    _mm_storeu_ps(&out.bz[face], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2z, du1), _mm_mul_ps(e1z, du2)), r));
+}
+
+#endif
+
+// Any unit vector perpendicular to n, for vertices whose UVs give no usable
+// tangent direction.
+glm::vec3 AnyPerpendicular(const glm::vec3& n)
+{
+    glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    glm::vec3 t = glm::cross(n, axis);
+    float len = glm::length(t);
+    return len > 0.f ? t / len : glm::vec3(1.f, 0.f, 0.f);
+}
+
+void WriteTangentScalar(GLfloat* v, glm::vec3 t, const glm::vec3& b)
+{
+    glm::vec3 n(v[NORMAL_OFFSET], v[NORMAL_OFFSET + 1], v[NORMAL_OFFSET + 2]);
+    float nLen = glm::length(n);
+    n = nLen > 0.f ? n / nLen : glm::vec3(0.f, 0.f, 1.f);
+
+    t -= n * glm::dot(n, t);
+    float tLen = glm::length(t);
+    t = tLen > 1e-12f ? t / tLen : AnyPerpendicular(n);
+
+    v[TANGENT_OFFSET] = t.x;
+    v[TANGENT_OFFSET + 1] = t.y;
+    v[TANGENT_OFFSET + 2] = t.z;
+    v[TANGENT_OFFSET + 3] = glm::dot(glm::cross(n, t), b) < 0.f ? -1.f : 1.f;
+}
+
+#ifdef TANGENTS_SSE
+
+inline __m128 Dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+// Orthogonalizes four vertices at once. Lanes whose normal or tangent is
+// degenerate are redone with WriteTangentScalar.
+void WriteTangentsSse(GLfloat* const v[4], const float t[3][4], const float b[3][4])
+{
+    alignas(16) float n[3][4];
+    for (int l = 0; l < 4; l++) {
+        for (int c = 0; c < 3; c++)
+            n[c][l] = v[l][NORMAL_OFFSET + c];
+    }
+
+    __m128 nx = _mm_load_ps(n[0]), ny = _mm_load_ps(n[1]), nz = _mm_load_ps(n[2]);
+    __m128 tx = _mm_loadu_ps(t[0]), ty = _mm_loadu_ps(t[1]), tz = _mm_loadu_ps(t[2]);
+    __m128 bx = _mm_loadu_ps(b[0]), by = _mm_loadu_ps(b[1]), bz = _mm_loadu_ps(b[2]);
+    const __m128 eps = _mm_set1_ps(1e-24f);
+
+    __m128 nLen2 = Dot3(nx, ny, nz, nx, ny, nz);
+    __m128 nInv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(nLen2, eps)));
+    nx = _mm_mul_ps(nx, nInv);
+    ny = _mm_mul_ps(ny, nInv);
+    nz = _mm_mul_ps(nz, nInv);
+
+    // Gram-Schmidt: t -= n * dot(n, t), then normalize.
+    __m128 d = Dot3(nx, ny, nz, tx, ty, tz);
+    tx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+    ty = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+    tz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+    __m128 tLen2 = Dot3(tx, ty, tz, tx, ty, tz);
+    __m128 tInv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(tLen2, eps)));
+    tx = _mm_mul_ps(tx, tInv);
+    ty = _mm_mul_ps(ty, tInv);
+    tz = _mm_mul_ps(tz, tInv);
+
+    // Handedness: sign of dot(cross(n, t), b).
+    __m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+    __m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+    __m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+    __m128 negative = _mm_cmplt_ps(Dot3(cx, cy, cz, bx, by, bz), _mm_setzero_ps());
+    __m128 w = _mm_or_ps(_mm_and_ps(negative, _mm_set1_ps(-1.f)), _mm_andnot_ps(negative, _mm_set1_ps(1.f)));
+
+    alignas(16) float out[4][4];
+    _mm_store_ps(out[0], tx);
+    _mm_store_ps(out[1], ty);
+    _mm_store_ps(out[2], tz);
+    _mm_store_ps(out[3], w);
+
+    int degenerate = _mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(nLen2, eps), _mm_cmple_ps(tLen2, eps)));
+    for (int l = 0; l < 4; l++) {
+        if (degenerate & (1 << l)) {
+            WriteTangentScalar(v[l], glm::vec3(t[0][l], t[1][l], t[2][l]), glm::vec3(b[0][l], b[1][l], b[2][l]));
+            continue;
+        }
+        for (int c = 0; c < 4; c++)
+            v[l][TANGENT_OFFSET + c] = out[c][l];
+    }
+}
+
+#endif
+
+} // namespace
+
+void GenerateTangents(MeshData& mesh, unsigned threads)
+{
+    size_t vertexCount = mesh.vertices.size() / FLOATS_PER_VERTEX;
+    size_t faceCount = mesh.indices.size() / 3;
+
+    FaceFrames frames;
+    for (std::vector<float>* a : { &frames.tx, &frames.ty, &frames.tz, &frames.bx, &frames.by, &frames.bz })
+        a->resize(faceCount);
+
+    ParallelFor(faceCount, [&](size_t begin, size_t end, unsigned) {
+        size_t face = begin;
+#ifdef TANGENTS_SSE
+        for (; face + 4 <= end; face += 4)
+            FaceFrameSse(mesh, face, frames);
+#endif
+        for (; face < end; face++)
+            FaceFrameScalar(mesh, face, frames);
+    }, threads);
+
+    // Faces around each vertex, so every vertex can gather its own sum
+    // without threads writing to shared vertices.
+    std::vector<GLuint> offsets(vertexCount + 1, 0);
+    for (GLuint index : mesh.indices)
+        offsets[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<GLuint> faces(mesh.indices.size());
+    std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+        faces[fill[mesh.indices[i]]++] = (GLuint)(i / 3);
+
+    ParallelFor(vertexCount, [&](size_t begin, size_t end, unsigned) {
+        size_t v = begin;
+#ifdef TANGENTS_SSE
+        for (; v + 4 <= end; v += 4) {
+            GLfloat* out[4];
+            float t[3][4] = {}, b[3][4] = {};
+            for (int l = 0; l < 4; l++) {
+                out[l] = &mesh.vertices[(v + l) * FLOATS_PER_VERTEX];
+                for (GLuint j = offsets[v + l]; j < offsets[v + l + 1]; j++) {
+                    GLuint f = faces[j];
+                    t[0][l] += frames.tx[f];
+                    t[1][l] += frames.ty[f];
+                    t[2][l] += frames.tz[f];
+                    b[0][l] += frames.bx[f];
+                    b[1][l] += frames.by[f];
+                    b[2][l] += frames.bz[f];
+                }
+            }
+            WriteTangentsSse(out, t, b);
+        }
+#endif
+        for (; v < end; v++) {
+            glm::vec3 t(0.f), b(0.f);
+            for (GLuint j = offsets[v]; j < offsets[v + 1]; j++) {
+                GLuint f = faces[j];
+                t += glm::vec3(frames.tx[f], frames.ty[f], frames.tz[f]);
+                b += glm::vec3(frames.bx[f], frames.by[f], frames.bz[f]);
+            }
+            WriteTangentScalar(&mesh.vertices[v * FLOATS_PER_VERTEX], t, b);
+        }
+    }, threads);
+}
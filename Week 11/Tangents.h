@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Mesh.h"
+
+// Fills the vec4 tangent of every vertex in a welded mesh (32-bit indices,
+// before CompactIndices). Per-face tangents and bitangents are accumulated
+// into the vertices they touch; the summed tangent is then Gram-Schmidt
+// orthogonalized against the vertex normal, and w holds the handedness so
+// the shader can rebuild the bitangent as cross(N, T) * w.
+//
+// Faces are processed in parallel chunks and four at a time with SSE when
+// it is available; threads = 0 uses every hardware thread.
+void GenerateTangents(MeshData& mesh, unsigned threads = 0);
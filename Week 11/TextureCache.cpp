@@ -0,0 +1,307 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+
+#include "RenderState.h"
+#include "Stats.h"
+
+namespace {
+
+// FNV-1a, 64 bit.
+uint64_t PathHash(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : path)
+        hash = (hash ^ (uint8_t)c) * 1099511628211ull;
+    return hash;
+}
+
+} // namespace
+
+TextureCache::~TextureCache()
+{
+    clear();
+}
+
+TextureHandle TextureCache::acquire(const SceneTexture& texture)
+{
+    uint64_t hash = PathHash(texture.cookedPath);
+    auto it = m_slotsByHash.find(hash);
+    if (it != m_slotsByHash.end() && m_entries[it->second].source.cookedPath == texture.cookedPath) {
+        Entry& entry = m_entries[it->second];
+        entry.refs++;
+        entry.lastUsed = m_frame;
+        // Unreferenced textures are dropped entirely when evicted, so a
+        // cached entry is either resident or is brought back by get().
+        if (entry.texture) {
+            m_stats.hits++;
+            GetFrameStats().add(StatCounter::TextureCacheHits);
+        }
+        return { it->second + 1 };
+    }
+
+    uint32_t slot;
+    if (!m_freeSlots.empty()) {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else {
+        slot = (uint32_t)m_entries.size();
+        m_entries.emplace_back();
+    }
+    // A colliding path still gets a texture; it is just not shared.
+    if (it == m_slotsByHash.end())
+        m_slotsByHash[hash] = slot;
+
+    Entry& entry = m_entries[slot];
+    entry.hash = hash;
+    entry.source = texture;
+    entry.target = texture.sources.size() == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    entry.refs = 1;
+    entry.lastUsed = m_frame;
+    glGenTextures(1, &entry.texture);
+    startStreaming(slot, entry.texture);
+    m_stats.misses++;
+    GetFrameStats().add(StatCounter::TextureCacheMisses);
+    return { slot + 1 };
+}
+
+void TextureCache::release(TextureHandle handle)
+{
+    Entry* entry = find(handle);
+    if (entry && entry->refs > 0)
+        entry->refs--;
+}
+
+GLuint TextureCache::get(TextureHandle handle)
+{
+    Entry* entry = find(handle);
+    if (!entry)
+        return 0;
+    entry->lastUsed = m_frame;
+
+    uint32_t slot = handle.id - 1;
+    if (!entry->texture) {
+        glGenTextures(1, &entry->texture);
+        applySampler(*entry, entry->texture);
+        startStreaming(slot, entry->texture);
+        m_stats.misses++;
+        GetFrameStats().add(StatCounter::TextureCacheMisses);
+    }
+    else if (entry->firstLevel > 0 && !entry->restoring && m_residentBytes + fullBytes(*entry) <= m_budget) {
+        // Stream a full copy next to the reduced one and switch over once
+        // it is complete, so the texture never goes blank.
+        saveSampler(*entry);
+        glGenTextures(1, &entry->restoring);
+        applySampler(*entry, entry->restoring);
+        startStreaming(slot, entry->restoring);
+        m_residentBytes += fullBytes(*entry);
+    }
+    return entry->texture;
+}
+
+void TextureCache::update()
+{
+    m_residentBytes = residentBytes();
+    if (m_residentBytes > m_budget) {
+        // Textures used this frame are left alone; freeing them would only
+        // stream them straight back in.
+        std::vector<uint32_t> candidates;
+        for (uint32_t slot = 0; slot < (uint32_t)m_entries.size(); slot++) {
+            const Entry& entry = m_entries[slot];
+            if (entry.used() && entry.texture && entry.lastUsed < m_frame)
+                candidates.push_back(slot);
+        }
+        std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+            return m_entries[a].lastUsed < m_entries[b].lastUsed;
+        });
+
+        // Unreferenced textures go first, then referenced ones lose their
+        // top levels, and only then are referenced textures evicted.
+        for (int pass = 0; pass < 3 && m_residentBytes > m_budget; pass++) {
+            for (uint32_t slot : candidates) {
+                if (m_residentBytes <= m_budget)
+                    break;
+                Entry& entry = m_entries[slot];
+                if (!entry.used() || !entry.texture || (pass == 0) != (entry.refs == 0))
+                    continue;
+                if (pass == 1) {
+                    while (m_residentBytes > m_budget && dropTopLevel(entry)) {}
+                    continue;
+                }
+                m_residentBytes -= entryBytes(entry);
+                evict(entry);
+                if (entry.refs == 0) {
+                    auto it = m_slotsByHash.find(entry.hash);
+                    if (it != m_slotsByHash.end() && it->second == slot)
+                        m_slotsByHash.erase(it);
+                    entry = Entry();
+                    m_freeSlots.push_back(slot);
+                }
+            }
+        }
+    }
+    m_frame++;
+}
+
+void TextureCache::clear()
+{
+    for (Entry& entry : m_entries) {
+        for (GLuint texture : { entry.texture, entry.restoring }) {
+            if (texture) {
+                m_streamer.cancel(texture);
+                glDeleteTextures(1, &texture);
+                GetRenderState().deletedTexture(texture);
+            }
+        }
+    }
+    m_entries.clear();
+    m_freeSlots.clear();
+    m_slotsByHash.clear();
+    m_residentBytes = 0;
+}
+
+size_t TextureCache::residentBytes() const
+{
+    size_t bytes = 0;
+    for (const Entry& entry : m_entries)
+        bytes += entryBytes(entry);
+    return bytes;
+}
+
+TextureCache::Entry* TextureCache::find(TextureHandle handle)
+{
+    if (!handle || handle.id > m_entries.size() || !m_entries[handle.id - 1].used())
+        return nullptr;
+    return &m_entries[handle.id - 1];
+}
+
+void TextureCache::startStreaming(uint32_t slot, GLuint texture)
+{
+    Entry& entry = m_entries[slot];
+    if (texture == entry.texture) {
+        entry.firstLevel = 0;
+        entry.complete = false;
+    }
+    m_streamer.stream(texture, entry.target, entry.source.sources, entry.source.cookedPath, entry.source.settings,
+                      [this, slot, texture](const StreamProgress& progress) { onProgress(slot, texture, progress); });
+}
+
+void TextureCache::onProgress(uint32_t slot, GLuint texture, const StreamProgress& progress)
+{
+    Entry& entry = m_entries[slot];
+    if (entry.levelBytes.empty()) {
+        entry.format = progress.format;
+        entry.width = progress.width;
+        entry.height = progress.height;
+        entry.faces = progress.faces;
+        for (int level = 0; level < progress.levels; level++) {
+            int width = std::max(1, progress.width >> level);
+            int height = std::max(1, progress.height >> level);
+            entry.levelBytes.push_back(CompressedSize(progress.format, width, height) * progress.faces);
+        }
+    }
+    if (progress.baseLevel != 0)
+        return;
+
+    if (texture == entry.restoring) {
+        glDeleteTextures(1, &entry.texture);
+        GetRenderState().deletedTexture(entry.texture);
+        entry.texture = entry.restoring;
+        entry.restoring = 0;
+        entry.firstLevel = 0;
+    }
+    entry.complete = true;
+}
+
+size_t TextureCache::entryBytes(const Entry& entry) const
+{
+    size_t bytes = entry.restoring ? fullBytes(entry) : 0;
+    if (entry.texture) {
+        for (size_t level = entry.firstLevel; level < entry.levelBytes.size(); level++)
+            bytes += entry.levelBytes[level];
+    }
+    return bytes;
+}
+
+size_t TextureCache::fullBytes(const Entry& entry) const
+{
+    size_t bytes = 0;
+    for (size_t level : entry.levelBytes)
+        bytes += level;
+    return bytes;
+}
+
+bool TextureCache::dropTopLevel(Entry& entry)
+{
+    // Needs the complete chain to copy from, and glCopyImageSubData.
+    if (!entry.complete || entry.restoring || !(GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_copy_image))
+        return false;
+    int first = entry.firstLevel + 1;
+    int levels = (int)entry.levelBytes.size() - first;
+    int width = std::max(1, entry.width >> first);
+    int height = std::max(1, entry.height >> first);
+    if (levels < 1 || std::max(width, height) < MIN_RESIDENT_SIZE)
+        return false;
+
+    saveSampler(entry);
+    GLuint smaller;
+    glGenTextures(1, &smaller);
+    GetRenderState().bindTexture(entry.target, smaller);
+    glTexStorage2D(entry.target, levels, GlCompressedFormat(entry.format), width, height);
+    for (int level = 0; level < levels; level++) {
+        // Cube map faces are copied as the six layers of each level.
+        glCopyImageSubData(entry.texture, entry.target, level + 1, 0, 0, 0,
+                           smaller, entry.target, level, 0, 0, 0,
+                           std::max(1, width >> level), std::max(1, height >> level), entry.faces);
+    }
+    applySampler(entry, smaller);
+    glDeleteTextures(1, &entry.texture);
+    GetRenderState().deletedTexture(entry.texture);
+    entry.texture = smaller;
+
+    m_residentBytes -= entry.levelBytes[entry.firstLevel];
+    entry.firstLevel = first;
+    m_stats.mipsDropped++;
+    GetFrameStats().add(StatCounter::TextureMipsDropped);
+    return true;
+}
+
+void TextureCache::evict(Entry& entry)
+{
+    saveSampler(entry);
+    for (GLuint* texture : { &entry.texture, &entry.restoring }) {
+        if (*texture) {
+            m_streamer.cancel(*texture);
+            glDeleteTextures(1, texture);
+            GetRenderState().deletedTexture(*texture);
+            *texture = 0;
+        }
+    }
+    entry.firstLevel = 0;
+    entry.complete = false;
+    m_stats.evictions++;
+    GetFrameStats().add(StatCounter::TextureEvictions);
+}
+
+void TextureCache::saveSampler(Entry& entry)
+{
+    if (!entry.texture)
+        return;
+    GetRenderState().bindTexture(entry.target, entry.texture);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_MIN_FILTER, &entry.sampler.minFilter);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_MAG_FILTER, &entry.sampler.magFilter);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_WRAP_S, &entry.sampler.wrapS);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_WRAP_T, &entry.sampler.wrapT);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_WRAP_R, &entry.sampler.wrapR);
+}
+
+void TextureCache::applySampler(const Entry& entry, GLuint texture)
+{
+    GetRenderState().bindTexture(entry.target, texture);
+    glTexParameteri(entry.target, GL_TEXTURE_MIN_FILTER, entry.sampler.minFilter);
+    glTexParameteri(entry.target, GL_TEXTURE_MAG_FILTER, entry.sampler.magFilter);
+    glTexParameteri(entry.target, GL_TEXTURE_WRAP_S, entry.sampler.wrapS);
+    glTexParameteri(entry.target, GL_TEXTURE_WRAP_T, entry.sampler.wrapT);
+    glTexParameteri(entry.target, GL_TEXTURE_WRAP_R, entry.sampler.wrapR);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "SceneTextures.h"
+#include "TextureStreamer.h"
+
+// Refers to a texture in a TextureCache. Handles are reference counted by
+// acquire/release; a default-constructed handle refers to nothing.
+struct TextureHandle {
+    uint32_t id = 0;
+
+    explicit operator bool() const { return id != 0; }
+};
+
+struct TextureCacheStats {
+    uint64_t hits = 0;        // acquires of a texture that was already resident
+    uint64_t misses = 0;      // acquires and gets that had to stream the texture
+    uint64_t evictions = 0;   // textures deleted to meet the budget
+    uint64_t mipsDropped = 0; // top levels dropped to meet the budget
+};
+
+// Owns the scene's textures. Requests for the same cooked file share one GL
+// texture, found by a hash of its path, and the texture stays resident
+// while it fits in the budget even after its last handle is released.
+//
+// GPU memory is estimated per mip level from the block format. When the
+// total goes over budget, update() frees memory from the least recently
+// used textures that were not used this frame: unreferenced ones are
+// deleted, referenced ones lose their top mip levels (down to
+// MIN_RESIDENT_SIZE) and are deleted only after that. get() streams an
+// evicted texture back in, and a texture with dropped levels is streamed
+// again in full once it is used and there is room for it.
+class TextureCache {
+public:
+    TextureCache(TextureStreamer& streamer, size_t budgetBytes) : m_streamer(streamer), m_budget(budgetBytes) {}
+    ~TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Starts streaming the texture unless it is already cached. The GL
+    // texture exists (without storage) when this returns, so its sampling
+    // parameters can be set straight away; they are kept across evictions.
+    TextureHandle acquire(const SceneTexture& texture);
+    void release(TextureHandle handle);
+
+    // The texture's current GL name, which changes when levels are dropped
+    // or the texture is streamed again, so call it every frame rather than
+    // keeping the name. Marks the texture as used this frame.
+    GLuint get(TextureHandle handle);
+
+    // Call once per frame after the frame's draws.
+    void update();
+
+    // Deletes every texture. Handles are invalid afterwards.
+    void clear();
+
+    void setBudget(size_t bytes) { m_budget = bytes; }
+    size_t budget() const { return m_budget; }
+    size_t residentBytes() const;
+    const TextureCacheStats& stats() const { return m_stats; }
+
+    // Levels are not dropped below this size on the longer side.
+    static const int MIN_RESIDENT_SIZE = 64;
+
+private:
+    struct SamplerState {
+        GLint minFilter = GL_NEAREST_MIPMAP_LINEAR;
+        GLint magFilter = GL_LINEAR;
+        GLint wrapS = GL_REPEAT;
+        GLint wrapT = GL_REPEAT;
+        GLint wrapR = GL_REPEAT;
+    };
+
+    struct Entry {
+        uint64_t hash = 0;
+        SceneTexture source;
+        GLenum target = GL_TEXTURE_2D;
+        int refs = 0;
+        uint64_t lastUsed = 0;
+
+        // 0 while evicted.
+        GLuint texture = 0;
+        // A full copy streaming in to replace a texture with dropped levels.
+        GLuint restoring = 0;
+        SamplerState sampler;
+
+        // Known once streaming has allocated the storage.
+        BlockFormat format = BlockFormat::BC1;
+        int width = 0;
+        int height = 0;
+        int faces = 1;
+        // Estimated GPU bytes of each level of the full chain, all faces.
+        std::vector<size_t> levelBytes;
+        // Levels above this have been dropped from `texture`.
+        int firstLevel = 0;
+        bool complete = false;
+
+        bool used() const { return !source.cookedPath.empty(); }
+    };
+
+    Entry* find(TextureHandle handle);
+    void startStreaming(uint32_t slot, GLuint texture);
+    void onProgress(uint32_t slot, GLuint texture, const StreamProgress& progress);
+
+    size_t entryBytes(const Entry& entry) const;
+    size_t fullBytes(const Entry& entry) const;
+    bool dropTopLevel(Entry& entry);
+    void evict(Entry& entry);
+    void saveSampler(Entry& entry);
+    void applySampler(const Entry& entry, GLuint texture);
+
+    TextureStreamer& m_streamer;
+    size_t m_budget;
+    // As of the last update(), plus restores started since.
+    size_t m_residentBytes = 0;
+    uint64_t m_frame = 1;
+
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_freeSlots;
+    std::unordered_map<uint64_t, uint32_t> m_slotsByHash;
+    TextureCacheStats m_stats;
+};
@@ -0,0 +1,93 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include "TextureLoader.h"
+
+namespace {
+
+// Bump when the cooked output changes for the same settings.
+const uint32_t COOKER_VERSION = 2;
+
+} // namespace
+
+uint32_t CookTag(const TextureCookSettings& settings)
+{
+    return COOKER_VERSION << 16 | (uint32_t)settings.mips.wrapT << 13 | (uint32_t)settings.mips.wrapS << 12 |
+           (uint32_t)settings.mips.filter << 8 | (uint32_t)settings.format << 4 |
+           (settings.mips.normalMap ? 4u : 0u) | (settings.mips.srgb ? 2u : 0u) | (settings.flipY ? 1u : 0u);
+}
+
+std::string CookedPathFor(const std::string& sourcePath)
+{
+    return sourcePath + ".dds";
+}
+
+CompressedTexture CookTexture(const unsigned char* const* faces, int faceCount, int width, int height,
+                              const TextureCookSettings& settings, unsigned threads)
+{
+    std::vector<std::vector<std::vector<unsigned char>>> chains =
+        GenerateMipChains(faces, faceCount, width, height, settings.mips, threads);
+
+    int levels = MipLevelCount(width, height);
+    CompressedTexture texture(settings.format, width, height, levels, faceCount);
+    for (int face = 0; face < faceCount; face++) {
+        for (int level = 0; level < levels; level++) {
+            if (!CompressImage(chains[face][level].data(), texture.levelWidth(level), texture.levelHeight(level),
+                               settings.format, texture.writableLevelData(face, level), threads))
+                return CompressedTexture();
+        }
+    }
+    return texture;
+}
+
+bool LoadOrCookTexture(const std::vector<std::string>& sourcePaths, const std::string& cookedPath,
+                       const TextureCookSettings& settings, CompressedTexture& texture,
+                       unsigned threads, bool* cooked)
+{
+    if (cooked)
+        *cooked = false;
+
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+    bool fresh = !error;
+    bool sourcesMissing = false;
+    for (const std::string& source : sourcePaths) {
+        auto sourceTime = std::filesystem::last_write_time(source, error);
+        if (error)
+            sourcesMissing = true;
+        else if (sourceTime > cookedTime)
+            fresh = false;
+    }
+    // Without the sources there is nothing to cook, so a .dds from another
+    // tool (no cook tag) or other settings is used as it is.
+    uint32_t tag = 0;
+    if ((fresh || sourcesMissing) && texture.load(cookedPath, &tag) &&
+        (tag == CookTag(settings) || sourcesMissing) && texture.faces() == (int)sourcePaths.size())
+        return true;
+
+    std::vector<DecodedImage> images;
+    std::vector<const unsigned char*> faces;
+    for (const std::string& source : sourcePaths) {
+        images.push_back(DecodeImage(source, settings.flipY, 4));
+        const DecodedImage& image = images.back();
+        if (!image || image.width != images[0].width || image.height != images[0].height) {
+            texture = CompressedTexture();
+            return false;
+        }
+        faces.push_back(image.pixels.get());
+    }
+
+    texture = CookTexture(faces.data(), (int)faces.size(), images[0].width, images[0].height, settings, threads);
+    if (!texture)
+        return false;
+    if (cooked)
+        *cooked = true;
+    if (!texture.save(cookedPath, CookTag(settings)))
+        std::fprintf(stderr, "Could not write %s\n", cookedPath.c_str());
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CompressedTexture.h"
+#include "MipGenerator.h"
+
+// How a source image is turned into a cooked texture. The settings are
+// stored in the .dds, so changing them re-cooks on the next launch.
+struct TextureCookSettings {
+    BlockFormat format = BlockFormat::BC1;
+    bool flipY = false;
+    MipSettings mips;
+};
+
+// Identifies the cooker version and settings that produced a .dds.
+uint32_t CookTag(const TextureCookSettings& settings);
+
+// <source>.dds, next to the source image.
+std::string CookedPathFor(const std::string& sourcePath);
+
+// Builds the full mip chain of one image, or of the six faces of a cube map
+// (+X, -X, +Y, -Y, +Z, -Z), and compresses every level.
+CompressedTexture CookTexture(const unsigned char* const* faces, int faceCount, int width, int height,
+                              const TextureCookSettings& settings, unsigned threads = 0);
+
+// Returns the cooked texture for one source image or six cube faces. The
+// .dds at cookedPath is used when it is at least as new as every source and
+// carries the same cook tag. When a source is missing any .dds there is
+// used as it is, whatever cooked it (e.g. BC7 from an external tool).
+// Otherwise the sources are decoded and cooked, and the result is saved for
+// the next launch. `cooked` reports which path was taken.
+bool LoadOrCookTexture(const std::vector<std::string>& sourcePaths, const std::string& cookedPath,
+                       const TextureCookSettings& settings, CompressedTexture& texture,
+                       unsigned threads = 0, bool* cooked = nullptr);
@@ -0,0 +1,41 @@
+#include "TextureLoader.h"
+
+#include <cstdio>
+
+#include "MappedFile.h"
+#include "stb_image.h"
+
+void DecodedImage::Free::operator()(unsigned char* pixels) const
+{
+    stbi_image_free(pixels);
+}
+
+DecodedImage DecodeImage(const std::string& path, bool flipY, int desiredChannels)
+{
+    DecodedImage image;
+    image.path = path;
+
+    MappedFile file(path.c_str());
+    if (!file.isOpen()) {
+        std::fprintf(stderr, "Could not open %s\n", path.c_str());
+        return image;
+    }
+
+    // The global stbi_set_flip_vertically_on_load is shared by every
+    // thread; the per-thread setting is not.
+    stbi_set_flip_vertically_on_load_thread(flipY);
+    image.pixels.reset(stbi_load_from_memory((const stbi_uc*)file.data(), (int)file.size(),
+                                             &image.width, &image.height, &image.channels, desiredChannels));
+    if (!image.pixels)
+        std::fprintf(stderr, "Could not decode %s: %s\n", path.c_str(), stbi_failure_reason());
+    else if (desiredChannels != 0)
+        image.channels = desiredChannels;
+    return image;
+}
+
+std::future<DecodedImage> TextureLoader::decode(const std::string& path, bool flipY, int desiredChannels)
+{
+    return m_pool.submit([path, flipY, desiredChannels] {
+        return DecodeImage(path, flipY, desiredChannels);
+    });
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Parallel.h"
+
+// Pixels decoded by stb_image, freed with stbi_image_free.
+struct DecodedImage {
+    struct Free {
+        void operator()(unsigned char* pixels) const;
+    };
+
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::unique_ptr<unsigned char, Free> pixels;
+
+    explicit operator bool() const { return pixels != nullptr; }
+};
+
+// Maps the file and decodes it with stbi_load_from_memory on the calling
+// thread. desiredChannels works like stbi_load's last argument (0 keeps the
+// file's channel count). A failed decode yields an empty image.
+DecodedImage DecodeImage(const std::string& path, bool flipY, int desiredChannels = 0);
+
+// Decodes image files on a pool of worker threads. Each file is memory
+// mapped and handed to stbi_load_from_memory on a worker, so reads and
+// decodes of different files overlap. The GL upload stays on the caller's
+// thread.
+class TextureLoader {
+public:
+    explicit TextureLoader(unsigned threads = 0) : m_pool(threads) {}
+
+    // DecodeImage on a worker.
+    std::future<DecodedImage> decode(const std::string& path, bool flipY, int desiredChannels = 0);
+
+    unsigned threads() const { return m_pool.size(); }
+
+private:
+    ThreadPool m_pool;
+};
+
+// Calls upload(index, result) for each future as soon as its load is done,
+// in completion order rather than submission order.
+template <typename T, typename Fn>
+void UploadAsReady(std::vector<std::future<T>>& pending, Fn upload)
+{
+    std::vector<bool> done(pending.size(), false);
+    for (size_t remaining = pending.size(); remaining > 0; ) {
+        bool progressed = false;
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (done[i] || pending[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                continue;
+            T result = pending[i].get();
+            upload(i, result);
+            done[i] = true;
+            remaining--;
+            progressed = true;
+        }
+        if (!progressed) {
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (!done[i]) {
+                    pending[i].wait_for(std::chrono::milliseconds(1));
+                    break;
+                }
+            }
+        }
+    }
+}
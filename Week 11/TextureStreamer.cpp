@@ -0,0 +1,329 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "RenderState.h"
+#include "Stats.h"
+
+namespace {
+
+// Block rows are 8 or 16 bytes; keeping every level on a 16 byte boundary
+// lets the driver copy out of the buffer without realigning.
+const size_t RING_ALIGNMENT = 16;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+TextureStreamer::~TextureStreamer()
+{
+    release();
+}
+
+bool TextureStreamer::create(size_t ringBytes)
+{
+    release();
+
+    m_capacity = AlignUp(ringBytes, RING_ALIGNMENT);
+    m_head = 0;
+    m_stopping = false;
+
+    if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_capacity, nullptr, flags);
+        m_memory = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_capacity, flags);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!m_memory) {
+            glDeleteBuffers(1, &m_buffer);
+            m_buffer = 0;
+        }
+    }
+    if (!m_memory) {
+        m_staging.resize(m_capacity);
+        m_memory = m_staging.data();
+    }
+
+    m_pool = std::make_unique<ThreadPool>(m_threads);
+    return true;
+}
+
+void TextureStreamer::release()
+{
+    // Wake any worker waiting for ring space, then wait for all of them
+    // before the memory they write into goes away.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_spaceFreed.notify_all();
+    m_pool.reset();
+
+    for (Batch& batch : m_inFlight)
+        glDeleteSync(batch.fence);
+    m_inFlight.clear();
+    m_streams.clear();
+    m_queue.clear();
+    m_failed.clear();
+    m_allocations.clear();
+
+    if (m_buffer) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &m_buffer);
+    }
+    m_buffer = 0;
+    m_memory = nullptr;
+    m_staging.clear();
+    m_staging.shrink_to_fit();
+    m_capacity = 0;
+}
+
+void TextureStreamer::stream(GLuint texture, GLenum target, const std::vector<std::string>& sourcePaths,
+                             const std::string& cookedPath, const TextureCookSettings& settings,
+                             std::function<void(const StreamProgress&)> onProgress)
+{
+    if (!m_pool)
+        return;
+
+    cancel(texture);
+    auto stream = std::make_shared<Stream>();
+    stream->texture = texture;
+    stream->target = target;
+    stream->onProgress = std::move(onProgress);
+    m_streams[texture] = stream;
+    m_loading++;
+    m_pool->submit([this, stream, sourcePaths, cookedPath, settings] {
+        load(stream, sourcePaths, cookedPath, settings);
+        m_loading--;
+    });
+}
+
+void TextureStreamer::load(const std::shared_ptr<Stream>& stream, const std::vector<std::string>& sourcePaths,
+                           const std::string& cookedPath, const TextureCookSettings& settings)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping)
+            return;
+    }
+
+    // This worker is one of several, so the cook itself stays serial.
+    CompressedTexture cooked;
+    if (!LoadOrCookTexture(sourcePaths, cookedPath, settings, cooked, 1)) {
+        fail(stream, "Could not load " + cookedPath);
+        return;
+    }
+    int faces = stream->target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    if (cooked.faces() != faces) {
+        fail(stream, cookedPath + " has " + std::to_string(cooked.faces()) + " faces, expected " +
+                         std::to_string(faces));
+        return;
+    }
+
+    stream->format = cooked.format();
+    stream->width = cooked.width();
+    stream->height = cooked.height();
+    stream->levels = cooked.levels();
+
+    // Smallest level first: it is the cheapest to get on screen.
+    for (int level = cooked.levels() - 1; level >= 0 && !stream->cancelled; level--) {
+        LevelUpload upload;
+        upload.stream = stream;
+        upload.level = level;
+        upload.faces = faces;
+        upload.faceSize = cooked.levelSize(level);
+        if (!reserve(upload.faceSize * faces, upload.offset)) {
+            if (upload.faceSize * faces > m_capacity)
+                fail(stream, "Level " + std::to_string(level) + " of " + cookedPath + " does not fit in the upload ring");
+            return;
+        }
+        for (int face = 0; face < faces; face++)
+            std::memcpy(m_memory + upload.offset + face * upload.faceSize, cooked.levelData(face, level), upload.faceSize);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(upload));
+    }
+}
+
+void TextureStreamer::fail(const std::shared_ptr<Stream>& stream, std::string error)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stream->error = std::move(error);
+    m_failed.push_back(stream);
+}
+
+void TextureStreamer::cancel(GLuint texture)
+{
+    auto it = m_streams.find(texture);
+    if (it == m_streams.end())
+        return;
+    it->second->cancelled = true;
+    m_streams.erase(it);
+}
+
+bool TextureStreamer::reserve(size_t size, size_t& offset)
+{
+    size = AlignUp(size, RING_ALIGNMENT);
+    if (size > m_capacity)
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        if (m_stopping)
+            return false;
+        if (m_allocations.empty()) {
+            offset = 0;
+            break;
+        }
+        // Live allocations occupy [tail, head), possibly wrapping around the
+        // end of the ring.
+        size_t tail = m_allocations.front().offset;
+        if (m_head > tail) {
+            if (m_head + size <= m_capacity) {
+                offset = m_head;
+                break;
+            }
+            if (size <= tail) {
+                offset = 0;
+                break;
+            }
+        }
+        else if (m_head + size <= tail) {
+            offset = m_head;
+            break;
+        }
+        m_spaceFreed.wait(lock);
+    }
+    m_allocations.push_back({ offset, size, false });
+    m_head = offset + size;
+    return true;
+}
+
+void TextureStreamer::retire(const std::vector<size_t>& offsets)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t offset : offsets) {
+            for (Allocation& allocation : m_allocations) {
+                if (allocation.offset == offset && !allocation.retired) {
+                    allocation.retired = true;
+                    break;
+                }
+            }
+        }
+        // Space is handed back in allocation order; a level uploaded early
+        // frees nothing until everything reserved before it has also gone.
+        while (!m_allocations.empty() && m_allocations.front().retired)
+            m_allocations.pop_front();
+        if (m_allocations.empty())
+            m_head = 0;
+    }
+    m_spaceFreed.notify_all();
+}
+
+void TextureStreamer::retireCompleted()
+{
+    while (!m_inFlight.empty()) {
+        GLenum status = glClientWaitSync(m_inFlight.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(m_inFlight.front().fence);
+        retire(m_inFlight.front().offsets);
+        m_inFlight.pop_front();
+    }
+}
+
+void TextureStreamer::update(size_t budgetBytes)
+{
+    retireCompleted();
+
+    std::vector<std::shared_ptr<Stream>> failed;
+    std::vector<LevelUpload> uploads;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        failed.swap(m_failed);
+        size_t bytes = 0;
+        while (!m_queue.empty()) {
+            size_t size = m_queue.front().faceSize * m_queue.front().faces;
+            if (!uploads.empty() && bytes + size > budgetBytes)
+                break;
+            bytes += size;
+            uploads.push_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+        }
+    }
+    // Levels a failed load queued before failing still upload below, but
+    // the texture is no longer waited on.
+    for (const std::shared_ptr<Stream>& stream : failed) {
+        if (stream->cancelled)
+            continue;
+        std::fprintf(stderr, "%s\n", stream->error.c_str());
+        auto it = m_streams.find(stream->texture);
+        if (it != m_streams.end() && it->second == stream)
+            m_streams.erase(it);
+    }
+    if (uploads.empty())
+        return;
+
+    ScopedStatTimer uploadTimer(StatTimer::TextureUploads);
+    if (m_buffer)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+
+    Batch batch = {};
+    for (const LevelUpload& upload : uploads) {
+        Stream& stream = *upload.stream;
+        batch.offsets.push_back(upload.offset);
+        if (stream.cancelled)
+            continue;
+
+        GLenum internalFormat = GlCompressedFormat(stream.format);
+        GetRenderState().bindTexture(stream.target, stream.texture);
+        if (!stream.allocated) {
+            glTexStorage2D(stream.target, stream.levels, internalFormat, stream.width, stream.height);
+            stream.allocated = true;
+        }
+
+        int width = std::max(1, stream.width >> upload.level);
+        int height = std::max(1, stream.height >> upload.level);
+        for (int face = 0; face < upload.faces; face++) {
+            GLenum faceTarget = upload.faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : stream.target;
+            size_t offset = upload.offset + face * upload.faceSize;
+            // With the ring bound, the pointer argument is an offset into it.
+            const void* data = m_buffer ? (const void*)(uintptr_t)offset : m_memory + offset;
+            glCompressedTexSubImage2D(faceTarget, upload.level, 0, 0, width, height, internalFormat,
+                                      (GLsizei)upload.faceSize, data);
+        }
+        glTexParameteri(stream.target, GL_TEXTURE_BASE_LEVEL, upload.level);
+        GetFrameStats().add(StatCounter::TextureUploadBytes, upload.faceSize * upload.faces);
+
+        if (upload.level == 0)
+            m_streams.erase(stream.texture);
+        if (stream.onProgress)
+            stream.onProgress({ stream.format, stream.width, stream.height, stream.levels, upload.faces, upload.level });
+    }
+
+    if (m_buffer) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_inFlight.push_back(std::move(batch));
+    }
+    else {
+        // Client memory is copied before the calls return.
+        retire(batch.offsets);
+    }
+}
+
+bool TextureStreamer::idle() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_loading == 0 && m_queue.empty();
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Parallel.h"
+#include "TextureCooker.h"
+
+// Reported on the render thread after each level of a streamed texture is
+// uploaded. The texture has storage for all `levels` from the first report.
+struct StreamProgress {
+    BlockFormat format;
+    int width;
+    int height;
+    int levels;
+    int faces;
+    int baseLevel; // lowest level uploaded so far; 0 when the texture is complete
+};
+
+// Streams cooked textures to the GPU through a ring of pixel unpack buffer
+// memory that stays mapped for the streamer's lifetime. Workers load (or
+// cook) each texture and copy its mip levels straight into the ring; the
+// render thread then issues glCompressedTexSubImage2D from the buffer, at
+// most budgetBytes per update, so the driver does not copy client memory
+// on the render thread and a large texture never lands in a single frame.
+//
+// Levels are uploaded smallest first and GL_TEXTURE_BASE_LEVEL follows
+// them down, so a texture is sampleable (blurry) after its first update and
+// sharpens as the larger levels arrive. Ring space is reused once the fence
+// placed after the uploads that read it has signalled.
+//
+// Without buffer storage the ring is plain memory and the uploads read it
+// as client memory; the budget still applies.
+class TextureStreamer {
+public:
+    explicit TextureStreamer(unsigned threads = 0) : m_threads(threads) {}
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    bool create(size_t ringBytes);
+    void release();
+
+    // Loads or cooks a texture on a worker and queues its levels for upload
+    // into `texture`, a name from glGenTextures that has no storage yet.
+    // target is GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP. onProgress, if set,
+    // is called from update() after every level.
+    void stream(GLuint texture, GLenum target, const std::vector<std::string>& sourcePaths,
+                const std::string& cookedPath, const TextureCookSettings& settings,
+                std::function<void(const StreamProgress&)> onProgress = nullptr);
+
+    // Stops streaming into `texture`; levels already queued are dropped.
+    // Call before deleting a texture that may still be streaming.
+    void cancel(GLuint texture);
+
+    // Call once per frame on the GL thread. Reclaims ring space the GPU is
+    // done with and uploads queued levels up to budgetBytes (always at least
+    // one level, so an oversized level still gets through). Changes the
+    // texture binding of the active unit. Loads that failed since the last
+    // call are reported here, once each; their onProgress is never called.
+    void update(size_t budgetBytes);
+
+    // True once every streamed texture has been fully uploaded (or failed).
+    bool idle() const;
+
+    bool persistent() const { return m_buffer != 0; }
+
+private:
+    struct Stream {
+        GLuint texture = 0;
+        GLenum target = 0;
+        // Written by the worker before the first level is queued.
+        BlockFormat format = BlockFormat::BC1;
+        int width = 0;
+        int height = 0;
+        int levels = 0;
+        bool allocated = false;
+        std::string error; // why the load failed, written before it is queued in m_failed
+        std::function<void(const StreamProgress&)> onProgress;
+        std::atomic<bool> cancelled{ false };
+    };
+
+    // One mip level of every face, back to back in the ring.
+    struct LevelUpload {
+        std::shared_ptr<Stream> stream;
+        int level = 0;
+        int faces = 1;
+        size_t offset = 0;
+        size_t faceSize = 0;
+    };
+
+    struct Allocation {
+        size_t offset;
+        size_t size;
+        bool retired;
+    };
+
+    struct Batch {
+        GLsync fence;
+        std::vector<size_t> offsets;
+    };
+
+    void load(const std::shared_ptr<Stream>& stream, const std::vector<std::string>& sourcePaths,
+              const std::string& cookedPath, const TextureCookSettings& settings);
+    // Called by the worker; update() reports it and drops the stream.
+    void fail(const std::shared_ptr<Stream>& stream, std::string error);
+
+    // Blocks until size bytes of the ring are free. Fails when the streamer
+    // is shutting down or size is larger than the whole ring.
+    bool reserve(size_t size, size_t& offset);
+    void retire(const std::vector<size_t>& offsets);
+    void retireCompleted();
+
+    unsigned m_threads;
+    std::unique_ptr<ThreadPool> m_pool;
+
+    GLuint m_buffer = 0;
+    unsigned char* m_memory = nullptr;
+    std::vector<unsigned char> m_staging;
+    size_t m_capacity = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_spaceFreed;
+    std::deque<Allocation> m_allocations;
+    size_t m_head = 0;
+    std::deque<LevelUpload> m_queue;
+    std::vector<std::shared_ptr<Stream>> m_failed;
+    bool m_stopping = false;
+
+    std::atomic<int> m_loading{ 0 };
+    std::deque<Batch> m_inFlight;
+    // Textures with levels still to upload; render thread only.
+    std::unordered_map<GLuint, std::shared_ptr<Stream>> m_streams;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// std140 uniform blocks shared by every program. The structs mirror the GLSL
+// declarations member for member; a vec3 followed by a float shares one
+// 16-byte slot, and a lone vec3 is padded to 16 bytes.
+
+const GLuint CAMERA_BINDING = 0;
+const GLuint LIGHTING_BINDING = 1;
+
+// layout(std140) uniform Camera { mat4 view; mat4 projection; vec3 cameraPos; };
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 cameraPos;
+    float pad0;
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match the std140 Camera block");
+
+// layout(std140) uniform Lighting {
+//     vec3 lightPos; float ambientStr;
+//     vec3 lightColor; float specStr;
+//     vec3 ambientColor; float specPhong;
+// };
+struct LightingBlock {
+    glm::vec3 lightPos;
+    float ambientStr;
+    glm::vec3 lightColor;
+    float specStr;
+    glm::vec3 ambientColor;
+    float specPhong;
+};
+static_assert(sizeof(LightingBlock) == 48, "LightingBlock must match the std140 Lighting block");
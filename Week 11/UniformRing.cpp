@@ -0,0 +1,108 @@
+#include "UniformRing.h"
+
+#include <cstring>
+
+#include "Stats.h"
+
+namespace {
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+UniformRing::~UniformRing()
+{
+    release();
+}
+
+bool UniformRing::create(size_t bytesPerFrame, int framesInFlight)
+{
+    release();
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+        m_alignment = (size_t)alignment;
+
+    m_regions = framesInFlight > 0 ? framesInFlight : 1;
+    m_regionSize = AlignUp(bytesPerFrame, m_alignment);
+    m_fences.assign(m_regions, nullptr);
+    m_region = 0;
+    m_used = 0;
+
+    size_t total = m_regionSize * m_regions;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, total, nullptr, flags);
+        m_mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags);
+    }
+    if (!m_mapped)
+        glBufferData(GL_UNIFORM_BUFFER, total, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return m_buffer != 0;
+}
+
+void UniformRing::release()
+{
+    for (GLsync& fence : m_fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (m_buffer) {
+        if (m_mapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &m_buffer);
+    }
+    m_buffer = 0;
+    m_mapped = nullptr;
+}
+
+void UniformRing::beginFrame()
+{
+    m_region = (m_region + 1) % m_regions;
+    m_used = 0;
+
+    GLsync& fence = m_fences[m_region];
+    if (!fence)
+        return;
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+        flags = 0;
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void UniformRing::endFrame()
+{
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool UniformRing::bind(GLuint binding, const void* data, size_t size)
+{
+    size_t offset = AlignUp(m_used, m_alignment);
+    if (!m_buffer || offset + size > m_regionSize)
+        return false;
+
+    size_t start = m_region * m_regionSize + offset;
+    if (m_mapped) {
+        memcpy(m_mapped + start, data, size);
+    }
+    else {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, start, size, data);
+    }
+    m_used = offset + size;
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, start, size);
+    GetFrameStats().add(StatCounter::UniformBlockBytes, size);
+    return true;
+}
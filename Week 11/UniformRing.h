@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Persistently mapped uniform buffer split into one region per frame in
+// flight. Blocks are copied straight into the mapping and bound with
+// glBindBufferRange, so each block is written once per frame no matter how
+// many programs read it. A fence per region keeps the CPU from overwriting
+// data the GPU has not consumed yet.
+//
+// Without GL 4.4 / ARB_buffer_storage each block is uploaded with
+// glBufferSubData instead.
+class UniformRing {
+public:
+    UniformRing() = default;
+    ~UniformRing();
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    bool create(size_t bytesPerFrame, int framesInFlight = 3);
+    void release();
+
+    // Waits until the GPU is done with this frame's region.
+    void beginFrame();
+    // Fences the region written since beginFrame.
+    void endFrame();
+
+    // Copies the block into this frame's region and binds it to the uniform
+    // buffer binding point. Returns false if the region is full.
+    bool bind(GLuint binding, const void* data, size_t size);
+
+    template <typename T>
+    bool bind(GLuint binding, const T& block) { return bind(binding, &block, sizeof(T)); }
+
+    bool persistent() const { return m_mapped != nullptr; }
+
+private:
+    GLuint m_buffer = 0;
+    unsigned char* m_mapped = nullptr;
+
+    size_t m_regionSize = 0;
+    size_t m_alignment = 256;
+    int m_regions = 0;
+    int m_region = 0;
+    size_t m_used = 0;
+    std::vector<GLsync> m_fences;
+};
@@ -0,0 +1,249 @@
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+#include <glm/gtc/packing.hpp>
+
+#include "Parallel.h"
+
+namespace {
+
+float SignNotZero(float v)
+{
+    return v >= 0.f ? 1.f : -1.f;
+}
+
+float DecodeSnorm16(int16_t v)
+{
+    return std::max(v / 32767.f, -1.f);
+}
+
+glm::vec3 OctDecode(const int16_t e[2])
+{
+    glm::vec2 f(DecodeSnorm16(e[0]), DecodeSnorm16(e[1]));
+    glm::vec3 n(f.x, f.y, 1.f - std::fabs(f.x) - std::fabs(f.y));
+    float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+// Octahedral encoding (Cigolle et al., "A Survey of Efficient Representations
+// for Independent Unit Vectors"). Rounding each coordinate to nearest is not
+// always the closest decoded direction, so all four neighbours are tried.
+void OctEncode(glm::vec3 n, int16_t out[2])
+{
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (sum == 0.f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    n /= sum;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.f)
+        p = glm::vec2((1.f - std::fabs(n.y)) * SignNotZero(n.x), (1.f - std::fabs(n.x)) * SignNotZero(n.y));
+
+    glm::vec3 unit = glm::normalize(n);
+    float best = -2.f;
+    for (int dx = 0; dx < 2; dx++) {
+        for (int dy = 0; dy < 2; dy++) {
+            int16_t candidate[2] = {
+                (int16_t)std::clamp((int)std::floor(p.x * 32767.f) + dx, -32767, 32767),
+                (int16_t)std::clamp((int)std::floor(p.y * 32767.f) + dy, -32767, 32767),
+            };
+            float d = glm::dot(OctDecode(candidate), unit);
+            if (d > best) {
+                best = d;
+                out[0] = candidate[0];
+                out[1] = candidate[1];
+            }
+        }
+    }
+}
+
+uint16_t PackPosition(float v, VertexFormat format)
+{
+    return format == VertexFormat::PackedHalf ? glm::packHalf1x16(v) : glm::packSnorm1x16(v);
+}
+
+float UnpackPosition(uint16_t bits, VertexFormat format)
+{
+    return format == VertexFormat::PackedHalf ? glm::unpackHalf1x16(bits) : glm::unpackSnorm1x16(bits);
+}
+
+// atan2 rather than acos, which cannot resolve angles below ~0.03 degrees
+// in single precision.
+float AngleDegrees(const glm::vec3& a, const glm::vec3& b)
+{
+    return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+
+} // namespace
+
+void PackVertices(MeshData& mesh, VertexFormat format)
+{
+    mesh.packedVertices.clear();
+    mesh.packedFormat = VertexFormat::Float32;
+    if (format == VertexFormat::Float32)
+        return;
+
+    MeshView bounds;
+    bounds.vertexFormat = format;
+    bounds.aabbMin = mesh.aabbMin;
+    bounds.aabbMax = mesh.aabbMax;
+    glm::vec3 scale = bounds.positionScale();
+    glm::vec3 offset = bounds.positionOffset();
+    glm::vec3 invScale(0.f);
+    for (int i = 0; i < 3; i++)
+        invScale[i] = scale[i] > 0.f ? 1.f / scale[i] : 0.f;
+
+    size_t vertexCount = mesh.vertices.size() / FLOATS_PER_VERTEX;
+    mesh.packedVertices.resize(vertexCount);
+    mesh.packedFormat = format;
+
+    ParallelFor(vertexCount, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            const GLfloat* v = &mesh.vertices[i * FLOATS_PER_VERTEX];
+            PackedVertex& out = mesh.packedVertices[i];
+
+            glm::vec3 p = (glm::vec3(v[POSITION_OFFSET], v[POSITION_OFFSET + 1], v[POSITION_OFFSET + 2]) - offset) * invScale;
+            for (int c = 0; c < 3; c++)
+                out.position[c] = PackPosition(std::clamp(p[c], -1.f, 1.f), format);
+            out.position[3] = PackPosition(v[TANGENT_OFFSET + 3] < 0.f ? -1.f : 1.f, format);
+
+            OctEncode(glm::vec3(v[NORMAL_OFFSET], v[NORMAL_OFFSET + 1], v[NORMAL_OFFSET + 2]), out.normal);
+            OctEncode(glm::vec3(v[TANGENT_OFFSET], v[TANGENT_OFFSET + 1], v[TANGENT_OFFSET + 2]), out.tangent);
+
+            out.uv[0] = glm::packHalf1x16(v[UV_OFFSET]);
+            out.uv[1] = glm::packHalf1x16(v[UV_OFFSET + 1]);
+        }
+    });
+}
+
+void UnpackVertex(const PackedVertex& packed, VertexFormat format, const glm::vec3& scale, const glm::vec3& offset,
+                  GLfloat* out)
+{
+    for (int c = 0; c < 3; c++)
+        out[POSITION_OFFSET + c] = UnpackPosition(packed.position[c], format) * scale[c] + offset[c];
+
+    glm::vec3 n = OctDecode(packed.normal);
+    glm::vec3 t = OctDecode(packed.tangent);
+    for (int c = 0; c < 3; c++) {
+        out[NORMAL_OFFSET + c] = n[c];
+        out[TANGENT_OFFSET + c] = t[c];
+    }
+    out[TANGENT_OFFSET + 3] = UnpackPosition(packed.position[3], format) < 0.f ? -1.f : 1.f;
+
+    out[UV_OFFSET] = glm::unpackHalf1x16(packed.uv[0]);
+    out[UV_OFFSET + 1] = glm::unpackHalf1x16(packed.uv[1]);
+}
+
+void BindPackedVertexLayout(const MeshView& mesh)
+{
+    bool half = mesh.vertexFormat == VertexFormat::PackedHalf;
+
+    glVertexAttribPointer(
+        0,
+        4, //XYZ + handedness
+        half ? GL_HALF_FLOAT : GL_SHORT,
+        half ? GL_FALSE : GL_TRUE,
+        mesh.vertexStride,
+        (void*)offsetof(PackedVertex, position)
+    );
+
+    glVertexAttribPointer(
+        1,
+        2, //octahedral normal
+        GL_SHORT,
+        GL_TRUE,
+        mesh.vertexStride,
+        (void*)offsetof(PackedVertex, normal)
+    );
+
+    glVertexAttribPointer(
+        2,
+        2, //UV
+        GL_HALF_FLOAT,
+        GL_FALSE,
+        mesh.vertexStride,
+        (void*)offsetof(PackedVertex, uv)
+    );
+
+    glVertexAttribPointer(
+        3,
+        2, //octahedral tangent
+        GL_SHORT,
+        GL_TRUE,
+        mesh.vertexStride,
+        (void*)offsetof(PackedVertex, tangent)
+    );
+
+    for (GLuint i = 0; i < 4; i++)
+        glEnableVertexAttribArray(i);
+}
+
+QuantizationError MeasureQuantizationError(const MeshData& mesh)
+{
+    QuantizationError error;
+    MeshView view = ViewOf(mesh);
+    error.diagonal = glm::length(mesh.aabbMax - mesh.aabbMin);
+    if (mesh.packedVertices.empty())
+        return error;
+
+    glm::vec3 scale = view.positionScale();
+    glm::vec3 offset = view.positionOffset();
+    double positionSum = 0.0, normalSum = 0.0, tangentSum = 0.0;
+    size_t normalCount = 0, tangentCount = 0;
+
+    for (size_t i = 0; i < mesh.packedVertices.size(); i++) {
+        const GLfloat* v = &mesh.vertices[i * FLOATS_PER_VERTEX];
+        GLfloat decoded[FLOATS_PER_VERTEX];
+        UnpackVertex(mesh.packedVertices[i], mesh.packedFormat, scale, offset, decoded);
+
+        float position = glm::length(glm::vec3(v[0], v[1], v[2]) - glm::vec3(decoded[0], decoded[1], decoded[2]));
+        error.maxPosition = std::max(error.maxPosition, position);
+        positionSum += position;
+
+        glm::vec3 n(v[NORMAL_OFFSET], v[NORMAL_OFFSET + 1], v[NORMAL_OFFSET + 2]);
+        if (glm::dot(n, n) > 0.f) {
+            float angle = AngleDegrees(glm::normalize(n), glm::vec3(decoded[NORMAL_OFFSET], decoded[NORMAL_OFFSET + 1], decoded[NORMAL_OFFSET + 2]));
+            error.maxNormalDegrees = std::max(error.maxNormalDegrees, angle);
+            normalSum += angle;
+            normalCount++;
+        }
+
+        glm::vec3 t(v[TANGENT_OFFSET], v[TANGENT_OFFSET + 1], v[TANGENT_OFFSET + 2]);
+        if (glm::dot(t, t) > 0.f) {
+            float angle = AngleDegrees(glm::normalize(t), glm::vec3(decoded[TANGENT_OFFSET], decoded[TANGENT_OFFSET + 1], decoded[TANGENT_OFFSET + 2]));
+            error.maxTangentDegrees = std::max(error.maxTangentDegrees, angle);
+            tangentSum += angle;
+            tangentCount++;
+        }
+        if ((v[TANGENT_OFFSET + 3] < 0.f) != (decoded[TANGENT_OFFSET + 3] < 0.f))
+            error.handednessFlips++;
+
+        for (int c = 0; c < 2; c++)
+            error.maxUv = std::max(error.maxUv, std::fabs(v[UV_OFFSET + c] - decoded[UV_OFFSET + c]));
+    }
+
+    error.avgPosition = (float)(positionSum / mesh.packedVertices.size());
+    error.avgNormalDegrees = normalCount ? (float)(normalSum / normalCount) : 0.f;
+    error.avgTangentDegrees = tangentCount ? (float)(tangentSum / tangentCount) : 0.f;
+    return error;
+}
+
+void PrintQuantizationError(const std::string& name, const QuantizationError& error, const MeshView& mesh)
+{
+    float percent = error.diagonal > 0.f ? 100.f / error.diagonal : 0.f;
+    std::cout << name << ": " << FLOATS_PER_VERTEX * sizeof(GLfloat) << " -> " << mesh.vertexStride << " bytes per vertex ("
+              << (mesh.vertexFormat == VertexFormat::PackedHalf ? "half" : "snorm16") << " positions), "
+              << "position error max " << error.maxPosition << " (" << error.maxPosition * percent << "% of AABB diagonal) "
+              << "avg " << error.avgPosition << ", "
+              << "normal max " << error.maxNormalDegrees << " deg avg " << error.avgNormalDegrees << " deg, "
+              << "tangent max " << error.maxTangentDegrees << " deg avg " << error.avgTangentDegrees << " deg, "
+              << "UV max " << error.maxUv << ", "
+              << "handedness flips " << error.handednessFlips << std::endl;
+}
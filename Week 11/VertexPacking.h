@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "Mesh.h"
+
+// Fills mesh.packedVertices from the float vertices in the given packed
+// format. Positions are quantized against mesh.aabbMin/aabbMax, so the AABB
+// must already cover every vertex (BuildMesh computes it).
+void PackVertices(MeshData& mesh, VertexFormat format);
+
+// Decodes one packed vertex back to the FLOATS_PER_VERTEX layout, the way
+// sample.vert does on the GPU.
+void UnpackVertex(const PackedVertex& packed, VertexFormat format, const glm::vec3& scale, const glm::vec3& offset,
+                  GLfloat* out);
+
+// Sets up the vertex attributes of the bound VAO for a packed mesh view.
+// sample.vert expects: 0 = quantized position + handedness, 1 = octahedral
+// normal, 2 = UV, 3 = octahedral tangent.
+void BindPackedVertexLayout(const MeshView& mesh);
+
+struct QuantizationError {
+    float maxPosition = 0.f; // object-space distance
+    float avgPosition = 0.f;
+    float diagonal = 0.f;    // AABB diagonal, to put the position error in scale
+    float maxNormalDegrees = 0.f;
+    float avgNormalDegrees = 0.f;
+    float maxTangentDegrees = 0.f;
+    float avgTangentDegrees = 0.f;
+    float maxUv = 0.f;
+    size_t handednessFlips = 0;
+};
+
+// Compares mesh.packedVertices against the float vertices they came from.
+QuantizationError MeasureQuantizationError(const MeshData& mesh);
+
+void PrintQuantizationError(const std::string& name, const QuantizationError& error, const MeshView& mesh);